@@ -0,0 +1,224 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <thrdpool/thrdpool.h>
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <unistd.h>
+
+/* Max number of workers and producers any benchmark spawns */
+#define BENCH_MAXTHREADS 64u
+
+#if defined THRDPOOL_TASKQ_LOCKFREE
+#define BENCH_TASKQ "lockfree"
+#elif defined THRDPOOL_TASKQ_SEGMENTED
+#define BENCH_TASKQ "segmented"
+#else
+#define BENCH_TASKQ "locked"
+#endif
+
+enum bench_format {
+    BENCH_TEXT,
+    BENCH_CSV,
+    BENCH_JSON
+};
+
+struct bench_opts {
+    enum bench_format format;
+    /* Max number of workers */
+    size_t nthreads;
+    /* Number of producers used for multi-producer cases */
+    size_t nproducers;
+    /* Tasks per measurement, 0 for the benchmark's default */
+    size_t ntasks;
+    /* Measurements per case, the best one is reported */
+    unsigned nreps;
+    /* Free-form tag written along with each result, e.g. a commit hash */
+    char const *label;
+    FILE *out;
+};
+
+struct bench_result {
+    char const *bench;
+    char const *name;
+    char const *sched;
+    size_t workers;
+    size_t producers;
+    char const *metric;
+    double value;
+    char const *unit;
+};
+
+static inline uint64_t bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static inline char const *bench_sched(enum thrdpool_sched sched) {
+    return sched == THRDPOOL_SCHED_STEAL ? "steal" : "shared";
+}
+
+static inline void bench_usage(char const *prog) {
+    fprintf(stderr, "Usage: %s [-f text|csv|json] [-o file] [-l label] [-j workers] "
+                    "[-p producers] [-n tasks] [-r reps]\n", prog);
+}
+
+static inline bool bench_size_arg(char const *arg, size_t max, size_t *value) {
+    char *end;
+    unsigned long long v = strtoull(arg, &end, 10);
+    if(*end || !v || v > max) {
+        return false;
+    }
+    *value = (size_t)v;
+    return true;
+}
+
+static inline bool bench_parse(int argc, char **argv, struct bench_opts *opts) {
+    int opt;
+    size_t reps;
+    long nproc = sysconf(_SC_NPROCESSORS_ONLN);
+    char const *path = 0;
+
+    if(nproc < 1) {
+        nproc = 1;
+    }
+    else if(nproc > (long)BENCH_MAXTHREADS) {
+        nproc = (long)BENCH_MAXTHREADS;
+    }
+
+    *opts = (struct bench_opts) {
+        .format = BENCH_TEXT,
+        .nthreads = (size_t)nproc,
+        .nproducers = (size_t)nproc,
+        .nreps = 3u,
+        .label = "",
+        .out = stdout
+    };
+
+    while((opt = getopt(argc, argv, "f:o:l:j:p:n:r:")) != -1) {
+        switch(opt) {
+            case 'f':
+                if(!strcmp(optarg, "text")) {
+                    opts->format = BENCH_TEXT;
+                }
+                else if(!strcmp(optarg, "csv")) {
+                    opts->format = BENCH_CSV;
+                }
+                else if(!strcmp(optarg, "json")) {
+                    opts->format = BENCH_JSON;
+                }
+                else {
+                    bench_usage(argv[0]);
+                    return false;
+                }
+                break;
+            case 'o':
+                path = optarg;
+                break;
+            case 'l':
+                opts->label = optarg;
+                break;
+            case 'j':
+                if(!bench_size_arg(optarg, BENCH_MAXTHREADS, &opts->nthreads)) {
+                    fprintf(stderr, "Number of workers must be in the range [1, %u]\n", BENCH_MAXTHREADS);
+                    return false;
+                }
+                break;
+            case 'p':
+                if(!bench_size_arg(optarg, BENCH_MAXTHREADS, &opts->nproducers)) {
+                    fprintf(stderr, "Number of producers must be in the range [1, %u]\n", BENCH_MAXTHREADS);
+                    return false;
+                }
+                break;
+            case 'n':
+                if(!bench_size_arg(optarg, SIZE_MAX, &opts->ntasks)) {
+                    fprintf(stderr, "Number of tasks must be positive\n");
+                    return false;
+                }
+                break;
+            case 'r':
+                if(!bench_size_arg(optarg, 1000u, &reps)) {
+                    fprintf(stderr, "Number of repetitions must be in the range [1, 1000]\n");
+                    return false;
+                }
+                opts->nreps = (unsigned)reps;
+                break;
+            default:
+                bench_usage(argv[0]);
+                return false;
+        }
+    }
+
+    if(path) {
+        /* Results are appended so that runs of several benchmarks, or several
+         * commits, may be collected in the same file */
+        opts->out = fopen(path, "a");
+        if(!opts->out) {
+            fprintf(stderr, "Error opening %s: %s\n", path, strerror(errno));
+            return false;
+        }
+        fseek(opts->out, 0, SEEK_END);
+    }
+
+    if(opts->format == BENCH_CSV && ftell(opts->out) <= 0) {
+        fputs("label,taskq,benchmark,case,sched,workers,producers,metric,value,unit\n", opts->out);
+    }
+    else if(opts->format == BENCH_TEXT) {
+        fprintf(opts->out, "%-12s %-20s %-6s %7s %9s %-10s %14s\n",
+                "benchmark", "case", "sched", "workers", "producers", "metric", "value");
+    }
+    return true;
+}
+
+static inline void bench_json_string(FILE *out, char const *str) {
+    fputc('"', out);
+    for(; *str; str++) {
+        if(*str == '"' || *str == '\\') {
+            fputc('\\', out);
+        }
+        fputc(*str, out);
+    }
+    fputc('"', out);
+}
+
+static inline void bench_record(struct bench_opts const *opts, struct bench_result const *res) {
+    switch(opts->format) {
+        case BENCH_TEXT:
+            fprintf(opts->out, "%-12s %-20s %-6s %7zu %9zu %-10s %14.3f %s\n",
+                    res->bench, res->name, res->sched, res->workers, res->producers,
+                    res->metric, res->value, res->unit);
+            break;
+        case BENCH_CSV:
+            fprintf(opts->out, "%s,%s,%s,%s,%s,%zu,%zu,%s,%.6g,%s\n",
+                    opts->label, BENCH_TASKQ, res->bench, res->name, res->sched,
+                    res->workers, res->producers, res->metric, res->value, res->unit);
+            break;
+        case BENCH_JSON:
+            /* One object per line */
+            fputs("{\"label\":", opts->out);
+            bench_json_string(opts->out, opts->label);
+            fprintf(opts->out, ",\"taskq\":\"%s\",\"benchmark\":\"%s\",\"case\":\"%s\",\"sched\":\"%s\","
+                               "\"workers\":%zu,\"producers\":%zu,\"metric\":\"%s\",\"value\":%.6g,\"unit\":\"%s\"}\n",
+                    BENCH_TASKQ, res->bench, res->name, res->sched, res->workers, res->producers,
+                    res->metric, res->value, res->unit);
+            break;
+    }
+    fflush(opts->out);
+}
+
+static inline void bench_finish(struct bench_opts *opts) {
+    if(opts->out != stdout) {
+        fclose(opts->out);
+    }
+}
+
+#endif /* BENCH_H */
@@ -0,0 +1,212 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bench.h"
+
+#define FIB_N 30u
+/* Subproblems below these sizes are solved serially */
+#define FIB_CUTOFF 12u
+#define NELEMS (1u << 20u)
+#define SORT_CUTOFF 1024u
+
+struct fib {
+    unsigned n;
+    uint64_t result;
+};
+
+struct sort {
+    unsigned *elems;
+    size_t nelems;
+};
+
+static unsigned data[NELEMS];
+static unsigned elems[NELEMS];
+static size_t nelems;
+static unsigned cutoff;
+/* Keeps the serial runs from being optimized out */
+static volatile uint64_t checksum;
+
+thrdpool_decl(pool, BENCH_MAXTHREADS);
+
+static uint64_t fib_serial(unsigned n) {
+    return n < 2u ? n : fib_serial(n - 1u) + fib_serial(n - 2u);
+}
+
+static void fib(void *arg) {
+    struct fib *f = arg;
+    struct fib a = { .n = f->n - 1u };
+    struct fib b = { .n = f->n - 2u };
+    struct thrdpool_group group;
+
+    if(f->n < cutoff || f->n < 2u || !thrdpool_group_init(&group)) {
+        f->result = fib_serial(f->n);
+        return;
+    }
+
+    thrdpool_spawn(&pool, &group, fib, &a);
+    fib(&b);
+    thrdpool_sync(&pool, &group);
+    thrdpool_group_destroy(&group);
+    f->result = a.result + b.result;
+}
+
+/* Partition around the middle element, returns its final index */
+static size_t partition(unsigned *a, size_t n) {
+    unsigned pivot = a[n / 2u];
+    unsigned tmp;
+    size_t i = 0u;
+
+    a[n / 2u] = a[n - 1u];
+    a[n - 1u] = pivot;
+    for(size_t j = 0u; j + 1u < n; j++) {
+        if(a[j] < pivot) {
+            tmp = a[i];
+            a[i++] = a[j];
+            a[j] = tmp;
+        }
+    }
+    a[n - 1u] = a[i];
+    a[i] = pivot;
+    return i;
+}
+
+static void sort_serial(unsigned *a, size_t n) {
+    size_t i;
+
+    while(n > 1u) {
+        i = partition(a, n);
+        /* Recurse into the smaller half only */
+        if(i < n - i - 1u) {
+            sort_serial(a, i);
+            a += i + 1u;
+            n -= i + 1u;
+        }
+        else {
+            sort_serial(a + i + 1u, n - i - 1u);
+            n = i;
+        }
+    }
+}
+
+static void quicksort(void *arg) {
+    struct sort *s = arg;
+    struct sort lo;
+    struct sort hi;
+    struct thrdpool_group group;
+    size_t i;
+
+    if(s->nelems < SORT_CUTOFF || !thrdpool_group_init(&group)) {
+        sort_serial(s->elems, s->nelems);
+        return;
+    }
+
+    i = partition(s->elems, s->nelems);
+    lo = (struct sort) { .elems = s->elems, .nelems = i };
+    hi = (struct sort) { .elems = s->elems + i + 1u, .nelems = s->nelems - i - 1u };
+
+    thrdpool_spawn(&pool, &group, quicksort, &lo);
+    quicksort(&hi);
+    thrdpool_sync(&pool, &group);
+    thrdpool_group_destroy(&group);
+}
+
+/* Runs the root on a worker as well, so that every level waits in thrdpool_sync */
+static void run_fib(void) {
+    struct thrdpool_group group;
+    struct fib f = { .n = FIB_N };
+
+    if(!thrdpool_group_init(&group)) {
+        return;
+    }
+    thrdpool_spawn(&pool, &group, fib, &f);
+    thrdpool_sync(&pool, &group);
+    thrdpool_group_destroy(&group);
+    checksum += f.result;
+}
+
+static void run_fib_serial(void) {
+    checksum += fib_serial(FIB_N);
+}
+
+static void run_sort(void) {
+    struct thrdpool_group group;
+    struct sort s = { .elems = elems, .nelems = nelems };
+
+    memcpy(elems, data, nelems * sizeof(*elems));
+    if(!thrdpool_group_init(&group)) {
+        return;
+    }
+    thrdpool_spawn(&pool, &group, quicksort, &s);
+    thrdpool_sync(&pool, &group);
+    thrdpool_group_destroy(&group);
+    checksum += elems[nelems / 2u];
+}
+
+static void run_sort_serial(void) {
+    memcpy(elems, data, nelems * sizeof(*elems));
+    sort_serial(elems, nelems);
+    checksum += elems[nelems / 2u];
+}
+
+static void report(struct bench_opts const *opts, char const *sched, char const *name, void(*run)(void)) {
+    uint64_t best = 0u;
+
+    for(unsigned i = 0u; i < opts->nreps; i++) {
+        uint64_t start = bench_now();
+        run();
+        uint64_t elapsed = bench_now() - start;
+        if(!i || elapsed < best) {
+            best = elapsed;
+        }
+    }
+    bench_record(opts, &(struct bench_result) {
+        .bench = "fork_join", .name = name, .sched = sched,
+        .workers = opts->nthreads, .producers = 1u,
+        .metric = "time", .value = (double)best * 1e-6, .unit = "ms"
+    });
+}
+
+int main(int argc, char **argv) {
+    char name[32];
+    unsigned const cutoffs[] = { 2u, FIB_CUTOFF };
+    struct bench_opts opts;
+    struct thrdpool_attr attr = thrdpool_attr_init();
+    enum thrdpool_sched const scheds[] = { THRDPOOL_SCHED_SHARED, THRDPOOL_SCHED_STEAL };
+    bool success = true;
+
+    if(!bench_parse(argc, argv, &opts)) {
+        return 1;
+    }
+    nelems = opts.ntasks && opts.ntasks < NELEMS ? opts.ntasks : NELEMS;
+
+    srand(1u);
+    for(size_t i = 0u; i < nelems; i++) {
+        data[i] = (unsigned)rand();
+    }
+
+    snprintf(name, sizeof(name), "fib-%u", FIB_N);
+    report(&opts, "serial", name, run_fib_serial);
+    snprintf(name, sizeof(name), "quicksort-%zu", nelems);
+    report(&opts, "serial", name, run_sort_serial);
+
+    for(size_t i = 0u; success && i < thrdpool_arrsize(scheds); i++) {
+        /* Only spawn the requested number of workers */
+        attr.sched = scheds[i];
+        success = thrdpool_init_impl(&pool.d_pool, opts.nthreads, &attr);
+        if(!success) {
+            break;
+        }
+
+        for(size_t j = 0u; j < thrdpool_arrsize(cutoffs); j++) {
+            cutoff = cutoffs[j];
+            snprintf(name, sizeof(name), "fib-%u/cutoff=%u", FIB_N, cutoff);
+            report(&opts, bench_sched(scheds[i]), name, run_fib);
+        }
+        snprintf(name, sizeof(name), "quicksort-%zu", nelems);
+        report(&opts, bench_sched(scheds[i]), name, run_sort);
+
+        thrdpool_destroy(&pool);
+    }
+
+    bench_finish(&opts);
+    return !success;
+}
@@ -0,0 +1,129 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bench.h"
+
+/* Default width of each stage */
+#define WIDTH 1024u
+#define NSTAGES 16u
+#define SPIN_ITERATIONS 256u
+
+/* Every stage fans out from a join node and back into the next */
+static thrdpool_graph_decl(graph, NSTAGES * (WIDTH + 1u) + 1u, 2u * NSTAGES * WIDTH);
+static struct thrdpool_group group;
+static size_t width;
+
+thrdpool_decl(pool, BENCH_MAXTHREADS);
+
+static void spin(void *arg) {
+    volatile float x = 1.f;
+    (void)arg;
+    for(unsigned i = 0u; i < SPIN_ITERATIONS; i++) {
+        x = x * 0.999f + 0.5f;
+    }
+}
+
+static bool build_graph(void) {
+    struct thrdpool_node *join;
+    struct thrdpool_node *node;
+
+    if(!thrdpool_graph_init(&graph)) {
+        return false;
+    }
+
+    join = thrdpool_graph_node(&graph, spin, 0);
+    for(size_t i = 0u; i < NSTAGES; i++) {
+        struct thrdpool_node *next = thrdpool_graph_node(&graph, spin, 0);
+        for(size_t j = 0u; j < width; j++) {
+            node = thrdpool_graph_node(&graph, spin, 0);
+            thrdpool_graph_edge(&graph, join, node);
+            thrdpool_graph_edge(&graph, node, next);
+        }
+        join = next;
+    }
+    return true;
+}
+
+/* Stages chained by waiting for a group before scheduling the next one */
+static void run_group(void) {
+    spin(0);
+    for(size_t i = 0u; i < NSTAGES; i++) {
+        for(size_t j = 0u; j < width; j++) {
+            thrdpool_schedule_group_wait(&pool, &group, spin, 0);
+        }
+        thrdpool_group_wait(&group);
+        spin(0);
+    }
+}
+
+static void run_graph(void) {
+    thrdpool_graph_submit(&pool, &graph);
+    thrdpool_graph_wait(&graph);
+}
+
+static void report(struct bench_opts const *opts, enum thrdpool_sched sched, char const *name, void(*run)(void)) {
+    uint64_t best = 0u;
+    size_t ntasks = NSTAGES * (width + 1u) + 1u;
+
+    for(unsigned i = 0u; i < opts->nreps; i++) {
+        uint64_t start = bench_now();
+        run();
+        uint64_t elapsed = bench_now() - start;
+        if(!i || elapsed < best) {
+            best = elapsed;
+        }
+    }
+    bench_record(opts, &(struct bench_result) {
+        .bench = "graph", .name = name, .sched = bench_sched(sched),
+        .workers = opts->nthreads, .producers = 1u,
+        .metric = "time", .value = (double)best * 1e-6, .unit = "ms"
+    });
+    bench_record(opts, &(struct bench_result) {
+        .bench = "graph", .name = name, .sched = bench_sched(sched),
+        .workers = opts->nthreads, .producers = 1u,
+        .metric = "rate", .value = (double)ntasks / (double)best * 1e3, .unit = "Mtasks/s"
+    });
+}
+
+int main(int argc, char **argv) {
+    char name[32];
+    struct bench_opts opts;
+    struct thrdpool_attr attr = thrdpool_attr_init();
+    enum thrdpool_sched const scheds[] = { THRDPOOL_SCHED_SHARED, THRDPOOL_SCHED_STEAL };
+    bool success = true;
+
+    if(!bench_parse(argc, argv, &opts)) {
+        return 1;
+    }
+    width = opts.ntasks && opts.ntasks < WIDTH ? opts.ntasks : WIDTH;
+
+    if(!thrdpool_group_init(&group)) {
+        bench_finish(&opts);
+        return 1;
+    }
+    if(!build_graph()) {
+        thrdpool_group_destroy(&group);
+        bench_finish(&opts);
+        return 1;
+    }
+
+    for(size_t i = 0u; success && i < thrdpool_arrsize(scheds); i++) {
+        /* Only spawn the requested number of workers */
+        attr.sched = scheds[i];
+        success = thrdpool_init_impl(&pool.d_pool, opts.nthreads, &attr);
+        if(!success) {
+            break;
+        }
+
+        snprintf(name, sizeof(name), "group-%zux%u", width, NSTAGES);
+        report(&opts, scheds[i], name, run_group);
+        snprintf(name, sizeof(name), "graph-%zux%u", width, NSTAGES);
+        report(&opts, scheds[i], name, run_graph);
+
+        thrdpool_destroy(&pool);
+    }
+
+    thrdpool_graph_destroy(&graph);
+    thrdpool_group_destroy(&group);
+    bench_finish(&opts);
+    return !success;
+}
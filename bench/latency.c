@@ -0,0 +1,172 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bench.h"
+
+#include <sys/resource.h>
+
+#define NTASKS (1u << 14u)
+/* Tasks per worker scheduled back to back in the burst case */
+#define BURST_FACTOR 4u
+/* Time between tasks in the sparse case */
+#define SPARSE_GAP_NS 20000u
+
+struct policy {
+    char const *name;
+    uint64_t spin;
+    unsigned yields;
+};
+
+struct stamp {
+    uint64_t scheduled;
+    uint64_t started;
+};
+
+static struct stamp *stamps;
+static uint64_t *latencies;
+static struct thrdpool_group group;
+
+thrdpool_decl(pool, BENCH_MAXTHREADS);
+
+static void record(void *arg) {
+    struct stamp *s = arg;
+    s->started = bench_now();
+}
+
+/* CPU time used by the process, in seconds */
+static double cputime(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return (double)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) +
+           (double)(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1e-6;
+}
+
+static int compare(void const *l, void const *r) {
+    uint64_t a = *(uint64_t const *)l;
+    uint64_t b = *(uint64_t const *)r;
+    return (a > b) - (a < b);
+}
+
+/* Schedules ntasks tasks, burst at a time, waiting for each burst to finish and then
+ * for gap ns before scheduling the next one. The latency is measured from just before
+ * the call to thrdpool_schedule_group_wait until the task starts running. Returns the
+ * average number of CPUs kept busy by the process while measuring */
+static double measure(size_t ntasks, size_t burst, long gap) {
+    struct timespec pause = { .tv_sec = 0, .tv_nsec = gap };
+    double cpu = cputime();
+    uint64_t start = bench_now();
+
+    for(size_t i = 0u; i < ntasks; i += burst) {
+        size_t end = i + burst < ntasks ? i + burst : ntasks;
+        for(size_t j = i; j < end; j++) {
+            stamps[j].scheduled = bench_now();
+            thrdpool_schedule_group_wait(&pool, &group, record, &stamps[j]);
+        }
+        thrdpool_group_wait(&group);
+        if(gap) {
+            nanosleep(&pause, 0);
+        }
+    }
+    cpu = (cputime() - cpu) / ((double)(bench_now() - start) * 1e-9);
+
+    for(size_t i = 0u; i < ntasks; i++) {
+        latencies[i] = stamps[i].started - stamps[i].scheduled;
+    }
+    qsort(latencies, ntasks, sizeof(*latencies), compare);
+    return cpu;
+}
+
+static void report(struct bench_opts const *opts, char const *workload, struct policy const *policy,
+                   enum thrdpool_sched sched, size_t ntasks, double cpu) {
+    static struct {
+        char const *metric;
+        double quantile;
+    } const percentiles[] = {
+        { "p50", 0.5 },
+        { "p90", 0.9 },
+        { "p99", 0.99 },
+        { "p99.9", 0.999 },
+        { "max", 1.0 }
+    };
+
+    char name[64];
+    snprintf(name, sizeof(name), "%s/%s", workload, policy->name);
+
+    for(size_t i = 0u; i < thrdpool_arrsize(percentiles); i++) {
+        size_t idx = (size_t)(percentiles[i].quantile * (double)(ntasks - 1u));
+        bench_record(opts, &(struct bench_result) {
+            .bench = "latency", .name = name, .sched = bench_sched(sched),
+            .workers = opts->nthreads, .producers = 1u,
+            .metric = percentiles[i].metric, .value = (double)latencies[idx] * 1e-3, .unit = "us"
+        });
+    }
+    bench_record(opts, &(struct bench_result) {
+        .bench = "latency", .name = name, .sched = bench_sched(sched),
+        .workers = opts->nthreads, .producers = 1u,
+        .metric = "cpu", .value = cpu, .unit = "cores"
+    });
+}
+
+int main(int argc, char **argv) {
+    struct bench_opts opts;
+    struct thrdpool_attr attr = thrdpool_attr_init();
+    enum thrdpool_sched const scheds[] = { THRDPOOL_SCHED_SHARED, THRDPOOL_SCHED_STEAL };
+    /* Idle workers either park right away, or spin for up to 50 us and yield a few times first */
+    struct policy const policies[] = {
+        { "park", 0u, 0u },
+        { "spin", 50000u, 16u }
+    };
+    double cpu;
+    int status = 1;
+    size_t ntasks;
+
+    if(!bench_parse(argc, argv, &opts)) {
+        return 1;
+    }
+
+    ntasks = opts.ntasks ? opts.ntasks : NTASKS;
+    stamps = malloc(ntasks * sizeof(*stamps));
+    latencies = malloc(ntasks * sizeof(*latencies));
+    if(!stamps || !latencies) {
+        fprintf(stderr, "Error allocating %zu samples\n", ntasks);
+        goto epilogue;
+    }
+
+    if(!thrdpool_group_init(&group)) {
+        goto epilogue;
+    }
+
+    for(size_t i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        for(size_t j = 0u; j < thrdpool_arrsize(policies); j++) {
+            attr.sched = scheds[i];
+            attr.spin = policies[j].spin;
+            attr.yields = policies[j].yields;
+            /* Only spawn the requested number of workers */
+            if(!thrdpool_init_impl(&pool.d_pool, opts.nthreads, &attr)) {
+                goto epilogue_group;
+            }
+
+            /* One task at a time, the next one is scheduled right after the previous finished */
+            cpu = measure(ntasks, 1u, 0);
+            report(&opts, "idle", &policies[j], scheds[i], ntasks, cpu);
+
+            /* One task at a time with pauses in between */
+            cpu = measure(ntasks, 1u, SPARSE_GAP_NS);
+            report(&opts, "sparse", &policies[j], scheds[i], ntasks, cpu);
+
+            /* Tasks queue up behind each other */
+            cpu = measure(ntasks, BURST_FACTOR * opts.nthreads, 0);
+            report(&opts, "burst", &policies[j], scheds[i], ntasks, cpu);
+
+            thrdpool_destroy(&pool);
+        }
+    }
+    status = 0;
+
+epilogue_group:
+    thrdpool_group_destroy(&group);
+epilogue:
+    free(latencies);
+    free(stamps);
+    bench_finish(&opts);
+    return status;
+}
@@ -0,0 +1,103 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bench.h"
+
+#define NELEMS (1u << 20u)
+
+static float data[NELEMS];
+static struct thrdpool_group group;
+
+thrdpool_decl(pool, BENCH_MAXTHREADS);
+
+static inline void work(size_t i) {
+    float x = data[i];
+    for(unsigned j = 0u; j < 16u; j++) {
+        x = x * 0.999f + 0.5f;
+    }
+    data[i] = x;
+}
+
+static void element(void *arg) {
+    work((size_t)((float *)arg - data));
+}
+
+static void range(size_t lo, size_t hi, void *ctx) {
+    (void)ctx;
+    for(size_t i = lo; i < hi; i++) {
+        work(i);
+    }
+}
+
+static size_t nelems;
+
+static void run_elements(void) {
+    for(size_t i = 0u; i < nelems; i++) {
+        thrdpool_schedule_group_wait(&pool, &group, element, &data[i]);
+    }
+    thrdpool_group_wait(&group);
+}
+
+static size_t grain;
+
+static void run_parallel_for(void) {
+    thrdpool_parallel_for(&pool, 0u, nelems, grain, range, 0);
+}
+
+static void report(struct bench_opts const *opts, char const *name, void(*run)(void)) {
+    uint64_t best = 0u;
+    for(unsigned i = 0u; i < opts->nreps; i++) {
+        uint64_t start = bench_now();
+        run();
+        uint64_t elapsed = bench_now() - start;
+        if(!i || elapsed < best) {
+            best = elapsed;
+        }
+    }
+    bench_record(opts, &(struct bench_result) {
+        .bench = "parallel_for", .name = name, .sched = "shared",
+        .workers = opts->nthreads, .producers = 1u,
+        .metric = "time", .value = (double)best * 1e-6, .unit = "ms"
+    });
+    bench_record(opts, &(struct bench_result) {
+        .bench = "parallel_for", .name = name, .sched = "shared",
+        .workers = opts->nthreads, .producers = 1u,
+        .metric = "rate", .value = (double)nelems / (double)best * 1e3, .unit = "Melem/s"
+    });
+}
+
+int main(int argc, char **argv) {
+    char name[32];
+    size_t grains[] = { 0u, 1u, 64u, 4096u };
+    struct bench_opts opts;
+    struct thrdpool_attr attr = thrdpool_attr_init();
+
+    if(!bench_parse(argc, argv, &opts)) {
+        return 1;
+    }
+    nelems = opts.ntasks && opts.ntasks < NELEMS ? opts.ntasks : NELEMS;
+
+    if(!thrdpool_group_init(&group)) {
+        bench_finish(&opts);
+        return 1;
+    }
+
+    /* Only spawn the requested number of workers */
+    attr.sched = THRDPOOL_SCHED_SHARED;
+    if(!thrdpool_init_impl(&pool.d_pool, opts.nthreads, &attr)) {
+        thrdpool_group_destroy(&group);
+        bench_finish(&opts);
+        return 1;
+    }
+
+    report(&opts, "per-element", run_elements);
+    for(size_t i = 0u; i < thrdpool_arrsize(grains); i++) {
+        grain = grains[i];
+        snprintf(name, sizeof(name), "grain=%zu", grain);
+        report(&opts, name, run_parallel_for);
+    }
+
+    thrdpool_destroy(&pool);
+    thrdpool_group_destroy(&group);
+    bench_finish(&opts);
+    return 0;
+}
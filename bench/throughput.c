@@ -0,0 +1,202 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bench.h"
+
+#include <pthread.h>
+
+#define NTASKS (1u << 18u)
+#define SPIN_ITERATIONS 256u
+
+enum mode {
+    /* One thrdpool_schedule_group_wait per task */
+    MODE_SINGLE,
+    /* THRDPOOL_BATCH_CAPACITY tasks per thrdpool_schedule_batch */
+    MODE_BATCH
+};
+
+struct workload {
+    char const *name;
+    thrdpool_taskhandle handle;
+    enum mode mode;
+};
+
+struct producer {
+    pthread_t thrd;
+    size_t ntasks;
+    struct workload const *load;
+};
+
+static struct thrdpool_group group;
+static pthread_mutex_t gatelock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gatecv = PTHREAD_COND_INITIALIZER;
+static bool gate;
+static struct producer producers[BENCH_MAXTHREADS];
+
+thrdpool_decl(pool, BENCH_MAXTHREADS);
+
+static void empty(void *arg) {
+    (void)arg;
+}
+
+static void spin(void *arg) {
+    volatile float x = 1.f;
+    (void)arg;
+    for(unsigned i = 0u; i < SPIN_ITERATIONS; i++) {
+        x = x * 0.999f + 0.5f;
+    }
+}
+
+static void produce_batch(struct producer *p) {
+    struct thrdpool_task tasks[THRDPOOL_BATCH_CAPACITY];
+    size_t pushed;
+
+    for(size_t i = 0u; i < thrdpool_arrsize(tasks); i++) {
+        tasks[i] = (struct thrdpool_task) {
+            .handle = p->load->handle,
+            .group = &group
+        };
+    }
+
+    for(size_t left = p->ntasks, n; left; left -= n) {
+        n = left < thrdpool_arrsize(tasks) ? left : thrdpool_arrsize(tasks);
+        pushed = thrdpool_schedule_batch(&pool, tasks, n);
+        if(pushed < n) {
+            /* Queue full, block on the first task that did not fit */
+            thrdpool_schedule_group_wait(&pool, &group, p->load->handle, 0);
+            n = pushed + 1u;
+        }
+    }
+}
+
+static void *produce(void *arg) {
+    struct producer *p = arg;
+
+    /* Start all producers at once */
+    pthread_mutex_lock(&gatelock);
+    while(!gate) {
+        pthread_cond_wait(&gatecv, &gatelock);
+    }
+    pthread_mutex_unlock(&gatelock);
+
+    if(p->load->mode == MODE_BATCH) {
+        produce_batch(p);
+    }
+    else {
+        for(size_t i = 0u; i < p->ntasks; i++) {
+            thrdpool_schedule_group_wait(&pool, &group, p->load->handle, 0);
+        }
+    }
+    return 0;
+}
+
+/* Returns the number of tasks per second, 0.0 on failure */
+static double measure(struct workload const *load, size_t nproducers, size_t ntasks) {
+    int err = 0;
+    size_t nstarted;
+    uint64_t start;
+
+    gate = false;
+    for(nstarted = 0u; nstarted < nproducers; nstarted++) {
+        producers[nstarted].load = load;
+        producers[nstarted].ntasks = ntasks / nproducers + (nstarted < ntasks % nproducers);
+        err = pthread_create(&producers[nstarted].thrd, 0, produce, &producers[nstarted]);
+        if(err) {
+            fprintf(stderr, "Error creating producer: %s\n", strerror(err));
+            break;
+        }
+    }
+
+    pthread_mutex_lock(&gatelock);
+    gate = true;
+    start = bench_now();
+    pthread_cond_broadcast(&gatecv);
+    pthread_mutex_unlock(&gatelock);
+
+    for(size_t i = 0u; i < nstarted; i++) {
+        pthread_join(producers[i].thrd, 0);
+    }
+    thrdpool_group_wait(&group);
+    double elapsed = (double)(bench_now() - start) * 1e-9;
+
+    return err ? 0.0 : (double)ntasks / elapsed;
+}
+
+static bool sweep(struct bench_opts const *opts, struct workload const *load,
+                  enum thrdpool_sched sched, size_t nproducers) {
+    double base = 0.0;
+    size_t ntasks = opts->ntasks ? opts->ntasks : NTASKS;
+    struct thrdpool_attr attr = thrdpool_attr_init();
+    attr.sched = sched;
+
+    for(size_t nworkers = 1u; nworkers; nworkers = nworkers < opts->nthreads ? nworkers * 2u : 0u) {
+        if(nworkers > opts->nthreads) {
+            nworkers = opts->nthreads;
+        }
+
+        /* Only spawn the requested number of workers */
+        if(!thrdpool_init_impl(&pool.d_pool, nworkers, &attr)) {
+            return false;
+        }
+
+        double best = 0.0;
+        for(unsigned i = 0u; i < opts->nreps; i++) {
+            double rate = measure(load, nproducers, ntasks);
+            if(rate > best) {
+                best = rate;
+            }
+        }
+        thrdpool_destroy(&pool);
+
+        if(best == 0.0) {
+            return false;
+        }
+        if(nworkers == 1u) {
+            base = best;
+        }
+
+        bench_record(opts, &(struct bench_result) {
+            .bench = "throughput", .name = load->name, .sched = bench_sched(sched),
+            .workers = nworkers, .producers = nproducers,
+            .metric = "rate", .value = best * 1e-6, .unit = "Mtasks/s"
+        });
+        bench_record(opts, &(struct bench_result) {
+            .bench = "throughput", .name = load->name, .sched = bench_sched(sched),
+            .workers = nworkers, .producers = nproducers,
+            .metric = "speedup", .value = best / base, .unit = "x"
+        });
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    struct bench_opts opts;
+    struct workload const loads[] = {
+        { .name = "empty", .handle = empty, .mode = MODE_SINGLE },
+        { .name = "empty-batch", .handle = empty, .mode = MODE_BATCH },
+        { .name = "spin", .handle = spin, .mode = MODE_SINGLE }
+    };
+    enum thrdpool_sched const scheds[] = { THRDPOOL_SCHED_SHARED, THRDPOOL_SCHED_STEAL };
+    bool success = true;
+
+    if(!bench_parse(argc, argv, &opts)) {
+        return 1;
+    }
+
+    if(!thrdpool_group_init(&group)) {
+        bench_finish(&opts);
+        return 1;
+    }
+
+    for(size_t i = 0u; success && i < thrdpool_arrsize(loads); i++) {
+        for(size_t j = 0u; success && j < thrdpool_arrsize(scheds); j++) {
+            success = sweep(&opts, &loads[i], scheds[j], 1u);
+            if(success && opts.nproducers > 1u) {
+                success = sweep(&opts, &loads[i], scheds[j], opts.nproducers);
+            }
+        }
+    }
+
+    thrdpool_group_destroy(&group);
+    bench_finish(&opts);
+    return !success;
+}
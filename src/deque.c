@@ -0,0 +1,64 @@
+#include <thrdpool/deque.h>
+
+void thrdpool_deque_slot_store(struct thrdpool_deque_slot *slot, struct thrdpool_task const *task);
+void thrdpool_deque_slot_load(struct thrdpool_deque_slot *slot, struct thrdpool_task *task);
+size_t thrdpool_deque_size(struct thrdpool_deque *dq);
+
+void thrdpool_deque_init(struct thrdpool_deque *dq) {
+    atomic_init(&dq->top, 0);
+    atomic_init(&dq->bottom, 0);
+}
+
+bool thrdpool_deque_push(struct thrdpool_deque *dq, struct thrdpool_task const *task) {
+    ptrdiff_t b = atomic_load_explicit(&dq->bottom, memory_order_relaxed);
+    ptrdiff_t t = atomic_load_explicit(&dq->top, memory_order_acquire);
+
+    if(b - t >= (ptrdiff_t)THRDPOOL_DEQUE_CAPACITY) {
+        return false;
+    }
+
+    thrdpool_deque_slot_store(&dq->slots[thrdpool_deque_mod_size(b)], task);
+    /* Publish the slot along with whatever the task's arguments point to */
+    atomic_store_explicit(&dq->bottom, b + 1, memory_order_release);
+    return true;
+}
+
+bool thrdpool_deque_pop(struct thrdpool_deque *dq, struct thrdpool_task *task) {
+    bool success = true;
+    ptrdiff_t b = atomic_load_explicit(&dq->bottom, memory_order_relaxed) - 1;
+    /* Read-modify-write rather than a store, so that either thieves see the reservation or
+     * the load of top below sees their increments */
+    atomic_exchange_explicit(&dq->bottom, b, memory_order_seq_cst);
+    ptrdiff_t t = atomic_load_explicit(&dq->top, memory_order_seq_cst);
+
+    if(t > b) {
+        /* Empty */
+        atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+        return false;
+    }
+
+    thrdpool_deque_slot_load(&dq->slots[thrdpool_deque_mod_size(b)], task);
+    if(t == b) {
+        /* Last task, race any thieves for it */
+        success = atomic_compare_exchange_strong_explicit(&dq->top, &t, t + 1,
+                                                          memory_order_seq_cst,
+                                                          memory_order_relaxed);
+        atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+    }
+    return success;
+}
+
+bool thrdpool_deque_steal(struct thrdpool_deque *dq, struct thrdpool_task *task) {
+    /* Both in the single total order with the owner's reservation in thrdpool_deque_pop */
+    ptrdiff_t t = atomic_load_explicit(&dq->top, memory_order_seq_cst);
+    ptrdiff_t b = atomic_load_explicit(&dq->bottom, memory_order_seq_cst);
+
+    if(t >= b) {
+        return false;
+    }
+
+    thrdpool_deque_slot_load(&dq->slots[thrdpool_deque_mod_size(t)], task);
+    return atomic_compare_exchange_strong_explicit(&dq->top, &t, t + 1,
+                                                   memory_order_seq_cst,
+                                                   memory_order_relaxed);
+}
@@ -0,0 +1,35 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <thrdpool/event.h>
+
+#include <errno.h>
+#include <limits.h>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+unsigned thrdpool_event_prepare(struct thrdpool_event *ev);
+void thrdpool_event_cancel(struct thrdpool_event *ev);
+bool thrdpool_event_signaled(struct thrdpool_event *ev, unsigned key);
+unsigned thrdpool_event_waiters(struct thrdpool_event *ev);
+
+void thrdpool_event_init(struct thrdpool_event *ev) {
+    atomic_init(&ev->seq, 0u);
+    atomic_init(&ev->nwaiters, 0u);
+}
+
+bool thrdpool_event_wait(struct thrdpool_event *ev, unsigned key, struct timespec const *timeout) {
+    bool expired;
+    /* Returns right away if seq has moved past key */
+    expired = syscall(SYS_futex, &ev->seq, FUTEX_WAIT_PRIVATE, key, timeout, 0, 0) == -1 && errno == ETIMEDOUT;
+    atomic_fetch_sub(&ev->nwaiters, 1u);
+    return !expired;
+}
+
+void thrdpool_event_notify(struct thrdpool_event *ev, size_t n) {
+    atomic_fetch_add(&ev->seq, 1u);
+    syscall(SYS_futex, &ev->seq, FUTEX_WAKE_PRIVATE, n < INT_MAX ? (int)n : INT_MAX, 0, 0, 0);
+}
@@ -0,0 +1,301 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <thrdpool/fiber.h>
+#include <thrdpool/thrdpool.h>
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#ifdef __SANITIZE_THREAD__
+#include <sanitizer/tsan_interface.h>
+#define THRDPOOL_FIBER_TSAN
+#endif
+
+enum thrdpool_fiber_state {
+    THRDPOOL_FIBER_DONE,
+    THRDPOOL_FIBER_YIELDED,
+    THRDPOOL_FIBER_AWAITING
+};
+
+/* Stored at the top of the mapping holding the stack of the fiber */
+struct thrdpool_fiber {
+    ucontext_t ctx;
+    /* Context of the worker that last resumed the fiber */
+    ucontext_t *home;
+    struct thrdpool *pool;
+    thrdpool_taskhandle handle;
+    void *args;
+    /* Done once handle has returned, if any */
+    struct thrdpool_group *group;
+    /* Why the fiber last switched back to its worker */
+    enum thrdpool_fiber_state state;
+    struct thrdpool_group *awaiting;
+    /* Next fiber awaiting the same group, or next in the cache */
+    struct thrdpool_fiber *next;
+    void *base;
+    size_t size;
+#ifdef THRDPOOL_FIBER_TSAN
+    void *tsan;
+    void *hometsan;
+#endif
+};
+
+/* Arguments of the task starting a fiber, copied into the task itself */
+struct thrdpool_fiber_start {
+    struct thrdpool *pool;
+    struct thrdpool_group *group;
+    thrdpool_taskhandle handle;
+    void *args;
+};
+
+_Static_assert(sizeof(struct thrdpool_fiber_start) <= THRDPOOL_TASK_INLINE_SIZE,
+               "THRDPOOL_TASK_INLINE_SIZE too small to start fibers");
+
+/* Fiber running on the calling thread, if any */
+static _Thread_local struct thrdpool_fiber *thrdpool_fiber_current;
+static _Thread_local struct thrdpool_fiber *thrdpool_fiber_cache;
+static _Thread_local size_t thrdpool_fiber_ncached;
+
+/* Switch back to the worker that resumed fiber */
+static void thrdpool_fiber_suspend(struct thrdpool_fiber *fiber) {
+#ifdef THRDPOOL_FIBER_TSAN
+    __tsan_switch_to_fiber(fiber->hometsan, 0u);
+#endif
+    swapcontext(&fiber->ctx, fiber->home);
+}
+
+/* Entry point of every fiber. Finished fibers are suspended rather than torn down so
+ * that they may be reused for another task without setting up a new context */
+static void thrdpool_fiber_main(void) {
+    /* Fibers may be resumed by a different thread after suspending, thread-locals must
+     * not be read past this point */
+    struct thrdpool_fiber *fiber = thrdpool_fiber_current;
+
+    while(1) {
+        fiber->handle(fiber->args);
+        fiber->state = THRDPOOL_FIBER_DONE;
+        thrdpool_fiber_suspend(fiber);
+    }
+}
+
+static void thrdpool_fiber_unmap(struct thrdpool_fiber *fiber) {
+#ifdef THRDPOOL_FIBER_TSAN
+    __tsan_destroy_fiber(fiber->tsan);
+#endif
+    if(munmap(fiber->base, fiber->size)) {
+        fprintf(stderr, "Error unmapping fiber: %s\n", strerror(errno));
+    }
+}
+
+/* Make the context of fiber enter thrdpool_fiber_main on the given stack */
+static bool thrdpool_fiber_context(struct thrdpool_fiber *fiber, char *stack, size_t size) {
+    ucontext_t *ctx = &fiber->ctx;
+
+    if(getcontext(ctx)) {
+        fprintf(stderr, "Error getting context: %s\n", strerror(errno));
+        return false;
+    }
+    ctx->uc_stack.ss_sp = stack;
+    ctx->uc_stack.ss_size = size;
+    ctx->uc_link = 0;
+    makecontext(ctx, thrdpool_fiber_main, 0);
+    return true;
+}
+
+/* Take a fiber from the cache of the calling thread or map a new one */
+static struct thrdpool_fiber *thrdpool_fiber_acquire(void) {
+    struct thrdpool_fiber *fiber = thrdpool_fiber_cache;
+    size_t pagesize;
+    size_t size;
+    char *base;
+
+    if(fiber) {
+        thrdpool_fiber_cache = fiber->next;
+        --thrdpool_fiber_ncached;
+        return fiber;
+    }
+
+    pagesize = (size_t)sysconf(_SC_PAGESIZE);
+    size = pagesize + ((THRDPOOL_FIBER_STACK_SIZE + sizeof(*fiber) + THRDPOOL_CACHELINE_SIZE + pagesize - 1u) & ~(pagesize - 1u));
+    base = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if(base == MAP_FAILED) {
+        fprintf(stderr, "Error mapping fiber stack: %s\n", strerror(errno));
+        return 0;
+    }
+
+    /* Overflowing the stack faults on the guard page rather than corrupting memory */
+    if(mprotect(base, pagesize, PROT_NONE)) {
+        fprintf(stderr, "Error protecting guard page: %s\n", strerror(errno));
+        munmap(base, size);
+        return 0;
+    }
+
+    fiber = (struct thrdpool_fiber *)((uintptr_t)(base + size - sizeof(*fiber)) & ~(uintptr_t)(THRDPOOL_CACHELINE_SIZE - 1u));
+    fiber->base = base;
+    fiber->size = size;
+    if(!thrdpool_fiber_context(fiber, base + pagesize, (size_t)((char *)fiber - base) - pagesize)) {
+        munmap(base, size);
+        return 0;
+    }
+
+#ifdef THRDPOOL_FIBER_TSAN
+    fiber->tsan = __tsan_create_fiber(0u);
+#endif
+    return fiber;
+}
+
+static void thrdpool_fiber_release(struct thrdpool_fiber *fiber) {
+    if(thrdpool_fiber_ncached == THRDPOOL_FIBER_CACHE) {
+        thrdpool_fiber_unmap(fiber);
+        return;
+    }
+    fiber->next = thrdpool_fiber_cache;
+    thrdpool_fiber_cache = fiber;
+    ++thrdpool_fiber_ncached;
+}
+
+/* Run the fiber passed as args on the calling thread until it suspends, then act on why
+ * it did. Used as the task handle for resuming fibers */
+static void thrdpool_fiber_resume(void *args) {
+    struct thrdpool_fiber *fiber = args;
+    struct thrdpool_fiber *prev = thrdpool_fiber_current;
+    struct thrdpool_group *group;
+    ucontext_t home;
+    bool resume = true;
+
+    while(resume) {
+        fiber->home = &home;
+        thrdpool_fiber_current = fiber;
+#ifdef THRDPOOL_FIBER_TSAN
+        fiber->hometsan = __tsan_get_current_fiber();
+        __tsan_switch_to_fiber(fiber->tsan, 0u);
+#endif
+        swapcontext(&home, &fiber->ctx);
+        thrdpool_fiber_current = prev;
+
+        resume = false;
+        switch(fiber->state) {
+            case THRDPOOL_FIBER_DONE:
+                group = fiber->group;
+                thrdpool_fiber_release(fiber);
+                if(group) {
+                    thrdpool_group_done(group);
+                }
+                break;
+            case THRDPOOL_FIBER_YIELDED:
+                /* Through the shared queue, a work-stealing worker would otherwise pop it
+                 * off its own deque right away. Resumed on the spot if there is no room */
+                resume = !thrdpool_requeue_internal(fiber->pool, &(struct thrdpool_task) {
+                    .handle = thrdpool_fiber_resume,
+                    .args = fiber
+                });
+                break;
+            case THRDPOOL_FIBER_AWAITING:
+                /* Only linked to the group now that its stack is no longer in use. The
+                 * count is checked under the lock taken by the final thrdpool_group_done */
+                group = fiber->awaiting;
+                pthread_mutex_lock(&group->lock);
+                resume = !atomic_load_explicit(&group->pending, memory_order_acquire);
+                if(!resume) {
+                    fiber->next = group->fibers;
+                    group->fibers = fiber;
+                }
+                pthread_mutex_unlock(&group->lock);
+                break;
+        }
+    }
+}
+
+static void thrdpool_fiber_start(void *args) {
+    struct thrdpool_fiber_start *start = args;
+    struct thrdpool_fiber *fiber = thrdpool_fiber_acquire();
+
+    if(!fiber) {
+        start->handle(start->args);
+        if(start->group) {
+            thrdpool_group_done(start->group);
+        }
+        return;
+    }
+
+    fiber->pool = start->pool;
+    fiber->handle = start->handle;
+    fiber->args = start->args;
+    fiber->group = start->group;
+    thrdpool_fiber_resume(fiber);
+}
+
+bool thrdpool_schedule_fiber_impl(struct thrdpool *pool, struct thrdpool_group *group, thrdpool_taskhandle task, void *args) {
+    struct thrdpool_fiber_start start = {
+        .pool = pool,
+        .group = group,
+        .handle = task,
+        .args = args
+    };
+
+    if(group) {
+        thrdpool_group_add(group, 1u);
+    }
+    if(thrdpool_schedule_copy_impl(pool, thrdpool_fiber_start, &start, sizeof(start))) {
+        return true;
+    }
+    if(group) {
+        thrdpool_group_done(group);
+    }
+    return false;
+}
+
+bool thrdpool_yield(void) {
+    struct thrdpool_fiber *fiber = thrdpool_fiber_current;
+
+    if(!fiber) {
+        return false;
+    }
+    fiber->state = THRDPOOL_FIBER_YIELDED;
+    thrdpool_fiber_suspend(fiber);
+    return true;
+}
+
+void thrdpool_await(struct thrdpool_group *group) {
+    struct thrdpool_fiber *fiber = thrdpool_fiber_current;
+
+    if(!fiber) {
+        thrdpool_group_wait(group);
+        return;
+    }
+    /* Suspended even if the group has already finished, the worker checks under the
+     * group's lock so that it is no longer in use once the fiber resumes */
+    fiber->state = THRDPOOL_FIBER_AWAITING;
+    fiber->awaiting = group;
+    thrdpool_fiber_suspend(fiber);
+}
+
+void thrdpool_fiber_wake(struct thrdpool_fiber *fibers) {
+    struct thrdpool_fiber *next;
+
+    for(; fibers; fibers = next) {
+        next = fibers->next;
+        thrdpool_schedule_wait_impl(fibers->pool, &(struct thrdpool_task) {
+            .handle = thrdpool_fiber_resume,
+            .args = fibers
+        }, 0);
+    }
+}
+
+void thrdpool_fiber_cleanup(void) {
+    struct thrdpool_fiber *fiber;
+
+    while((fiber = thrdpool_fiber_cache)) {
+        thrdpool_fiber_cache = fiber->next;
+        thrdpool_fiber_unmap(fiber);
+    }
+    thrdpool_fiber_ncached = 0u;
+}
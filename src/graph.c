@@ -0,0 +1,125 @@
+#include <thrdpool/graph.h>
+#include <thrdpool/thrdpool.h>
+
+/* Run the node and release its successors. The first successor to become ready is run
+ * next on the same thread while what its predecessor produced is still in cache, the
+ * task of the node accounts for it in the graph's group */
+static void thrdpool_node_run(void *args) {
+    struct thrdpool_task ready[THRDPOOL_BATCH_CAPACITY];
+    struct thrdpool_node *node = args;
+    struct thrdpool_node *next;
+    struct thrdpool_graph *graph = node->graph;
+    size_t nready;
+
+    for(; node; node = next) {
+        node->handle(node->args);
+
+        next = 0;
+        nready = 0u;
+        for(struct thrdpool_edge *edge = node->succs; edge; edge = edge->next) {
+            /* Orders everything the predecessors did before the successor runs */
+            if(atomic_fetch_sub_explicit(&edge->to->pending, 1u, memory_order_acq_rel) != 1u) {
+                continue;
+            }
+            if(!next) {
+                next = edge->to;
+                continue;
+            }
+
+            ready[nready++] = (struct thrdpool_task) {
+                .handle = thrdpool_node_run,
+                .args = edge->to,
+                .group = &graph->group
+            };
+            if(nready == thrdpool_arrsize(ready)) {
+                thrdpool_schedule_or_run_internal(graph->pool, ready, nready);
+                nready = 0u;
+            }
+        }
+        thrdpool_schedule_or_run_internal(graph->pool, ready, nready);
+    }
+}
+
+bool thrdpool_graph_init_impl(struct thrdpool_graph *graph, struct thrdpool_node *nodes, size_t nodecap,
+                              struct thrdpool_edge *edges, size_t edgecap) {
+    graph->pool = 0;
+    graph->nodes = nodes;
+    graph->nnodes = 0u;
+    graph->nodecap = nodecap;
+    graph->edges = edges;
+    graph->nedges = 0u;
+    graph->edgecap = edgecap;
+    return thrdpool_group_init(&graph->group);
+}
+
+bool thrdpool_graph_destroy_impl(struct thrdpool_graph *graph) {
+    return thrdpool_group_destroy(&graph->group);
+}
+
+struct thrdpool_node *thrdpool_graph_node_impl(struct thrdpool_graph *graph, thrdpool_taskhandle handle, void *args) {
+    struct thrdpool_node *node;
+
+    if(graph->nnodes == graph->nodecap) {
+        return 0;
+    }
+
+    node = &graph->nodes[graph->nnodes++];
+    node->handle = handle;
+    node->args = args;
+    node->graph = graph;
+    node->succs = 0;
+    node->npreds = 0u;
+    atomic_init(&node->pending, 0u);
+    return node;
+}
+
+bool thrdpool_graph_edge_impl(struct thrdpool_graph *graph, struct thrdpool_node *from, struct thrdpool_node *to) {
+    struct thrdpool_edge *edge;
+
+    if(graph->nedges == graph->edgecap) {
+        return false;
+    }
+
+    edge = &graph->edges[graph->nedges++];
+    edge->to = to;
+    edge->next = from->succs;
+    from->succs = edge;
+    ++to->npreds;
+    return true;
+}
+
+bool thrdpool_graph_submit_impl(struct thrdpool *pool, struct thrdpool_graph *graph) {
+    struct thrdpool_node *node;
+    bool success = true;
+
+    if(thrdpool_group_pending(&graph->group)) {
+        return false;
+    }
+
+    graph->pool = pool;
+    for(size_t i = 0u; i < graph->nnodes; i++) {
+        atomic_store_explicit(&graph->nodes[i].pending, graph->nodes[i].npreds, memory_order_relaxed);
+    }
+
+    /* The queue releases the counts above along with the tasks */
+    for(size_t i = 0u; i < graph->nnodes && success; i++) {
+        node = &graph->nodes[i];
+        if(!node->npreds) {
+            success = thrdpool_schedule_wait_impl(pool, &(struct thrdpool_task) {
+                .handle = thrdpool_node_run,
+                .args = node,
+                .group = &graph->group
+            }, 0);
+        }
+    }
+    return success;
+}
+
+void thrdpool_graph_wait_impl(struct thrdpool_graph *graph) {
+    if(graph->pool) {
+        thrdpool_sync_impl(graph->pool, &graph->group);
+    }
+    else {
+        thrdpool_group_wait(&graph->group);
+    }
+}
@@ -0,0 +1,87 @@
+#include <thrdpool/group.h>
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+void thrdpool_group_add(struct thrdpool_group *group, size_t ntasks);
+size_t thrdpool_group_pending(struct thrdpool_group *group);
+
+bool thrdpool_group_init(struct thrdpool_group *group) {
+    int err;
+
+    atomic_init(&group->pending, 0u);
+    group->fibers = 0;
+
+    err = pthread_mutex_init(&group->lock, 0);
+    if(err) {
+        fprintf(stderr, "Error initializing mutex: %s\n", strerror(err));
+        return false;
+    }
+
+    err = pthread_cond_init(&group->cv, 0);
+    if(err) {
+        fprintf(stderr, "Error intializing condition variable: %s\n", strerror(err));
+        pthread_mutex_destroy(&group->lock);
+        return false;
+    }
+
+    return true;
+}
+
+bool thrdpool_group_destroy(struct thrdpool_group *group) {
+    bool success = true;
+    int err;
+
+    err = pthread_mutex_destroy(&group->lock);
+    if(err) {
+        fprintf(stderr, "Error destroying mutex: %s\n", strerror(err));
+        success = false;
+    }
+    err = pthread_cond_destroy(&group->cv);
+    if(err) {
+        fprintf(stderr, "Error destroying condition variable: %s\n", strerror(err));
+        success = false;
+    }
+
+    return success;
+}
+
+void thrdpool_group_wait(struct thrdpool_group *group) {
+    /* Always take the lock, the task bringing the count to zero may otherwise
+     * still be using the group once this returns */
+    pthread_mutex_lock(&group->lock);
+    while(atomic_load_explicit(&group->pending, memory_order_acquire)) {
+        pthread_cond_wait(&group->cv, &group->lock);
+    }
+    pthread_mutex_unlock(&group->lock);
+}
+
+void thrdpool_group_done(struct thrdpool_group *group) {
+    struct thrdpool_fiber *fibers = 0;
+    size_t pending = atomic_load_explicit(&group->pending, memory_order_relaxed);
+
+    /* A task marked done twice would have let a waiter destroy the group under it */
+    assert(pending);
+
+    /* Only the final decrement needs the lock */
+    while(pending > 1u) {
+        if(atomic_compare_exchange_weak_explicit(&group->pending, &pending, pending - 1u,
+                                                 memory_order_release, memory_order_relaxed)) {
+            return;
+        }
+    }
+
+    pthread_mutex_lock(&group->lock);
+    if(atomic_fetch_sub_explicit(&group->pending, 1u, memory_order_acq_rel) == 1u) {
+        pthread_cond_broadcast(&group->cv);
+        fibers = group->fibers;
+        group->fibers = 0;
+    }
+    pthread_mutex_unlock(&group->lock);
+
+    /* The group may be gone once unlocked, only the detached fibers are touched */
+    if(fibers) {
+        thrdpool_fiber_wake(fibers);
+    }
+}
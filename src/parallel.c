@@ -0,0 +1,212 @@
+#include <thrdpool/parallel.h>
+#include <thrdpool/thrdpool.h>
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Partial result of a reduction, one per worker and one for an outside caller */
+struct thrdpool_reduce_slot {
+    _Alignas(THRDPOOL_CACHELINE_SIZE) unsigned char acc[THRDPOOL_REDUCE_SIZE];
+    bool used;
+};
+
+struct thrdpool_range {
+    _Alignas(THRDPOOL_CACHELINE_SIZE) atomic_size_t next;
+    size_t end;
+    size_t grain;
+    size_t nthreads;
+    struct thrdpool *pool;
+    void *ctx;
+    /* parallel_for */
+    thrdpool_rangehandle func;
+    /* parallel_reduce */
+    thrdpool_foldhandle fold;
+    thrdpool_combinehandle combine;
+    void const *identity;
+    size_t accsize;
+    struct thrdpool_reduce_slot *slots;
+};
+
+/* Claim the next chunk of the range. Chunks shrink with the remaining work, down to
+ * the grain size, so that early chunks amortize the cost of claiming while the last
+ * ones even out the load */
+static bool thrdpool_range_claim(struct thrdpool_range *range, size_t *lo, size_t *hi) {
+    size_t chunk;
+    size_t next = atomic_load_explicit(&range->next, memory_order_relaxed);
+
+    do {
+        if(next >= range->end) {
+            return false;
+        }
+        chunk = (range->end - next) / (2u * range->nthreads);
+        if(chunk < range->grain) {
+            chunk = range->grain;
+        }
+        if(chunk > range->end - next) {
+            chunk = range->end - next;
+        }
+    } while(!atomic_compare_exchange_weak_explicit(&range->next, &next, next + chunk,
+                                                   memory_order_relaxed, memory_order_relaxed));
+
+    *lo = next;
+    *hi = next + chunk;
+    return true;
+}
+
+static void thrdpool_range_run(void *args) {
+    struct thrdpool_range *range = args;
+    size_t lo;
+    size_t hi;
+
+    while(thrdpool_range_claim(range, &lo, &hi)) {
+        range->func(lo, hi, range->ctx);
+    }
+}
+
+static void thrdpool_range_reduce(void *args) {
+    struct thrdpool_range *range = args;
+    struct thrdpool_reduce_slot *slot;
+    _Alignas(THRDPOOL_CACHELINE_SIZE) unsigned char acc[THRDPOOL_REDUCE_SIZE];
+    size_t lo;
+    size_t hi;
+
+    if(!thrdpool_range_claim(range, &lo, &hi)) {
+        return;
+    }
+
+    /* Fold into a local accumulator first, the worker's slot may already be in use
+     * further up the stack if fold itself waits on the pool */
+    memcpy(acc, range->identity, range->accsize);
+    do {
+        range->fold(lo, hi, acc, range->ctx);
+    } while(thrdpool_range_claim(range, &lo, &hi));
+
+    /* Only the owning worker ever touches its slot */
+    slot = &range->slots[thrdpool_worker_id_impl(range->pool)];
+    if(slot->used) {
+        range->combine(slot->acc, acc, range->ctx);
+    }
+    else {
+        memcpy(slot->acc, acc, range->accsize);
+        slot->used = true;
+    }
+}
+
+/* Run handle on the calling thread and on up to one helper task per worker, returns
+ * once the whole range has been claimed and processed */
+static void thrdpool_range_exec(struct thrdpool_range *range, thrdpool_taskhandle handle) {
+    struct thrdpool_task tasks[THRDPOOL_BATCH_CAPACITY];
+    struct thrdpool_group group;
+    struct thrdpool *pool = range->pool;
+    size_t nhelpers = range->nthreads - 1u;
+    size_t ntasks;
+
+    if(!nhelpers || !thrdpool_group_init(&group)) {
+        range->nthreads = 1u;
+        handle(range);
+        return;
+    }
+
+    for(size_t i = 0u; i < thrdpool_arrsize(tasks); i++) {
+        tasks[i] = (struct thrdpool_task) {
+            .handle = handle,
+            .args = range,
+            .group = &group
+        };
+    }
+
+    /* Helpers that do not fit in the queue are not needed for correctness */
+    while(nhelpers) {
+        ntasks = nhelpers < thrdpool_arrsize(tasks) ? nhelpers : thrdpool_arrsize(tasks);
+        ntasks = thrdpool_schedule_batch_impl(pool, tasks, ntasks);
+        if(!ntasks) {
+            break;
+        }
+        nhelpers -= ntasks;
+    }
+
+    handle(range);
+
+    /* Helpers still in the queue hold a reference to the range */
+    thrdpool_sync_impl(pool, &group);
+    thrdpool_group_destroy(&group);
+}
+
+/* Set up range for [begin, end), returns false if the range is empty */
+static bool thrdpool_range_init(struct thrdpool_range *range, struct thrdpool *pool, size_t begin, size_t end, size_t grain, void *ctx) {
+    size_t nchunks;
+    size_t size = atomic_load(&pool->size);
+
+    if(begin >= end) {
+        return false;
+    }
+
+    if(!grain) {
+        grain = (end - begin) / (THRDPOOL_PARALLEL_CHUNKS * (size + 1u));
+        if(!grain) {
+            grain = 1u;
+        }
+    }
+
+    /* One helper per worker at most, the calling thread takes part as well */
+    nchunks = (end - begin) / grain + ((end - begin) % grain != 0u);
+
+    atomic_init(&range->next, begin);
+    range->end = end;
+    range->grain = grain;
+    range->nthreads = (nchunks - 1u < size ? nchunks - 1u : size) + 1u;
+    range->pool = pool;
+    range->ctx = ctx;
+    return true;
+}
+
+void thrdpool_parallel_for_impl(struct thrdpool *pool, size_t begin, size_t end, size_t grain, thrdpool_rangehandle func, void *ctx) {
+    struct thrdpool_range range;
+
+    if(!thrdpool_range_init(&range, pool, begin, end, grain, ctx)) {
+        return;
+    }
+
+    range.func = func;
+    thrdpool_range_exec(&range, thrdpool_range_run);
+}
+
+bool thrdpool_parallel_reduce_impl(struct thrdpool *pool, size_t begin, size_t end, size_t grain, void *result, void const *identity, size_t size, thrdpool_foldhandle fold, thrdpool_combinehandle combine, void *ctx) {
+    struct thrdpool_range range;
+    struct thrdpool_reduce_slot *slots;
+    size_t nslots = pool->capacity + 1u;
+
+    if(size > THRDPOOL_REDUCE_SIZE) {
+        return false;
+    }
+
+    if(!thrdpool_range_init(&range, pool, begin, end, grain, ctx)) {
+        return true;
+    }
+
+    /* On the heap, as the slots scale with the capacity of the pool */
+    slots = aligned_alloc(_Alignof(struct thrdpool_reduce_slot), nslots * sizeof(*slots));
+    if(!slots) {
+        return false;
+    }
+    for(size_t i = 0u; i < nslots; i++) {
+        slots[i].used = false;
+    }
+
+    range.fold = fold;
+    range.combine = combine;
+    range.identity = identity;
+    range.accsize = size;
+    range.slots = slots;
+    thrdpool_range_exec(&range, thrdpool_range_reduce);
+
+    /* The group wait orders all writes to the slots before this point */
+    for(size_t i = 0u; i < nslots; i++) {
+        if(slots[i].used) {
+            combine(result, slots[i].acc, ctx);
+        }
+    }
+    free(slots);
+    return true;
+}
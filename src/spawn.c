@@ -0,0 +1,37 @@
+#include <thrdpool/spawn.h>
+#include <thrdpool/thrdpool.h>
+
+#include <sched.h>
+
+bool thrdpool_spawn_impl(struct thrdpool *pool, struct thrdpool_group *group, thrdpool_taskhandle task, void *args) {
+    return thrdpool_schedule_wait_impl(pool, &(struct thrdpool_task) {
+        .handle = task,
+        .args = args,
+        .group = group
+    }, 0);
+}
+
+void thrdpool_sync_impl(struct thrdpool *pool, struct thrdpool_group *group) {
+    unsigned nyields = 0u;
+
+    if(thrdpool_worker_id_impl(pool) < pool->capacity) {
+        /* Children may still be spawning tasks of their own on other workers, a brief
+         * lull in the queue does not mean there is nothing left to help with */
+        while(thrdpool_group_pending(group)) {
+            if(thrdpool_help_internal(pool)) {
+                nyields = 0u;
+                continue;
+            }
+            if(nyields++ == THRDPOOL_SYNC_YIELDS) {
+                thrdpool_blocking_begin();
+                thrdpool_group_wait(group);
+                thrdpool_blocking_end();
+                return;
+            }
+            sched_yield();
+        }
+    }
+
+    /* Also waits for the task that finished the group to be done with it */
+    thrdpool_group_wait(group);
+}
@@ -0,0 +1,102 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <thrdpool/stats.h>
+#include <thrdpool/thrdpool.h>
+
+#include <string.h>
+#include <time.h>
+
+size_t thrdpool_stats_bucket(uint64_t ns);
+
+#ifdef THRDPOOL_STATS
+
+void thrdpool_counter_add(atomic_uint_least64_t *counter, uint64_t n);
+
+void thrdpool_counters_init(struct thrdpool_counters *counters) {
+    atomic_init(&counters->executed, 0u);
+    atomic_init(&counters->steals, 0u);
+    atomic_init(&counters->busy_ns, 0u);
+    atomic_init(&counters->idle_ns, 0u);
+    for(size_t i = 0u; i < THRDPOOL_STATS_BUCKETS; i++) {
+        atomic_init(&counters->wait[i], 0u);
+        atomic_init(&counters->run[i], 0u);
+    }
+}
+
+uint64_t thrdpool_stats_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* Add the counters of a worker to stats. The counters are read one at a time while the
+ * worker keeps running, so they are only guaranteed to be consistent when it is idle */
+static void thrdpool_stats_accumulate(struct thrdpool_stats *stats, struct thrdpool_counters *counters) {
+    stats->executed += atomic_load_explicit(&counters->executed, memory_order_relaxed);
+    stats->steals += atomic_load_explicit(&counters->steals, memory_order_relaxed);
+    stats->busy_ns += atomic_load_explicit(&counters->busy_ns, memory_order_relaxed);
+    stats->idle_ns += atomic_load_explicit(&counters->idle_ns, memory_order_relaxed);
+    for(size_t i = 0u; i < THRDPOOL_STATS_BUCKETS; i++) {
+        stats->wait[i] += atomic_load_explicit(&counters->wait[i], memory_order_relaxed);
+        stats->run[i] += atomic_load_explicit(&counters->run[i], memory_order_relaxed);
+    }
+}
+
+bool thrdpool_stats_impl(struct thrdpool *pool, struct thrdpool_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    for(size_t i = 0u; i < pool->capacity; i++) {
+        thrdpool_stats_accumulate(stats, &pool->workers[i].counters);
+    }
+    stats->rejected = atomic_load_explicit(&pool->rejected, memory_order_relaxed);
+    return true;
+}
+
+bool thrdpool_worker_stats_impl(struct thrdpool *pool, size_t worker, struct thrdpool_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if(worker >= pool->capacity) {
+        return false;
+    }
+    thrdpool_stats_accumulate(stats, &pool->workers[worker].counters);
+    return true;
+}
+
+#else
+
+bool thrdpool_stats_impl(struct thrdpool *pool, struct thrdpool_stats *stats) {
+    (void)pool;
+    memset(stats, 0, sizeof(*stats));
+    return false;
+}
+
+bool thrdpool_worker_stats_impl(struct thrdpool *pool, size_t worker, struct thrdpool_stats *stats) {
+    (void)pool;
+    (void)worker;
+    memset(stats, 0, sizeof(*stats));
+    return false;
+}
+
+#endif
+
+uint64_t thrdpool_stats_quantile(uint64_t const *hist, double q) {
+    uint64_t total = 0u;
+    uint64_t rank;
+    uint64_t seen = 0u;
+
+    for(size_t i = 0u; i < THRDPOOL_STATS_BUCKETS; i++) {
+        total += hist[i];
+    }
+    if(!total) {
+        return 0u;
+    }
+
+    q = q < 0.0 ? 0.0 : q > 1.0 ? 1.0 : q;
+    /* 1-based rank of the sample sought */
+    rank = (uint64_t)(q * (double)(total - 1u)) + 1u;
+    for(size_t i = 0u; i < THRDPOOL_STATS_BUCKETS - 1u; i++) {
+        seen += hist[i];
+        if(seen >= rank) {
+            return (UINT64_C(2) << i) - 1u;
+        }
+    }
+    return UINT64_MAX;
+}
@@ -0,0 +1,174 @@
+#include <thrdpool/strand.h>
+#include <thrdpool/thrdpool.h>
+
+#include <stdio.h>
+#include <string.h>
+
+/* Run the tasks of the strand passed as args until none are left. After a full batch,
+ * moves to the back of the queue so that a busy strand does not hold on to its worker.
+ * The group of each task is only done once the strand has moved on, so that it is idle
+ * by the time the group of its last task finishes */
+static void thrdpool_strand_run(void *args) {
+    struct thrdpool_strand *strand = args;
+    struct thrdpool_group *done = 0;
+    struct thrdpool_task task;
+    bool requeued;
+
+    for(unsigned i = 0u;; i++) {
+        pthread_mutex_lock(&strand->lock);
+        if(!strand->size) {
+            strand->active = false;
+            pthread_mutex_unlock(&strand->lock);
+            break;
+        }
+
+        if(i == THRDPOOL_STRAND_BATCH) {
+            pthread_mutex_unlock(&strand->lock);
+            requeued = thrdpool_requeue_internal(strand->pool, &(struct thrdpool_task) {
+                .handle = thrdpool_strand_run,
+                .args = strand
+            });
+            if(requeued) {
+                break;
+            }
+            /* Keeps running on the spot if there is no room */
+            i = 0u;
+            pthread_mutex_lock(&strand->lock);
+        }
+
+        task = strand->tasks[strand->start];
+        strand->start = (strand->start + 1u) % strand->capacity;
+        --strand->size;
+        pthread_mutex_unlock(&strand->lock);
+
+        if(done) {
+            thrdpool_group_done(done);
+        }
+        task.handle(thrdpool_task_args(&task));
+        done = task.group;
+    }
+
+    if(done) {
+        thrdpool_group_done(done);
+    }
+}
+
+/* Drop the tasks of a strand that nothing will drain, marking their groups done the way
+ * thrdpool_strand_run does, and leave it inactive */
+static void thrdpool_strand_discard(struct thrdpool_strand *strand) {
+    struct thrdpool_group *done = 0;
+    struct thrdpool_task task;
+
+    while(1) {
+        pthread_mutex_lock(&strand->lock);
+        if(!strand->size) {
+            strand->active = false;
+            pthread_mutex_unlock(&strand->lock);
+            break;
+        }
+        task = strand->tasks[strand->start];
+        strand->start = (strand->start + 1u) % strand->capacity;
+        --strand->size;
+        pthread_mutex_unlock(&strand->lock);
+
+        if(done) {
+            thrdpool_group_done(done);
+        }
+        done = task.group;
+    }
+
+    if(done) {
+        thrdpool_group_done(done);
+    }
+}
+
+bool thrdpool_strand_discard_internal(struct thrdpool_task const *task) {
+    if(task->handle != thrdpool_strand_run) {
+        return false;
+    }
+    thrdpool_strand_discard(thrdpool_task_args(task));
+    return true;
+}
+
+bool thrdpool_strand_init_impl(struct thrdpool_strand *strand, struct thrdpool_task *tasks, size_t capacity) {
+    int err;
+
+    strand->pool = 0;
+    strand->tasks = tasks;
+    strand->capacity = capacity;
+    strand->start = 0u;
+    strand->size = 0u;
+    strand->active = false;
+
+    err = pthread_mutex_init(&strand->lock, 0);
+    if(err) {
+        fprintf(stderr, "Error initializing mutex: %s\n", strerror(err));
+        return false;
+    }
+    return true;
+}
+
+bool thrdpool_strand_destroy_impl(struct thrdpool_strand *strand) {
+    bool active;
+    int err;
+
+    pthread_mutex_lock(&strand->lock);
+    active = strand->active;
+    pthread_mutex_unlock(&strand->lock);
+    if(active) {
+        return false;
+    }
+
+    err = pthread_mutex_destroy(&strand->lock);
+    if(err) {
+        fprintf(stderr, "Error destroying mutex: %s\n", strerror(err));
+        return false;
+    }
+    return true;
+}
+
+bool thrdpool_strand_post_impl(struct thrdpool *pool, struct thrdpool_strand *strand, struct thrdpool_task const *task) {
+    bool activate;
+
+    if(task->group) {
+        thrdpool_group_add(task->group, 1u);
+    }
+
+    pthread_mutex_lock(&strand->lock);
+    if(strand->size == strand->capacity) {
+        pthread_mutex_unlock(&strand->lock);
+        if(task->group) {
+            thrdpool_group_done(task->group);
+        }
+        return false;
+    }
+    strand->tasks[(strand->start + strand->size++) % strand->capacity] = *task;
+    activate = !strand->active;
+    if(activate) {
+        strand->active = true;
+        strand->pool = pool;
+    }
+    pthread_mutex_unlock(&strand->lock);
+
+    if(!activate || thrdpool_schedule_wait_impl(pool, &(struct thrdpool_task) {
+        .handle = thrdpool_strand_run,
+        .args = strand
+    }, 0)) {
+        return true;
+    }
+
+    /* The pool is being destroyed. Tasks posted while the draining task was being scheduled
+     * saw the strand active and were accepted, so they are discarded along with this one, as
+     * the pool does with those still queued */
+    thrdpool_strand_discard(strand);
+    return false;
+}
+
+size_t thrdpool_strand_pending_impl(struct thrdpool_strand *strand) {
+    size_t size;
+
+    pthread_mutex_lock(&strand->lock);
+    size = strand->size;
+    pthread_mutex_unlock(&strand->lock);
+    return size;
+}
@@ -1,3 +1,4 @@
 #include <thrdpool/task.h>
 
+void *thrdpool_task_args(struct thrdpool_task const *task);
 void thrdpool_call(struct thrdpool_task const *task);
@@ -1,10 +1,346 @@
 #include <thrdpool/taskq.h>
 
+#include <stdlib.h>
+#include <string.h>
+
 void thrdpool_taskq_pop_front(struct thrdpool_taskq *q);
 void thrdpool_taskq_pop_back(struct thrdpool_taskq *q);
 size_t thrdpool_taskq_size(struct thrdpool_taskq const *q);
 void thrdpool_taskq_clear(struct thrdpool_taskq *q);
 
+#ifdef THRDPOOL_TASKQ_LOCKFREE
+
+bool thrdpool_taskq_push(struct thrdpool_taskq *q, thrdpool_taskhandle task, void *args) {
+    struct thrdpool_taskq_slot *slot;
+    size_t prev;
+    size_t end = atomic_load_explicit(&q->end, memory_order_acquire);
+
+    while(1) {
+        slot = &q->tasks[thrdpool_mod_size(end)];
+        if(atomic_load_explicit(&slot->turn, memory_order_acquire) == thrdpool_taskq_lap(end) * 2u) {
+            if(atomic_compare_exchange_strong(&q->end, &end, end + 1u)) {
+                break;
+            }
+        }
+        else {
+            /* Slot still occupied, the queue is full unless another producer got there first */
+            prev = end;
+            end = atomic_load_explicit(&q->end, memory_order_acquire);
+            if(end == prev) {
+                return false;
+            }
+        }
+    }
+
+    slot->task = (struct thrdpool_task) {
+        .handle = task,
+        .args = args
+    };
+    atomic_store_explicit(&slot->turn, thrdpool_taskq_lap(end) * 2u + 1u, memory_order_release);
+    return true;
+}
+
+size_t thrdpool_taskq_push_batch(struct thrdpool_taskq *restrict q, struct thrdpool_task const *restrict tasks, size_t ntasks) {
+    size_t n;
+    size_t prev;
+    size_t end = atomic_load_explicit(&q->end, memory_order_acquire);
+
+    while(1) {
+        /* Slots free on the current lap stay free until end is moved past them */
+        for(n = 0u; n < ntasks && n < thrdpool_arrsize(q->tasks); n++) {
+            if(atomic_load_explicit(&q->tasks[thrdpool_mod_size(end + n)].turn, memory_order_acquire) !=
+               thrdpool_taskq_lap(end + n) * 2u) {
+                break;
+            }
+        }
+
+        if(n) {
+            if(atomic_compare_exchange_strong(&q->end, &end, end + n)) {
+                break;
+            }
+        }
+        else {
+            prev = end;
+            end = atomic_load_explicit(&q->end, memory_order_acquire);
+            if(end == prev) {
+                return 0u;
+            }
+        }
+    }
+
+    for(size_t i = 0u; i < n; i++) {
+        struct thrdpool_taskq_slot *slot = &q->tasks[thrdpool_mod_size(end + i)];
+        slot->task = tasks[i];
+        atomic_store_explicit(&slot->turn, thrdpool_taskq_lap(end + i) * 2u + 1u, memory_order_release);
+    }
+    return n;
+}
+
+bool thrdpool_taskq_pop(struct thrdpool_taskq *q, struct thrdpool_task *task) {
+    struct thrdpool_taskq_slot *slot;
+    size_t prev;
+    size_t start = atomic_load_explicit(&q->start, memory_order_acquire);
+
+    while(1) {
+        slot = &q->tasks[thrdpool_mod_size(start)];
+        if(atomic_load_explicit(&slot->turn, memory_order_acquire) == thrdpool_taskq_lap(start) * 2u + 1u) {
+            if(atomic_compare_exchange_strong(&q->start, &start, start + 1u)) {
+                break;
+            }
+        }
+        else {
+            prev = start;
+            start = atomic_load_explicit(&q->start, memory_order_acquire);
+            if(start == prev) {
+                return false;
+            }
+        }
+    }
+
+    *task = slot->task;
+    atomic_store_explicit(&slot->turn, thrdpool_taskq_lap(start) * 2u + 2u, memory_order_release);
+    return true;
+}
+
+size_t thrdpool_taskq_pop_batch(struct thrdpool_taskq *restrict q, struct thrdpool_task *restrict tasks, size_t ntasks) {
+    size_t n;
+    size_t prev;
+    size_t start = atomic_load_explicit(&q->start, memory_order_acquire);
+
+    while(1) {
+        /* Slots filled on the current lap stay filled until start is moved past them */
+        for(n = 0u; n < ntasks && n < thrdpool_arrsize(q->tasks); n++) {
+            if(atomic_load_explicit(&q->tasks[thrdpool_mod_size(start + n)].turn, memory_order_acquire) !=
+               thrdpool_taskq_lap(start + n) * 2u + 1u) {
+                break;
+            }
+        }
+
+        if(n) {
+            if(atomic_compare_exchange_strong(&q->start, &start, start + n)) {
+                break;
+            }
+        }
+        else {
+            prev = start;
+            start = atomic_load_explicit(&q->start, memory_order_acquire);
+            if(start == prev) {
+                return 0u;
+            }
+        }
+    }
+
+    for(size_t i = 0u; i < n; i++) {
+        struct thrdpool_taskq_slot *slot = &q->tasks[thrdpool_mod_size(start + i)];
+        tasks[i] = slot->task;
+        atomic_store_explicit(&slot->turn, thrdpool_taskq_lap(start + i) * 2u + 2u, memory_order_release);
+    }
+    return n;
+}
+
+struct thrdpool_task *thrdpool_taskq_front(struct thrdpool_taskq *q) {
+    size_t start = atomic_load_explicit(&q->start, memory_order_acquire);
+    struct thrdpool_taskq_slot *slot = &q->tasks[thrdpool_mod_size(start)];
+    if(atomic_load_explicit(&slot->turn, memory_order_acquire) != thrdpool_taskq_lap(start) * 2u + 1u) {
+        return 0;
+    }
+    return &slot->task;
+}
+
+void thrdpool_taskq_destroy(struct thrdpool_taskq *q) {
+    (void)q;
+}
+
+#elif defined THRDPOOL_TASKQ_SEGMENTED
+
+static struct thrdpool_taskq_segment *thrdpool_taskq_segment_acquire(struct thrdpool_taskq *q) {
+    struct thrdpool_taskq_segment *seg = q->spare;
+    if(seg) {
+        q->spare = seg->next;
+        --q->nspare;
+    }
+    else {
+        seg = malloc(sizeof(*seg));
+        if(!seg) {
+            return 0;
+        }
+        ++q->nsegments;
+    }
+    seg->next = 0;
+    return seg;
+}
+
+static void thrdpool_taskq_segment_release(struct thrdpool_taskq *q, struct thrdpool_taskq_segment *seg) {
+    if(q->nspare < THRDPOOL_TASKQ_SPARE_SEGMENTS) {
+        seg->next = q->spare;
+        q->spare = seg;
+        ++q->nspare;
+    }
+    else {
+        free(seg);
+        --q->nsegments;
+    }
+}
+
+/* Make room for at least one more task at the end of the queue */
+static bool thrdpool_taskq_reserve(struct thrdpool_taskq *q) {
+    struct thrdpool_taskq_segment *seg;
+
+    if(q->size == THRDPOOL_TASKQ_CAPACITY) {
+        return false;
+    }
+    if(q->tail && q->end < THRDPOOL_TASKQ_SEGMENT_SIZE) {
+        return true;
+    }
+
+    seg = thrdpool_taskq_segment_acquire(q);
+    if(!seg) {
+        return false;
+    }
+
+    if(q->tail) {
+        q->tail->next = seg;
+    }
+    else {
+        q->head = seg;
+        q->start = 0u;
+    }
+    q->tail = seg;
+    q->end = 0u;
+    return true;
+}
+
+bool thrdpool_taskq_push(struct thrdpool_taskq *q, thrdpool_taskhandle task, void *args) {
+    if(!thrdpool_taskq_reserve(q)) {
+        return false;
+    }
+    q->tail->tasks[q->end++] = (struct thrdpool_task) {
+        .handle = task,
+        .args = args
+    };
+    ++q->size;
+    return true;
+}
+
+bool thrdpool_taskq_pop(struct thrdpool_taskq *q, struct thrdpool_task *task) {
+    if(!q->size) {
+        return false;
+    }
+    *task = q->head->tasks[q->start];
+    thrdpool_taskq_pop_front(q);
+    return true;
+}
+
+size_t thrdpool_taskq_push_batch(struct thrdpool_taskq *restrict q, struct thrdpool_task const *restrict tasks, size_t ntasks) {
+    size_t n = 0u;
+    size_t chunk;
+
+    while(n < ntasks && thrdpool_taskq_reserve(q)) {
+        chunk = THRDPOOL_TASKQ_SEGMENT_SIZE - q->end;
+        if(chunk > ntasks - n) {
+            chunk = ntasks - n;
+        }
+        if(chunk > THRDPOOL_TASKQ_CAPACITY - q->size) {
+            chunk = THRDPOOL_TASKQ_CAPACITY - q->size;
+        }
+        memcpy(&q->tail->tasks[q->end], &tasks[n], chunk * sizeof(*tasks));
+        q->end += chunk;
+        q->size += chunk;
+        n += chunk;
+    }
+    return n;
+}
+
+size_t thrdpool_taskq_pop_batch(struct thrdpool_taskq *restrict q, struct thrdpool_task *restrict tasks, size_t ntasks) {
+    size_t n = 0u;
+    size_t chunk;
+
+    while(n < ntasks && q->size) {
+        chunk = (q->head == q->tail ? q->end : THRDPOOL_TASKQ_SEGMENT_SIZE) - q->start;
+        if(chunk > ntasks - n) {
+            chunk = ntasks - n;
+        }
+        memcpy(&tasks[n], &q->head->tasks[q->start], chunk * sizeof(*tasks));
+        n += chunk;
+        /* Moves on to the next segment, if any, once the head one is drained */
+        q->start += chunk - 1u;
+        q->size -= chunk - 1u;
+        thrdpool_taskq_pop_front(q);
+    }
+    return n;
+}
+
+struct thrdpool_task *thrdpool_taskq_front(struct thrdpool_taskq *q) {
+    if(!q->size) {
+        return 0;
+    }
+    return &q->head->tasks[q->start];
+}
+
+void thrdpool_taskq_pop_front(struct thrdpool_taskq *q) {
+    struct thrdpool_taskq_segment *next;
+    assert(q->size);
+
+    --q->size;
+    ++q->start;
+    if(!q->size) {
+        /* Keep the last segment, rewinding it */
+        while(q->head != q->tail) {
+            next = q->head->next;
+            thrdpool_taskq_segment_release(q, q->head);
+            q->head = next;
+        }
+        q->start = 0u;
+        q->end = 0u;
+    }
+    else if(q->start == THRDPOOL_TASKQ_SEGMENT_SIZE) {
+        next = q->head->next;
+        thrdpool_taskq_segment_release(q, q->head);
+        q->head = next;
+        q->start = 0u;
+    }
+}
+
+void thrdpool_taskq_pop_back(struct thrdpool_taskq *q) {
+    struct thrdpool_taskq_segment *prev;
+    assert(q->size);
+
+    --q->size;
+    if(!q->size) {
+        q->start = 0u;
+        q->end = 0u;
+    }
+    else if(!--q->end) {
+        /* Tail segment emptied, singly linked so find the one before it */
+        prev = q->head;
+        while(prev->next != q->tail) {
+            prev = prev->next;
+        }
+        thrdpool_taskq_segment_release(q, q->tail);
+        prev->next = 0;
+        q->tail = prev;
+        q->end = THRDPOOL_TASKQ_SEGMENT_SIZE;
+    }
+}
+
+void thrdpool_taskq_destroy(struct thrdpool_taskq *q) {
+    struct thrdpool_taskq_segment *next;
+
+    while(q->head) {
+        next = q->head->next;
+        free(q->head);
+        q->head = next;
+    }
+    while(q->spare) {
+        next = q->spare->next;
+        free(q->spare);
+        q->spare = next;
+    }
+    *q = thrdpool_taskq_init();
+}
+
+#else
+
 bool thrdpool_taskq_push(struct thrdpool_taskq *q, thrdpool_taskhandle task, void *args) {
     if(q->size == thrdpool_arrsize(q->tasks)) {
         return false;
@@ -18,6 +354,39 @@ bool thrdpool_taskq_push(struct thrdpool_taskq *q, thrdpool_taskhandle task, voi
     return true;
 }
 
+size_t thrdpool_taskq_push_batch(struct thrdpool_taskq *restrict q, struct thrdpool_task const *restrict tasks, size_t ntasks) {
+    size_t n = thrdpool_arrsize(q->tasks) - q->size;
+    if(n > ntasks) {
+        n = ntasks;
+    }
+    for(size_t i = 0u; i < n; i++) {
+        q->tasks[thrdpool_mod_size(q->start + q->size + i)] = tasks[i];
+    }
+    q->size += n;
+    assert(q->size <= thrdpool_arrsize(q->tasks));
+    return n;
+}
+
+bool thrdpool_taskq_pop(struct thrdpool_taskq *q, struct thrdpool_task *task) {
+    struct thrdpool_task *front = thrdpool_taskq_front(q);
+    if(!front) {
+        return false;
+    }
+    *task = *front;
+    thrdpool_taskq_pop_front(q);
+    return true;
+}
+
+size_t thrdpool_taskq_pop_batch(struct thrdpool_taskq *restrict q, struct thrdpool_task *restrict tasks, size_t ntasks) {
+    size_t n = q->size < ntasks ? q->size : ntasks;
+    for(size_t i = 0u; i < n; i++) {
+        tasks[i] = q->tasks[thrdpool_mod_size(q->start + i)];
+    }
+    q->start = thrdpool_mod_size(q->start + n);
+    q->size -= n;
+    return n;
+}
+
 struct thrdpool_task *thrdpool_taskq_front(struct thrdpool_taskq *q) {
     if(!q->size) {
         return 0;
@@ -25,3 +394,9 @@ struct thrdpool_task *thrdpool_taskq_front(struct thrdpool_taskq *q) {
     assert(q->start < thrdpool_arrsize(q->tasks));
     return &q->tasks[q->start];
 }
+
+void thrdpool_taskq_destroy(struct thrdpool_taskq *q) {
+    (void)q;
+}
+
+#endif
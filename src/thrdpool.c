@@ -1,118 +1,1285 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <thrdpool/thrdpool.h>
 
 #include <errno.h>
+#include <limits.h>
+#include <sched.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
 
 size_t thrdpool_idle_impl(struct thrdpool *pool);
-size_t thrdpool_pending_impl(struct thrdpool *pool);
 bool thrdpool_destroy_impl(struct thrdpool *pool);
-void thrdpool_flush_impl(struct thrdpool *pool);
 
-static void *thrdpool_wait(void *p) {
-    struct thrdpool *pool = p;
+/* Polls for work between reads of the clock while spinning */
+#define THRDPOOL_SPIN_POLLS 8u
 
-    struct thrdpool_task task;
-    bool has_task = false;
-    bool join = false;
+/* Worker executing on the current thread, if any */
+static _Thread_local struct thrdpool_worker *thrdpool_current;
 
-    while(!join) {
-        has_task = false;
-        pthread_mutex_lock(&pool->lock);
-        ++pool->idle;
+static void thrdpool_expire(struct thrdpool_worker *self);
+static void thrdpool_wake_all(struct thrdpool *pool);
+static bool thrdpool_reactor_wait(struct thrdpool_worker *self, unsigned key, struct timespec const *timeout);
+static size_t thrdpool_queue_tasks(struct thrdpool *pool, struct thrdpool_task const *tasks, size_t ntasks);
+
+#ifdef THRDPOOL_STATS
+
+static inline uint64_t thrdpool_clock(void) {
+    return thrdpool_stats_now();
+}
+
+static inline void thrdpool_count_idle(struct thrdpool_worker *self, uint64_t since) {
+    thrdpool_counter_add(&self->counters.idle_ns, thrdpool_stats_now() - since);
+}
+
+static inline void thrdpool_count_steal(struct thrdpool_worker *self) {
+    thrdpool_counter_add(&self->counters.steals, 1u);
+}
+
+static inline void thrdpool_count_rejected(struct thrdpool *pool, size_t ntasks) {
+    if(ntasks) {
+        atomic_fetch_add_explicit(&pool->rejected, ntasks, memory_order_relaxed);
+    }
+}
+
+static inline void thrdpool_count_run(struct thrdpool_worker *self, struct thrdpool_task const *task, uint64_t start) {
+    uint64_t end = thrdpool_stats_now();
+    thrdpool_counter_add(&self->counters.executed, 1u);
+    thrdpool_counter_add(&self->counters.busy_ns, end - start);
+    thrdpool_counter_add(&self->counters.wait[thrdpool_stats_bucket(start - task->enqueued)], 1u);
+    thrdpool_counter_add(&self->counters.run[thrdpool_stats_bucket(end - start)], 1u);
+}
+
+#else
+
+static inline uint64_t thrdpool_clock(void) {
+    return 0u;
+}
+
+static inline void thrdpool_count_idle(struct thrdpool_worker *self, uint64_t since) {
+    (void)self;
+    (void)since;
+}
+
+static inline void thrdpool_count_steal(struct thrdpool_worker *self) {
+    (void)self;
+}
+
+static inline void thrdpool_count_rejected(struct thrdpool *pool, size_t ntasks) {
+    (void)pool;
+    (void)ntasks;
+}
+
+static inline void thrdpool_count_run(struct thrdpool_worker *self, struct thrdpool_task const *task, uint64_t start) {
+    (void)self;
+    (void)task;
+    (void)start;
+}
+
+#endif
+
+#ifdef THRDPOOL_TRACE
+
+static inline void thrdpool_trace(struct thrdpool_worker *self, enum thrdpool_trace_type type, struct thrdpool_task const *task) {
+    thrdpool_trace_record(&self->trace, type, task);
+}
+
+static inline void thrdpool_trace_claimed(struct thrdpool_worker *self, struct thrdpool_task const *tasks, size_t ntasks) {
+    for(size_t i = 0u; i < ntasks; i++) {
+        thrdpool_trace_record(&self->trace, THRDPOOL_TRACE_DEQUEUE, &tasks[i]);
+    }
+}
+
+/* Ring of the calling thread in pool, if it is traced */
+static inline struct thrdpool_trace_ring *thrdpool_trace_ring(struct thrdpool *pool) {
+    struct thrdpool_worker *self = thrdpool_current;
+    if(self && self->pool == pool) {
+        return &self->trace;
+    }
+    return thrdpool_trace_producer(pool);
+}
+
+static inline void thrdpool_trace_enqueued(struct thrdpool_trace_ring *ring, struct thrdpool_task const *tasks, size_t ntasks, uint64_t ts) {
+    if(ring) {
+        for(size_t i = 0u; i < ntasks; i++) {
+            thrdpool_trace_record_at(ring, THRDPOOL_TRACE_ENQUEUE, &tasks[i], ts);
+        }
+    }
+}
+
+#else
+
+struct thrdpool_trace_ring;
+
+static inline uint64_t thrdpool_trace_now(void) {
+    return 0u;
+}
+
+static inline void thrdpool_trace(struct thrdpool_worker *self, enum thrdpool_trace_type type, struct thrdpool_task const *task) {
+    (void)self;
+    (void)type;
+    (void)task;
+}
+
+static inline void thrdpool_trace_claimed(struct thrdpool_worker *self, struct thrdpool_task const *tasks, size_t ntasks) {
+    (void)self;
+    (void)tasks;
+    (void)ntasks;
+}
+
+static inline struct thrdpool_trace_ring *thrdpool_trace_ring(struct thrdpool *pool) {
+    (void)pool;
+    return 0;
+}
+
+static inline void thrdpool_trace_enqueued(struct thrdpool_trace_ring *ring, struct thrdpool_task const *tasks, size_t ntasks, uint64_t ts) {
+    (void)ring;
+    (void)tasks;
+    (void)ntasks;
+    (void)ts;
+}
+
+#endif
+
+#if defined THRDPOOL_STATS || defined THRDPOOL_TRACE
+/* Tasks are copied before being queued, and stamped with the time and their trace id */
+#define THRDPOOL_STAMP
+#endif
+
+/* Copy task and stamp the copy. Tasks stamped without a trace ring get no trace id */
+static inline struct thrdpool_task const *thrdpool_stamp(struct thrdpool_task *copy, struct thrdpool_task const *task,
+                                                         struct thrdpool_trace_ring *ring) {
+#ifdef THRDPOOL_STAMP
+    *copy = *task;
+#ifdef THRDPOOL_STATS
+    copy->enqueued = thrdpool_stats_now();
+#endif
+#ifdef THRDPOOL_TRACE
+    copy->traceid = ring ? thrdpool_trace_id(ring) : 0u;
+#endif
+    (void)ring;
+    return copy;
+#else
+    (void)copy;
+    (void)ring;
+    return task;
+#endif
+}
+
+static void thrdpool_run(struct thrdpool_worker *self, struct thrdpool_task const *task) {
+    uint64_t start = thrdpool_clock();
+
+    thrdpool_trace(self, THRDPOOL_TRACE_START, task);
+    task->handle(thrdpool_task_args(task));
+    thrdpool_trace(self, THRDPOOL_TRACE_END, task);
+    thrdpool_count_run(self, task, start);
+
+    /* Only after the bookkeeping, so that it is up to date once the group has finished */
+    if(task->group) {
+        thrdpool_group_done(task->group);
+    }
+}
+
+static inline unsigned thrdpool_xorshift(unsigned *seed) {
+    unsigned x = *seed;
+    x ^= x << 13u;
+    x ^= x >> 17u;
+    x ^= x << 5u;
+    return *seed = x;
+}
+
+static bool thrdpool_deques_empty(struct thrdpool *pool) {
+    size_t size = atomic_load_explicit(&pool->size, memory_order_relaxed);
+    for(size_t i = 0u; i < size; i++) {
+        if(thrdpool_deque_size(&pool->workers[i].dq)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Hint to the CPU that the caller is busy-waiting */
+static inline void thrdpool_pause(void) {
+#if defined __GNUC__ && (defined __x86_64__ || defined __i386__)
+    __builtin_ia32_pause();
+#elif defined __GNUC__ && defined __aarch64__
+    __asm__ __volatile__("yield");
+#endif
+}
+
+/* Whether no task is waiting in the next slot of any worker */
+static bool thrdpool_nexts_empty(struct thrdpool *pool) {
+    size_t size = atomic_load_explicit(&pool->size, memory_order_relaxed);
+    for(size_t i = 0u; i < size; i++) {
+        if(atomic_load_explicit(&pool->workers[i].nextstate, memory_order_relaxed) == THRDPOOL_NEXT_FULL) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Take the task from the next slot of worker, which need not be the calling thread's.
+ * Fails if the slot is empty or another thread is already taking the task */
+static bool thrdpool_next_take(struct thrdpool_worker *worker, struct thrdpool_task *task) {
+    unsigned state = THRDPOOL_NEXT_FULL;
+
+    if(atomic_load_explicit(&worker->nextstate, memory_order_relaxed) != THRDPOOL_NEXT_FULL ||
+       !atomic_compare_exchange_strong_explicit(&worker->nextstate, &state, THRDPOOL_NEXT_TAKING,
+                                                memory_order_acquire, memory_order_relaxed)) {
+        return false;
+    }
+    *task = worker->next;
+    atomic_store_explicit(&worker->nextstate, THRDPOOL_NEXT_EMPTY, memory_order_release);
+    return true;
+}
+
+/* Fill the next slot of the calling worker, which must not be full. Waits for a thread
+ * still copying out the previous task, which takes no longer than the copy */
+static void thrdpool_next_put(struct thrdpool_worker *self, struct thrdpool_task const *task) {
+    while(atomic_load_explicit(&self->nextstate, memory_order_acquire) != THRDPOOL_NEXT_EMPTY) {
+        thrdpool_pause();
+    }
+    self->next = *task;
+    atomic_store_explicit(&self->nextstate, THRDPOOL_NEXT_FULL, memory_order_release);
+}
+
+/* Take the task in the next slot of another worker, which is busy running the task that
+ * left it there. Tried last, the task is likely to run soon on a warm cache anyway */
+static bool thrdpool_steal_next(struct thrdpool_worker *self, struct thrdpool_task *task) {
+    struct thrdpool *pool = self->pool;
+    size_t size = atomic_load_explicit(&pool->size, memory_order_relaxed);
+    size_t start = thrdpool_xorshift(&self->seed) % size;
+    struct thrdpool_worker *victim;
+
+    for(size_t i = 0u; i < size; i++) {
+        victim = &pool->workers[(start + i) % size];
+        if(victim != self && thrdpool_next_take(victim, task)) {
+            thrdpool_count_steal(self);
+            thrdpool_trace(self, THRDPOOL_TRACE_STEAL, task);
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Steal from workers on the same node first, and from those on other nodes only if that fails */
+static bool thrdpool_steal(struct thrdpool_worker *self, struct thrdpool_task *task) {
+    struct thrdpool *pool = self->pool;
+    struct thrdpool_worker *victim;
+    size_t size = atomic_load_explicit(&pool->size, memory_order_relaxed);
+    size_t start = thrdpool_xorshift(&self->seed) % size;
+    unsigned npasses = pool->nqueues > 1u ? 2u : 1u;
+
+    for(unsigned remote = 0u; remote < npasses; remote++) {
+        for(size_t i = 0u; i < size; i++) {
+            victim = &pool->workers[(start + i) % size];
+            if(victim != self && (victim->node != self->node) == remote && thrdpool_deque_steal(&victim->dq, task)) {
+                thrdpool_count_steal(self);
+                thrdpool_trace(self, THRDPOOL_TRACE_STEAL, task);
+                return true;
+            }
+        }
+    }
+    return false;
+}
 
-        /* Avoid spurious wakeups */
-        while(!pool->join && !thrdpool_taskq_size(&pool->q)) {
-            pthread_cond_wait(&pool->cv, &pool->lock);
+/* Number of tasks in all of the pool's shared queues */
+static inline size_t thrdpool_queued(struct thrdpool *pool) {
+    size_t ntasks = 0u;
+    for(size_t i = 0u; i < pool->nqueues; i++) {
+        ntasks += thrdpool_taskq_size(&pool->q[i]);
+    }
+    return ntasks;
+}
+
+/* Shared queue of the node the calling thread runs on */
+static inline size_t thrdpool_home(struct thrdpool *pool) {
+    struct thrdpool_worker *self = thrdpool_current;
+    unsigned cpu;
+
+    if(pool->nqueues == 1u) {
+        return 0u;
+    }
+    if(self && self->pool == pool) {
+        return self->node;
+    }
+    cpu = thrdpool_topology_cpu();
+    return cpu < THRDPOOL_MAX_CPUS ? pool->cpunode[cpu] : 0u;
+}
+
+/* Tasks in the shared queues, without holding the lock */
+static inline size_t thrdpool_backlog(struct thrdpool *pool) {
+#ifdef THRDPOOL_TASKQ_LOCKFREE
+    return thrdpool_queued(pool);
+#else
+    return atomic_load_explicit(&pool->nqueued, memory_order_relaxed);
+#endif
+}
+
+static inline bool thrdpool_has_work(struct thrdpool *pool) {
+    return thrdpool_queued(pool) ||
+           (pool->sched == THRDPOOL_SCHED_STEAL && !thrdpool_deques_empty(pool)) ||
+           !thrdpool_nexts_empty(pool);
+}
+
+static inline uint64_t thrdpool_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint64_t thrdpool_add_sat(uint64_t a, uint64_t b) {
+    return a < UINT64_MAX - b ? a + b : UINT64_MAX;
+}
+
+/* Tick of the timer wheel that the time ns on the monotonic clock falls in */
+static inline uint64_t thrdpool_timer_tick(struct thrdpool *pool, uint64_t ns) {
+    return ns > pool->timerbase ? (ns - pool->timerbase) / THRDPOOL_TIMER_TICK_NS : 0u;
+}
+
+/* Publish when the timer wheel next needs turning, the timer lock must be held. Returns
+ * true if that is sooner than before */
+static bool thrdpool_timer_update(struct thrdpool *pool) {
+    uint64_t tick = thrdpool_timer_wheel_next(&pool->timers);
+    uint64_t deadline = UINT64_MAX;
+
+    if(tick < (UINT64_MAX - pool->timerbase) / THRDPOOL_TIMER_TICK_NS) {
+        deadline = pool->timerbase + tick * THRDPOOL_TIMER_TICK_NS;
+    }
+    return atomic_exchange(&pool->deadline, deadline) > deadline;
+}
+
+/* Expire timers if the deadline has passed. Costs a single load unless timers are armed */
+static inline void thrdpool_tick(struct thrdpool_worker *self) {
+    uint64_t deadline = atomic_load_explicit(&self->pool->deadline, memory_order_relaxed);
+    if(deadline != UINT64_MAX && thrdpool_now() >= deadline) {
+        thrdpool_expire(self);
+    }
+}
+
+/* Update the task count read by spinning workers, the lock must be held */
+static inline void thrdpool_publish(struct thrdpool *pool) {
+#ifdef THRDPOOL_TASKQ_LOCKFREE
+    (void)pool;
+#else
+    atomic_store_explicit(&pool->nqueued, thrdpool_queued(pool), memory_order_relaxed);
+#endif
+}
+
+/* Whether there may be work to pick up or the pool is being joined. Does not need the lock */
+static inline bool thrdpool_poll(struct thrdpool *pool) {
+    if(atomic_load_explicit(&pool->join, memory_order_relaxed)) {
+        return true;
+    }
+#ifdef THRDPOOL_TASKQ_LOCKFREE
+    return thrdpool_has_work(pool);
+#else
+    return atomic_load_explicit(&pool->nqueued, memory_order_relaxed) ||
+           (pool->sched == THRDPOOL_SCHED_STEAL && !thrdpool_deques_empty(pool)) ||
+           !thrdpool_nexts_empty(pool);
+#endif
+}
+
+/* Number of the ntasks tasks just pushed that are not about to be picked up by spinning
+ * workers. Read-modify-write for the same reason as thrdpool_event_waiters, a worker that
+ * stops spinning after announcing itself as waiting either is seen here or sees the tasks */
+static inline size_t thrdpool_unclaimed(struct thrdpool *pool, size_t ntasks) {
+    size_t nspinning = atomic_fetch_add(&pool->nspinning, 0u);
+    return ntasks > nspinning ? ntasks - nspinning : 0u;
+}
+
+static inline void thrdpool_unspin(struct thrdpool_worker *self) {
+    if(self->spinning) {
+        atomic_fetch_sub(&self->pool->nspinning, 1u);
+        self->spinning = false;
+    }
+}
+
+/* Adapt the spin time to how long the idle period that just ended lasted. The target is
+ * twice that, unless it exceeds the max spin time in which case spinning is a waste. The
+ * spin time moves a quarter of the way towards the target each time */
+static void thrdpool_spin_tune(struct thrdpool_worker *self) {
+    struct thrdpool *pool = self->pool;
+    uint64_t gap;
+    uint64_t target;
+
+    if(!self->idlesince) {
+        return;
+    }
+    gap = thrdpool_now() - self->idlesince;
+    self->idlesince = 0u;
+
+    target = gap <= pool->spin / 2u ? 2u * gap : 0u;
+    if(target > self->spin) {
+        self->spin += (target - self->spin) / 4u;
+    }
+    else {
+        self->spin -= (self->spin - target) / 4u;
+    }
+}
+
+/* Poll for work for up to the worker's spin time, then yield the CPU up to pool->yields
+ * times. Returns true if there is work to look for. Otherwise, the worker remains counted
+ * as spinning until it checks for work one last time before parking */
+static bool thrdpool_spin(struct thrdpool_worker *self) {
+    struct thrdpool *pool = self->pool;
+    uint64_t start;
+    uint64_t now;
+
+    if(thrdpool_poll(pool)) {
+        return true;
+    }
+    if(!pool->spin && !pool->yields) {
+        return false;
+    }
+
+    atomic_fetch_add(&pool->nspinning, 1u);
+    self->spinning = true;
+    start = now = thrdpool_now();
+    self->idlesince = start;
+
+    while(now - start < self->spin) {
+        for(unsigned i = 0u; i < THRDPOOL_SPIN_POLLS; i++) {
+            if(thrdpool_poll(pool)) {
+                goto found;
+            }
+            thrdpool_pause();
+        }
+        now = thrdpool_now();
+    }
+
+    for(unsigned i = 0u; i < pool->yields; i++) {
+        if(thrdpool_poll(pool)) {
+            goto found;
         }
+        sched_yield();
+    }
+    return false;
+
+found:
+    thrdpool_unspin(self);
+    thrdpool_spin_tune(self);
+    return true;
+}
+
+/* Mark the calling worker as idle, the lock must be held */
+static void thrdpool_idle_enter(struct thrdpool *pool) {
+    if(atomic_fetch_add(&pool->idle, 1u) + 1u == pool->size && pool->nidlewaiters && !thrdpool_has_work(pool)) {
+        pthread_cond_broadcast(&pool->quiescent);
+    }
+}
+
+/* Whether the worker is the last one running and a spare that is no longer needed */
+static inline bool thrdpool_surplus(struct thrdpool_worker *self) {
+    struct thrdpool *pool = self->pool;
+    return atomic_load_explicit(&pool->nspares, memory_order_relaxed) >
+               atomic_load_explicit(&pool->nblocking, memory_order_relaxed) &&
+           self == &pool->workers[atomic_load_explicit(&pool->size, memory_order_relaxed) - 1u];
+}
 
-        --pool->idle;
+/* Called by an idle worker that is either surplus or that timed out waiting for work in
+ * an elastic pool. Only the last running worker may retire so that those running stay at
+ * the start of workers. Returns true if the worker retired, in which case it is no longer
+ * counted as idle */
+static bool thrdpool_retire(struct thrdpool_worker *self, bool expired) {
+    struct thrdpool *pool = self->pool;
+    size_t size;
+    size_t nspares;
+    bool retire = false;
+    bool surplus = false;
 
-        join = pool->join;
-        if(!join) {
-            /* Copy first task to stack */
-            task = *thrdpool_taskq_front(&pool->q);
-            thrdpool_taskq_pop_front(&pool->q);
-            has_task = true;
+    /* The worker stopped counting as waiting by modifying the event, a producer that
+     * counted it as waiting before that has its tasks seen by the check */
+    if(thrdpool_poll(pool)) {
+        return false;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    size = atomic_load(&pool->size);
+    nspares = atomic_load(&pool->nspares);
+    if(!atomic_load(&pool->join) && self == &pool->workers[size - 1u]) {
+        if(nspares > atomic_load(&pool->nblocking)) {
+            atomic_store(&pool->nspares, nspares - 1u);
+            retire = true;
+            surplus = nspares - 1u > atomic_load(&pool->nblocking);
+        }
+        else {
+            /* Spares stay for as long as the workers they stand in for are blocked */
+            retire = expired && size - nspares > pool->min;
         }
+    }
+    if(retire) {
+        /* Idle first, so that thrdpool_wait_idle never sees more idle workers than there are */
+        atomic_fetch_sub(&pool->idle, 1u);
+        atomic_store(&pool->size, size - 1u);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if(surplus) {
+        /* The wakeup that got this worker to retire may have reached the spare now last
+         * while it was not, and it parked again */
+        thrdpool_wake_all(pool);
+    }
+    return retire;
+}
+
+/* Sleep until there is work to pick up or the pool is being joined. Returns false if
+ * the worker retired instead */
+static bool thrdpool_park(struct thrdpool_worker *self) {
+    struct thrdpool *pool = self->pool;
+    uint64_t since = thrdpool_clock();
+    struct timespec const *keepalive = pool->min < pool->max ? &pool->keepalive : 0;
+    struct timespec const *timeout;
+    struct timespec remaining;
+    uint64_t deadline;
+    uint64_t now;
+    bool keeper;
+    bool polled;
+    bool woken;
+    bool retired = false;
+    unsigned key;
 
+    pthread_mutex_lock(&pool->lock);
+    thrdpool_idle_enter(pool);
+    /* Under the lock, so that the event is recorded by the time thrdpool_wait_idle returns */
+    thrdpool_trace(self, THRDPOOL_TRACE_PARK, 0);
+    pthread_mutex_unlock(&pool->lock);
+
+    while(1) {
+        key = thrdpool_event_prepare(&pool->parked);
+        /* Only once announced as waiting, so that producers that skipped waking anyone
+         * as the worker was spinning have their tasks seen by the check */
+        thrdpool_unspin(self);
+        if(thrdpool_poll(pool)) {
+            thrdpool_event_cancel(&pool->parked);
+            break;
+        }
+        if(thrdpool_surplus(self)) {
+            thrdpool_event_cancel(&pool->parked);
+            if(thrdpool_retire(self, false)) {
+                retired = true;
+                break;
+            }
+            continue;
+        }
+
+        /* A single parked worker, the leader, waits for the next timer to expire and for
+         * watched fds to become ready. The others need not wake up for either */
+        timeout = keepalive;
+        deadline = atomic_load_explicit(&pool->deadline, memory_order_relaxed);
+        polled = atomic_load_explicit(&pool->nwatches, memory_order_relaxed);
+        keeper = (deadline != UINT64_MAX || polled) && !atomic_exchange(&pool->leader, true);
+        polled = polled && keeper;
+        if(keeper && deadline != UINT64_MAX) {
+            now = thrdpool_now();
+            if(deadline <= now) {
+                atomic_store(&pool->leader, false);
+                thrdpool_event_cancel(&pool->parked);
+                break;
+            }
+            if(!keepalive || deadline - now < (uint64_t)keepalive->tv_sec * 1000000000u + (uint64_t)keepalive->tv_nsec) {
+                remaining = (struct timespec) {
+                    .tv_sec = (time_t)((deadline - now) / 1000000000u),
+                    .tv_nsec = (long)((deadline - now) % 1000000000u)
+                };
+                timeout = &remaining;
+            }
+        }
+
+        if(polled) {
+            woken = thrdpool_reactor_wait(self, key, timeout);
+        }
+        else {
+            woken = thrdpool_event_wait(&pool->parked, key, timeout);
+        }
+        if(keeper) {
+            atomic_store(&pool->leader, false);
+        }
+        if(!woken && timeout == keepalive && thrdpool_retire(self, true)) {
+            if(polled) {
+                /* Hand the fds over to another parked worker */
+                thrdpool_event_notify(&pool->parked, 1u);
+            }
+            retired = true;
+            break;
+        }
+    }
+
+    if(!retired) {
+        atomic_fetch_sub(&pool->idle, 1u);
+    }
+    thrdpool_trace(self, THRDPOOL_TRACE_UNPARK, 0);
+    thrdpool_count_idle(self, since);
+    thrdpool_spin_tune(self);
+    return !retired;
+}
+
+/* Wake up to n of the nwaiting threads blocked on cv, the lock must not be held */
+static void thrdpool_wake(pthread_cond_t *cv, size_t n, size_t nwaiting) {
+    if(n >= nwaiting) {
+        pthread_cond_broadcast(cv);
+    }
+    else {
+        while(n--) {
+            pthread_cond_signal(cv);
+        }
+    }
+}
+
+/* Interrupt the leader's epoll_wait */
+static void thrdpool_kick(struct thrdpool *pool) {
+    uint64_t one = 1u;
+    if(write(pool->wakefd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        fprintf(stderr, "Error waking leader: %s\n", strerror(errno));
+    }
+}
+
+/* Wake all parked workers, including a leader polling fds */
+static void thrdpool_wake_all(struct thrdpool *pool) {
+    thrdpool_event_notify(&pool->parked, SIZE_MAX);
+    /* After notifying, pairs with thrdpool_reactor_wait checking the event after setting polling */
+    if(atomic_load(&pool->polling)) {
+        thrdpool_kick(pool);
+    }
+}
+
+/* Wake parked workers after pushing ntasks tasks without holding the lock. Costs no
+ * more than an atomic read-modify-write unless a worker is parked or about to */
+static void thrdpool_notify(struct thrdpool *pool, size_t ntasks) {
+    size_t nwaiters;
+
+    nwaiters = thrdpool_event_waiters(&pool->parked);
+    if(nwaiters) {
+        ntasks = thrdpool_unclaimed(pool, ntasks);
+        if(ntasks) {
+            thrdpool_event_notify(&pool->parked, ntasks);
+            /* A leader polling fds counts as waiting but does not sleep on the futex, it
+             * only needs interrupting if there are not enough others to wake */
+            if(ntasks >= nwaiters && atomic_load(&pool->polling)) {
+                thrdpool_kick(pool);
+            }
+        }
+    }
+}
+
+#ifdef THRDPOOL_TASKQ_LOCKFREE
+
+/* Wake producers blocked on a full queue after popping nfreed tasks without holding the lock */
+static void thrdpool_notify_producers(struct thrdpool *pool, size_t nfreed) {
+    /* Read-modify-write so that either it is ordered after a producer's increment in
+     * thrdpool_schedule_wait_impl, or the producer's increment acquires the freed slots */
+    size_t nblocked = atomic_fetch_add(&pool->nblocked, 0u);
+    if(nblocked) {
+        pthread_mutex_lock(&pool->lock);
         pthread_mutex_unlock(&pool->lock);
+        thrdpool_wake(&pool->notfull, nfreed, nblocked);
+    }
+}
+
+#endif
+
+/* Number of tasks a worker may claim from the shared queue. Never more than an even
+ * split of the queue between the worker and those currently idle, so that a single
+ * worker does not hoard tasks others could be running */
+static inline size_t thrdpool_fair_share(struct thrdpool *pool, struct thrdpool_taskq *q, size_t batch) {
+    size_t ntasks;
+    size_t nidle;
+
+    if(batch == 1u) {
+        return 1u;
+    }
+
+    ntasks = thrdpool_taskq_size(q);
+    nidle = atomic_load_explicit(&pool->idle, memory_order_relaxed);
+    ntasks = (ntasks + nidle) / (nidle + 1u);
+    if(!ntasks) {
+        return 1u;
+    }
+    return ntasks < batch ? ntasks : batch;
+}
+
+/* Pop up to a fair share of at most batch tasks from the queue of node, or from those
+ * of other nodes if it is empty. The lock must be held unless the queues are lock-free */
+static size_t thrdpool_pop(struct thrdpool *pool, size_t node, struct thrdpool_task *tasks, size_t batch) {
+    struct thrdpool_taskq *q;
+    size_t ntasks = 0u;
+
+    for(size_t i = 0u; i < pool->nqueues && !ntasks; i++) {
+        q = &pool->q[(node + i) % pool->nqueues];
+        ntasks = thrdpool_taskq_pop_batch(q, tasks, thrdpool_fair_share(pool, q, batch));
+    }
+    thrdpool_publish(pool);
+    /* Tasks are no longer piling up once the queues run dry */
+    if(atomic_load_explicit(&pool->backlogged, memory_order_relaxed) && !thrdpool_queued(pool)) {
+        atomic_store_explicit(&pool->backlogged, 0u, memory_order_relaxed);
+    }
+    return ntasks;
+}
+
+/* Push to the queue of the calling thread's node, spilling over to those of other nodes
+ * once it is full. The lock must be held unless the queues are lock-free */
+static size_t thrdpool_enqueue(struct thrdpool *pool, struct thrdpool_task const *tasks, size_t ntasks) {
+    size_t node = thrdpool_home(pool);
+    size_t npushed = 0u;
+
+    for(size_t i = 0u; i < pool->nqueues && npushed < ntasks; i++) {
+        npushed += thrdpool_taskq_push_batch(&pool->q[(node + i) % pool->nqueues], &tasks[npushed], ntasks - npushed);
+    }
+    thrdpool_publish(pool);
+    return npushed;
+}
+
+/* Claim up to a fair share of at most batch tasks from the shared queues, starting with that of node */
+static inline size_t thrdpool_dequeue(struct thrdpool *pool, size_t node, struct thrdpool_task *tasks, size_t batch) {
+    size_t ntasks;
+#ifdef THRDPOOL_TASKQ_LOCKFREE
+    ntasks = thrdpool_pop(pool, node, tasks, batch);
+    if(ntasks) {
+        thrdpool_notify_producers(pool, ntasks);
+    }
+#else
+    size_t nblocked;
+    pthread_mutex_lock(&pool->lock);
+    ntasks = thrdpool_pop(pool, node, tasks, batch);
+    nblocked = atomic_load(&pool->nblocked);
+    pthread_mutex_unlock(&pool->lock);
+
+    if(ntasks && nblocked) {
+        thrdpool_wake(&pool->notfull, ntasks, nblocked);
+    }
+#endif
+    return ntasks;
+}
+
+/* Run the tasks that the tasks run by the worker left in its next slot. The task in the
+ * slot past nextlimit in a row is queued instead, letting those queued have their turn */
+static void thrdpool_run_next(struct thrdpool_worker *self) {
+    struct thrdpool_task task;
+
+    for(unsigned i = 0u; thrdpool_next_take(self, &task); i++) {
+        if(i == self->pool->nextlimit && thrdpool_queue_tasks(self->pool, &task, 1u)) {
+            break;
+        }
+        thrdpool_run(self, &task);
+    }
+}
+
+/* Notify the groups of tasks that will never run */
+static void thrdpool_discard(struct thrdpool_task const *tasks, size_t ntasks) {
+    for(size_t i = 0u; i < ntasks; i++) {
+        /* Nothing else would ever run, or mark done, what a strand holds */
+        if(!thrdpool_strand_discard_internal(&tasks[i]) && tasks[i].group) {
+            thrdpool_group_done(tasks[i].group);
+        }
+    }
+}
+
+/* Run tasks claimed from the shared queue, stopping early if the pool is being joined */
+static void thrdpool_run_claimed(struct thrdpool_worker *self, struct thrdpool_task const *tasks, size_t ntasks) {
+    thrdpool_trace_claimed(self, tasks, ntasks);
+    for(size_t i = 0u; i < ntasks; i++) {
+        if(atomic_load_explicit(&self->pool->join, memory_order_relaxed)) {
+            thrdpool_discard(&tasks[i], ntasks - i);
+            break;
+        }
+        atomic_store_explicit(&self->nclaimed, ntasks - i - 1u, memory_order_relaxed);
+        thrdpool_run(self, &tasks[i]);
+        thrdpool_run_next(self);
+    }
+    atomic_store_explicit(&self->nclaimed, 0u, memory_order_relaxed);
+}
+
+static void thrdpool_wait_shared(struct thrdpool_worker *self) {
+    struct thrdpool *pool = self->pool;
+    struct thrdpool_task tasks[THRDPOOL_BATCH_CAPACITY];
+    size_t ntasks;
+
+    while(!atomic_load_explicit(&pool->join, memory_order_relaxed)) {
+        thrdpool_tick(self);
+        thrdpool_run_next(self);
+        ntasks = thrdpool_dequeue(pool, self->node, tasks, pool->batch);
+        if(ntasks) {
+            atomic_store_explicit(&self->nclaimed, ntasks, memory_order_relaxed);
+            thrdpool_run_claimed(self, tasks, ntasks);
+        }
+        else if(thrdpool_steal_next(self, &tasks[0])) {
+            thrdpool_run(self, &tasks[0]);
+        }
+        else if(!thrdpool_spin(self) && !thrdpool_park(self)) {
+            break;
+        }
+    }
+}
+
+static void thrdpool_wait_steal(struct thrdpool_worker *self) {
+    struct thrdpool *pool = self->pool;
+    struct thrdpool_task tasks[THRDPOOL_BATCH_CAPACITY];
+    size_t ntasks;
+
+    while(!atomic_load_explicit(&pool->join, memory_order_relaxed)) {
+        thrdpool_tick(self);
+        thrdpool_run_next(self);
+        if(thrdpool_deque_pop(&self->dq, &tasks[0])) {
+            thrdpool_run(self, &tasks[0]);
+            continue;
+        }
+
+        ntasks = thrdpool_dequeue(pool, self->node, tasks, pool->batch);
+        thrdpool_trace_claimed(self, tasks, ntasks);
+        if(ntasks > 1u) {
+            /* Move the surplus to the deque where other workers may steal it, the
+             * first task claimed is popped first */
+            for(size_t i = ntasks - 1u; i > 0u; i--) {
+                if(!thrdpool_deque_push(&self->dq, &tasks[i])) {
+                    thrdpool_run(self, &tasks[i]);
+                }
+            }
+            thrdpool_notify(pool, ntasks - 1u);
+        }
+
+        if(ntasks || thrdpool_steal(self, &tasks[0]) || thrdpool_steal_next(self, &tasks[0])) {
+            thrdpool_run(self, &tasks[0]);
+        }
+        else if(!thrdpool_spin(self) && !thrdpool_park(self)) {
+            break;
+        }
+    }
+}
+
+size_t thrdpool_worker_id_impl(struct thrdpool *pool) {
+    struct thrdpool_worker *self = thrdpool_current;
+    if(!self || self->pool != pool) {
+        return pool->capacity;
+    }
+    return (size_t)(self - pool->workers);
+}
+
+bool thrdpool_help_internal(struct thrdpool *pool) {
+    struct thrdpool_task task;
+    struct thrdpool_worker *self = thrdpool_current;
+    if(!self || self->pool != pool) {
+        return false;
+    }
+
+    if(thrdpool_next_take(self, &task)) {
+        thrdpool_run(self, &task);
+        return true;
+    }
+
+    if(pool->sched == THRDPOOL_SCHED_STEAL && thrdpool_deque_pop(&self->dq, &task)) {
+        thrdpool_run(self, &task);
+        return true;
+    }
+
+    if(thrdpool_dequeue(pool, self->node, &task, 1u)) {
+        thrdpool_trace_claimed(self, &task, 1u);
+        thrdpool_run(self, &task);
+        return true;
+    }
+
+    if((pool->sched == THRDPOOL_SCHED_STEAL && thrdpool_steal(self, &task)) || thrdpool_steal_next(self, &task)) {
+        thrdpool_run(self, &task);
+        return true;
+    }
+    return false;
+}
+
+static void *thrdpool_wait(void *p) {
+    struct thrdpool_task task;
+    struct thrdpool_worker *self = p;
+    thrdpool_current = self;
+
+    switch(self->pool->sched) {
+        case THRDPOOL_SCHED_STEAL:
+            thrdpool_wait_steal(self);
+            break;
+        default:
+            thrdpool_wait_shared(self);
+            break;
+    }
+
+    /* Left behind when joining, like the tasks in the queues */
+    if(thrdpool_next_take(self, &task)) {
+        thrdpool_discard(&task, 1u);
+    }
+    thrdpool_fiber_cleanup();
+    return 0;
+}
+
+static bool thrdpool_reactor_init(struct thrdpool *pool) {
+    struct epoll_event ev = {
+        .events = EPOLLIN,
+        .data.ptr = 0
+    };
+    int err;
+
+    pool->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if(pool->epfd < 0) {
+        fprintf(stderr, "Error creating epoll instance: %s\n", strerror(errno));
+        return false;
+    }
+
+    pool->wakefd = eventfd(0u, EFD_CLOEXEC | EFD_NONBLOCK);
+    if(pool->wakefd < 0) {
+        fprintf(stderr, "Error creating eventfd: %s\n", strerror(errno));
+        goto close_epfd;
+    }
+    if(epoll_ctl(pool->epfd, EPOLL_CTL_ADD, pool->wakefd, &ev)) {
+        fprintf(stderr, "Error watching eventfd: %s\n", strerror(errno));
+        goto close_wakefd;
+    }
+
+    err = pthread_mutex_init(&pool->watchlock, 0);
+    if(err) {
+        fprintf(stderr, "Error initializing mutex: %s\n", strerror(err));
+        goto close_wakefd;
+    }
+    err = pthread_cond_init(&pool->polled, 0);
+    if(err) {
+        fprintf(stderr, "Error intializing condition variable: %s\n", strerror(err));
+        pthread_mutex_destroy(&pool->watchlock);
+        goto close_wakefd;
+    }
+    return true;
+
+close_wakefd:
+    close(pool->wakefd);
+close_epfd:
+    close(pool->epfd);
+    return false;
+}
+
+static bool thrdpool_reactor_destroy(struct thrdpool *pool) {
+    bool success = true;
+    int err;
+
+    /* Watches still armed are left to never fire */
+    if(close(pool->wakefd) || close(pool->epfd)) {
+        fprintf(stderr, "Error closing fd: %s\n", strerror(errno));
+        success = false;
+    }
+    err = pthread_mutex_destroy(&pool->watchlock);
+    if(err) {
+        fprintf(stderr, "Error destroying mutex: %s\n", strerror(err));
+        success = false;
+    }
+    err = pthread_cond_destroy(&pool->polled);
+    if(err) {
+        fprintf(stderr, "Error destroying condition variable: %s\n", strerror(err));
+        success = false;
+    }
+    return success;
+}
+
+bool thrdpool_destroy_internal(struct thrdpool *pool, size_t nthreads) {
+    bool success = true;
+    int err;
+    /* Notify about pending join */
+    pthread_mutex_lock(&pool->lock);
+    atomic_store(&pool->join, true);
+    pthread_mutex_unlock(&pool->lock);
+
+    /* Wake up worker threads */
+    thrdpool_wake_all(pool);
+
+    /* Release blocked producers */
+    err = pthread_cond_broadcast(&pool->notfull);
+    if(err) {
+        fprintf(stderr, "Error unblocking producers: %s\n", strerror(err));
+        success = false;
+    }
+
+    err = pthread_cond_broadcast(&pool->quiescent);
+    if(err) {
+        fprintf(stderr, "Error unblocking threads waiting for idle: %s\n", strerror(err));
+        success = false;
+    }
+
+    for(size_t i = 0u; i < nthreads; i++) {
+        if(!pool->workers[i].joinable) {
+            continue;
+        }
+        err = pthread_join(pool->workers[i].thrd, 0);
+        if(err) {
+            fprintf(stderr, "Error joining worker %zu: %s\n", i, strerror(err));
+            success = false;
+        }
+    }
+
+    /* Tasks left behind will never run */
+    thrdpool_flush_impl(pool);
+    thrdpool_timer_wheel_clear(&pool->timers);
+
+    for(size_t i = 0u; i < pool->nqueues; i++) {
+        thrdpool_taskq_destroy(&pool->q[i]);
+    }
+
+    err = pthread_mutex_destroy(&pool->lock);
+    if(err) {
+        fprintf(stderr, "Error destroying mutex: %s\n", strerror(err));
+        success = false;
+    }
+    err = pthread_cond_destroy(&pool->notfull);
+    if(err) {
+        fprintf(stderr, "Error destroying condition variable: %s\n", strerror(err));
+        success = false;
+    }
+    err = pthread_cond_destroy(&pool->quiescent);
+    if(err) {
+        fprintf(stderr, "Error destroying condition variable: %s\n", strerror(err));
+        success = false;
+    }
+    err = pthread_mutex_destroy(&pool->timerlock);
+    if(err) {
+        fprintf(stderr, "Error destroying mutex: %s\n", strerror(err));
+        success = false;
+    }
+    if(!thrdpool_reactor_destroy(pool)) {
+        success = false;
+    }
+
+    return success;
+}
+
+/* Pick the CPU and shared queue of each worker */
+static bool thrdpool_place(struct thrdpool *pool, struct thrdpool_attr const *attr) {
+    struct thrdpool_topology discovered;
+    struct thrdpool_topology const *topo = attr->topology;
+    struct thrdpool_cpu const *cpu;
+    size_t order[THRDPOOL_MAX_CPUS];
+    size_t ncpus = 0u;
+
+    pool->nqueues = 1u;
+    memset(pool->cpunode, 0, sizeof(pool->cpunode));
+    for(size_t i = 0u; i < pool->capacity; i++) {
+        pool->workers[i].cpu = -1;
+        pool->workers[i].node = 0u;
+    }
+
+    if(attr->affinity == THRDPOOL_AFFINITY_NONE && !attr->numa) {
+        return true;
+    }
+
+    if(!topo) {
+        if(!thrdpool_topology_discover(&discovered, 0)) {
+            fprintf(stderr, "Error reading CPU topology: %s\n", strerror(errno));
+            return false;
+        }
+        topo = &discovered;
+    }
+
+    if(attr->numa) {
+        pool->nqueues = topo->nnodes < THRDPOOL_NUMA_NODES ? topo->nnodes : THRDPOOL_NUMA_NODES;
+        for(size_t i = 0u; i < topo->ncpus; i++) {
+            cpu = &topo->cpus[i];
+            if(cpu->id < THRDPOOL_MAX_CPUS) {
+                pool->cpunode[cpu->id] = (unsigned char)(cpu->node % pool->nqueues);
+            }
+        }
+    }
 
-        if(has_task) {
-            thrdpool_call(&task);
+    if(attr->affinity != THRDPOOL_AFFINITY_NONE) {
+        ncpus = thrdpool_topology_order(topo, attr->affinity, attr->cpus, attr->ncpus, order);
+        if(!ncpus) {
+            fprintf(stderr, "Error pinning workers: no online CPUs to pin to\n");
+            return false;
         }
     }
 
-    return 0;
+    for(size_t i = 0u; i < pool->capacity; i++) {
+        if(ncpus) {
+            cpu = &topo->cpus[order[i % ncpus]];
+            pool->workers[i].cpu = (int)cpu->id;
+            pool->workers[i].node = cpu->node % pool->nqueues;
+        }
+        else {
+            /* Workers free to run anywhere are spread evenly over the nodes */
+            pool->workers[i].node = i % pool->nqueues;
+        }
+    }
+    return true;
 }
 
-bool thrdpool_destroy_internal(struct thrdpool *pool, size_t nthreads) {
-    bool success = true;
+/* Start the worker's thread, pinned to its CPU if it has one. The thread of a retired
+ * worker that last used the slot is joined first */
+static int thrdpool_spawn_worker(struct thrdpool_worker *worker) {
     int err;
-    /* Notify about pending join */
-    pthread_mutex_lock(&pool->lock);
-    pool->join = true;
-    pthread_mutex_unlock(&pool->lock);
-
-    /* Wake up worker threads */
-    err = pthread_cond_broadcast(&pool->cv);
-    if(err) {
-        fprintf(stderr, "Error unblocking threads for joining: %s\n", strerror(err));
-        /* Attempting to join would block indefinitely */
-        return false;
-    }
+    pthread_attr_t attr;
 
-    for(size_t i = 0u; i < nthreads; i++) {
-        err = pthread_join(pool->workers[i], 0);
+    if(worker->joinable) {
+        err = pthread_join(worker->thrd, 0);
         if(err) {
-            fprintf(stderr, "Error joining worker %zu: %s\n", i, strerror(err));
-            success = false;
+            return err;
         }
+        worker->joinable = false;
+        worker->spin = worker->pool->spin;
+        worker->idlesince = 0u;
     }
 
-    err = pthread_mutex_destroy(&pool->lock);
-    if(err) {
-        fprintf(stderr, "Error destroying mutex: %s\n", strerror(err));
-        success = false;
+    if(worker->cpu < 0) {
+        err = pthread_create(&worker->thrd, 0, thrdpool_wait, worker);
+        worker->joinable = !err;
+        return err;
     }
-    err = pthread_cond_destroy(&pool->cv);
+
+    err = pthread_attr_init(&attr);
     if(err) {
-        fprintf(stderr, "Error destroying condition variable: %s\n", strerror(err));
-        success = false;
+        return err;
     }
-
-    return success;
+    err = thrdpool_topology_bind(&attr, (unsigned)worker->cpu);
+    if(!err) {
+        err = pthread_create(&worker->thrd, &attr, thrdpool_wait, worker);
+    }
+    pthread_attr_destroy(&attr);
+    worker->joinable = !err;
+    return err;
 }
 
-bool thrdpool_init_impl(struct thrdpool *pool, size_t capacity) {
+bool thrdpool_init_impl(struct thrdpool *pool, size_t capacity, struct thrdpool_attr const *attr) {
     int err;
     size_t nthreads = 0u;
     bool success = false;
+    struct thrdpool_attr defattr = thrdpool_attr_init();
+    pthread_condattr_t cvattr;
 
     if(!capacity) {
         return false;
     }
 
-    pool->join = false;
-    pool->q = thrdpool_taskq_init();
-    pool->size = capacity;
-    pool->idle = 0u;
+    if(!attr) {
+        attr = &defattr;
+    }
+
+    atomic_init(&pool->join, false);
+    pool->sched = attr->sched;
+    pool->batch = attr->batch;
+    if(!pool->batch) {
+        pool->batch = 1u;
+    }
+    else if(pool->batch > THRDPOOL_BATCH_CAPACITY) {
+        pool->batch = THRDPOOL_BATCH_CAPACITY;
+    }
+    pool->capacity = capacity;
+    pool->max = attr->max < capacity ? attr->max : capacity;
+    if(!pool->max) {
+        pool->max = 1u;
+    }
+    pool->min = attr->min < pool->max ? attr->min : pool->max;
+    if(!pool->min) {
+        pool->min = 1u;
+    }
+    atomic_init(&pool->size, pool->min);
+    pool->growdepth = attr->growdepth;
+    pool->growwait = attr->growwait;
+    pool->keepalive = (struct timespec) {
+        .tv_sec = (time_t)(attr->keepalive / 1000000000u),
+        .tv_nsec = (long)(attr->keepalive % 1000000000u)
+    };
+    atomic_init(&pool->nblocking, 0u);
+    atomic_init(&pool->nspares, 0u);
+    atomic_init(&pool->backlogged, 0u);
+    atomic_init(&pool->idle, 0u);
+    atomic_init(&pool->nspinning, 0u);
+    pool->spin = attr->spin;
+    pool->yields = attr->yields;
+    pool->nextlimit = attr->nextlimit;
+    atomic_init(&pool->nblocked, 0u);
+#ifndef THRDPOOL_TASKQ_LOCKFREE
+    atomic_init(&pool->nqueued, 0u);
+#endif
+    pool->nidlewaiters = 0u;
+#ifdef THRDPOOL_STATS
+    atomic_init(&pool->rejected, 0u);
+#endif
+
+    for(size_t i = 0u; i < pool->capacity; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].seed = (unsigned)i * 2654435761u + 1u;
+        pool->workers[i].spin = pool->spin;
+        pool->workers[i].idlesince = 0u;
+        pool->workers[i].spinning = false;
+        pool->workers[i].joinable = false;
+        pool->workers[i].blocking = 0u;
+        atomic_init(&pool->workers[i].nclaimed, 0u);
+        atomic_init(&pool->workers[i].nextstate, THRDPOOL_NEXT_EMPTY);
+        thrdpool_deque_init(&pool->workers[i].dq);
+#ifdef THRDPOOL_STATS
+        thrdpool_counters_init(&pool->workers[i].counters);
+#endif
+    }
+#ifdef THRDPOOL_TRACE
+    thrdpool_trace_pool_init(pool);
+#endif
+
+    if(!thrdpool_place(pool, attr)) {
+        return false;
+    }
+    for(size_t i = 0u; i < pool->nqueues; i++) {
+        pool->q[i] = thrdpool_taskq_init();
+    }
+
+    thrdpool_event_init(&pool->parked);
+    pool->timerbase = thrdpool_now();
+    atomic_init(&pool->deadline, UINT64_MAX);
+    atomic_init(&pool->leader, false);
+    atomic_init(&pool->nwatches, 0u);
+    atomic_init(&pool->polling, false);
+    pool->npolled = 0u;
+    thrdpool_timer_wheel_init(&pool->timers);
+
+    /* Deadlines passed to thrdpool_schedule_timed are measured against the monotonic clock */
+    err = pthread_condattr_init(&cvattr);
+    if(!err) {
+        err = pthread_condattr_setclock(&cvattr, CLOCK_MONOTONIC);
+        if(!err) {
+            err = pthread_cond_init(&pool->notfull, &cvattr);
+        }
+        pthread_condattr_destroy(&cvattr);
+    }
+    if(err) {
+        fprintf(stderr, "Error intializing condition variable: %s\n", strerror(err));
+        return false;
+    }
 
-    err = pthread_cond_init(&pool->cv, 0);
+    err = pthread_cond_init(&pool->quiescent, 0);
     if(err) {
         fprintf(stderr, "Error intializing condition variable: %s\n", strerror(err));
+        pthread_cond_destroy(&pool->notfull);
         return false;
     }
 
     err = pthread_mutex_init(&pool->lock, 0);
     if(err) {
         fprintf(stderr, "Error initializing mutex: %s\n", strerror(err));
-        pthread_cond_destroy(&pool->cv);
+        pthread_cond_destroy(&pool->notfull);
+        pthread_cond_destroy(&pool->quiescent);
         return false;
     }
 
-    for(; nthreads < pool->size; nthreads++) {
-        err = pthread_create(&pool->workers[nthreads], 0, thrdpool_wait, pool);
+    err = pthread_mutex_init(&pool->timerlock, 0);
+    if(err) {
+        fprintf(stderr, "Error initializing mutex: %s\n", strerror(err));
+        pthread_cond_destroy(&pool->notfull);
+        pthread_cond_destroy(&pool->quiescent);
+        pthread_mutex_destroy(&pool->lock);
+        return false;
+    }
+
+    if(!thrdpool_reactor_init(pool)) {
+        pthread_cond_destroy(&pool->notfull);
+        pthread_cond_destroy(&pool->quiescent);
+        pthread_mutex_destroy(&pool->lock);
+        pthread_mutex_destroy(&pool->timerlock);
+        return false;
+    }
+
+    for(; nthreads < pool->min; nthreads++) {
+        err = thrdpool_spawn_worker(&pool->workers[nthreads]);
         if(err) {
             fprintf(stderr, "Error forking thread %zu: %s\n", nthreads, strerror(err));
             goto epilogue;
@@ -127,16 +1294,631 @@ epilogue:
     return success;
 }
 
+/* Start a worker in the first free slot, the lock must be held */
+static bool thrdpool_start(struct thrdpool *pool) {
+    size_t size = atomic_load(&pool->size);
+    int err = thrdpool_spawn_worker(&pool->workers[size]);
+    if(err) {
+        fprintf(stderr, "Error forking thread %zu: %s\n", size, strerror(err));
+        return false;
+    }
+    atomic_store(&pool->size, size + 1u);
+    return true;
+}
+
+/* Spawn another worker if the pool is elastic and all workers are busy, with either
+ * growdepth tasks queued or tasks having been queued for at least growwait ns */
+static void thrdpool_grow(struct thrdpool *pool) {
+    size_t size = atomic_load_explicit(&pool->size, memory_order_relaxed);
+    size_t ntasks;
+    uint64_t now;
+    uint64_t since;
+
+    if(size - atomic_load_explicit(&pool->nspares, memory_order_relaxed) >= pool->max || size >= pool->capacity ||
+       atomic_load_explicit(&pool->idle, memory_order_relaxed) ||
+       atomic_load_explicit(&pool->nspinning, memory_order_relaxed)) {
+        return;
+    }
+
+    ntasks = thrdpool_backlog(pool);
+    if(!ntasks) {
+        return;
+    }
+    if(ntasks < pool->growdepth) {
+        now = thrdpool_now();
+        since = atomic_load_explicit(&pool->backlogged, memory_order_relaxed);
+        if(!since) {
+            atomic_compare_exchange_strong(&pool->backlogged, &since, now);
+            return;
+        }
+        if(now - since < pool->growwait) {
+            return;
+        }
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    size = atomic_load(&pool->size);
+    if(!atomic_load(&pool->join) && size - atomic_load(&pool->nspares) < pool->max && size < pool->capacity &&
+       !atomic_load(&pool->idle)) {
+        thrdpool_start(pool);
+        atomic_store_explicit(&pool->backlogged, 0u, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void thrdpool_blocking_begin(void) {
+    struct thrdpool_worker *self = thrdpool_current;
+    struct thrdpool_task task;
+    struct thrdpool *pool;
+
+    if(!self || self->blocking++) {
+        return;
+    }
+
+    pool = self->pool;
+    /* Nothing would run the task in the next slot until the worker is done blocking */
+    if(thrdpool_next_take(self, &task) && !thrdpool_queue_tasks(pool, &task, 1u)) {
+        thrdpool_next_put(self, &task);
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    atomic_fetch_add(&pool->nblocking, 1u);
+    if(!atomic_load(&pool->join) && atomic_load(&pool->size) < pool->capacity &&
+       atomic_load(&pool->nspares) < atomic_load(&pool->nblocking) && thrdpool_start(pool)) {
+        atomic_fetch_add(&pool->nspares, 1u);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void thrdpool_blocking_end(void) {
+    struct thrdpool_worker *self = thrdpool_current;
+    struct thrdpool *pool;
+    bool surplus;
+
+    if(!self || !self->blocking || --self->blocking) {
+        return;
+    }
+
+    pool = self->pool;
+    pthread_mutex_lock(&pool->lock);
+    atomic_fetch_sub(&pool->nblocking, 1u);
+    surplus = atomic_load(&pool->nspares) > atomic_load(&pool->nblocking);
+    pthread_mutex_unlock(&pool->lock);
+
+    if(surplus) {
+        /* The last worker may be parked, it retires once it sees that it is surplus */
+        thrdpool_wake_all(pool);
+    }
+}
+
+/* Push tasks to the calling worker's deque or the shared queue, returns the number pushed */
+static size_t thrdpool_queue_tasks(struct thrdpool *pool, struct thrdpool_task const *tasks, size_t ntasks) {
+    size_t npushed = 0u;
+    struct thrdpool_worker *self = thrdpool_current;
+
+    if(pool->sched == THRDPOOL_SCHED_STEAL && self && self->pool == pool) {
+        while(npushed < ntasks && thrdpool_deque_push(&self->dq, &tasks[npushed])) {
+            ++npushed;
+        }
+    }
+
+#ifdef THRDPOOL_TASKQ_LOCKFREE
+    npushed += thrdpool_enqueue(pool, &tasks[npushed], ntasks - npushed);
+#else
+    if(npushed < ntasks) {
+        pthread_mutex_lock(&pool->lock);
+        npushed += thrdpool_enqueue(pool, &tasks[npushed], ntasks - npushed);
+        pthread_mutex_unlock(&pool->lock);
+    }
+#endif
+    if(npushed) {
+        thrdpool_notify(pool, npushed);
+    }
+    thrdpool_grow(pool);
+
+    return npushed;
+}
+
+/* Like thrdpool_queue_tasks, but when called from a worker the last task goes to its next
+ * slot, so that it runs while what its parent produced is still in cache. The task it
+ * displaces is queued instead. As the worker is busy, a parked one is woken to take the
+ * task should the parent go on for long, or wait for the task */
+static size_t thrdpool_push_tasks(struct thrdpool *pool, struct thrdpool_task const *tasks, size_t ntasks) {
+    struct thrdpool_task displaced;
+    size_t npushed = 0u;
+    struct thrdpool_worker *self = thrdpool_current;
+
+    if(!self || self->pool != pool || !pool->nextlimit || !ntasks) {
+        return thrdpool_queue_tasks(pool, tasks, ntasks);
+    }
+
+    if(ntasks > 1u) {
+        npushed = thrdpool_queue_tasks(pool, tasks, ntasks - 1u);
+        if(npushed < ntasks - 1u) {
+            return npushed;
+        }
+    }
+    if(thrdpool_next_take(self, &displaced) && !thrdpool_queue_tasks(pool, &displaced, 1u)) {
+        thrdpool_next_put(self, &displaced);
+        return npushed;
+    }
+    thrdpool_next_put(self, &tasks[ntasks - 1u]);
+    thrdpool_notify(pool, 1u);
+    return ntasks;
+}
+
+#ifdef THRDPOOL_STAMP
+
+/* Push stamped copies of the tasks */
+static size_t thrdpool_push(struct thrdpool *pool, struct thrdpool_task const *tasks, size_t ntasks) {
+    struct thrdpool_task stamped[THRDPOOL_BATCH_CAPACITY];
+    struct thrdpool_trace_ring *ring = thrdpool_trace_ring(pool);
+    size_t npushed = 0u;
+    size_t nchunk;
+    size_t n;
+    uint64_t ts;
+
+    while(npushed < ntasks) {
+        nchunk = ntasks - npushed < thrdpool_arrsize(stamped) ? ntasks - npushed : thrdpool_arrsize(stamped);
+        for(size_t i = 0u; i < nchunk; i++) {
+            thrdpool_stamp(&stamped[i], &tasks[npushed + i], ring);
+        }
+
+        ts = thrdpool_trace_now();
+        n = thrdpool_push_tasks(pool, stamped, nchunk);
+        thrdpool_trace_enqueued(ring, stamped, n, ts);
+        npushed += n;
+        if(n < nchunk) {
+            break;
+        }
+    }
+
+    thrdpool_count_rejected(pool, ntasks - npushed);
+    return npushed;
+}
+
+#else
+
+static inline size_t thrdpool_push(struct thrdpool *pool, struct thrdpool_task const *tasks, size_t ntasks) {
+    return thrdpool_push_tasks(pool, tasks, ntasks);
+}
+
+#endif
+
 bool thrdpool_schedule_impl(struct thrdpool *pool, void(*task)(void *), void *args) {
+    return thrdpool_push(pool, &(struct thrdpool_task) {
+        .handle = task,
+        .args = args
+    }, 1u);
+}
+
+bool thrdpool_schedule_copy_impl(struct thrdpool *pool, void(*task)(void *), void const *args, size_t size) {
+    struct thrdpool_task copy = {
+        .handle = task,
+        .inlined = true
+    };
+
+    if(size > sizeof(copy.data)) {
+        return false;
+    }
+    memcpy(copy.data, args, size);
+    return thrdpool_push(pool, &copy, 1u);
+}
+
+bool thrdpool_requeue_internal(struct thrdpool *pool, struct thrdpool_task const *task) {
+    bool success;
+    struct thrdpool_task copy;
+    struct thrdpool_trace_ring *ring = thrdpool_trace_ring(pool);
+    uint64_t ts = thrdpool_trace_now();
+
+#ifdef THRDPOOL_TASKQ_LOCKFREE
+    success = thrdpool_enqueue(pool, thrdpool_stamp(&copy, task, ring), 1u);
+#else
+    pthread_mutex_lock(&pool->lock);
+    success = thrdpool_enqueue(pool, thrdpool_stamp(&copy, task, ring), 1u);
+    pthread_mutex_unlock(&pool->lock);
+#endif
+    if(success) {
+        thrdpool_trace_enqueued(ring, &copy, 1u, ts);
+        thrdpool_notify(pool, 1u);
+    }
+    return success;
+}
+
+void thrdpool_schedule_or_run_internal(struct thrdpool *pool, struct thrdpool_task const *tasks, size_t ntasks) {
+    struct thrdpool_task copy;
+    struct thrdpool_worker *self = thrdpool_current;
+    size_t npushed;
+
+    for(size_t i = 0u; i < ntasks; i++) {
+        if(tasks[i].group) {
+            thrdpool_group_add(tasks[i].group, 1u);
+        }
+    }
+
+    npushed = thrdpool_push(pool, tasks, ntasks);
+    for(size_t i = npushed; i < ntasks; i++) {
+        if(self && self->pool == pool) {
+            thrdpool_run(self, thrdpool_stamp(&copy, &tasks[i], 0));
+        }
+        else {
+            thrdpool_call(&tasks[i]);
+        }
+    }
+}
+
+bool thrdpool_schedule_wait_impl(struct thrdpool *pool, struct thrdpool_task const *task, struct timespec const *deadline) {
     bool success;
+    int err = 0;
+    uint64_t ts = 0u;
+    struct thrdpool_task copy;
+    struct thrdpool_trace_ring *ring;
+    struct thrdpool_worker *self = thrdpool_current;
+
+    if(task->group) {
+        thrdpool_group_add(task->group, 1u);
+    }
+
+    if(thrdpool_push(pool, task, 1u)) {
+        return true;
+    }
+
+    if(self && self->pool == pool) {
+        /* Blocking a worker on the queue it is supposed to drain may deadlock the pool,
+         * run the task on the spot instead */
+        thrdpool_run(self, thrdpool_stamp(&copy, task, 0));
+        return true;
+    }
 
+    ring = thrdpool_trace_ring(pool);
     pthread_mutex_lock(&pool->lock);
-    success = thrdpool_taskq_push(&pool->q, task, args);
+    /* Seen by thrdpool_notify_producers, or sees the slots it freed */
+    atomic_fetch_add(&pool->nblocked, 1u);
+    while(1) {
+        ts = thrdpool_trace_now();
+        success = thrdpool_enqueue(pool, thrdpool_stamp(&copy, task, ring), 1u);
+        if(success || err || atomic_load(&pool->join)) {
+            break;
+        }
+
+        if(deadline) {
+            err = pthread_cond_timedwait(&pool->notfull, &pool->lock, deadline);
+        }
+        else {
+            pthread_cond_wait(&pool->notfull, &pool->lock);
+        }
+    }
+    atomic_fetch_sub(&pool->nblocked, 1u);
     pthread_mutex_unlock(&pool->lock);
 
     if(success) {
-        pthread_cond_signal(&pool->cv);
+        thrdpool_trace_enqueued(ring, &copy, 1u, ts);
+        thrdpool_notify(pool, 1u);
+    }
+    else {
+        thrdpool_discard(task, 1u);
+    }
+
+    return success;
+}
+
+/* Queue the tasks of expired timers, rearming those that are periodic */
+static void thrdpool_expire(struct thrdpool_worker *self) {
+    struct thrdpool *pool = self->pool;
+    struct thrdpool_timer *expired[THRDPOOL_BATCH_CAPACITY];
+    struct thrdpool_task tasks[THRDPOOL_BATCH_CAPACITY];
+    size_t ntimers;
+    uint64_t tick;
+
+    do {
+        /* Whoever holds the lock either expires the timers or updates the deadline on release */
+        if(pthread_mutex_trylock(&pool->timerlock)) {
+            return;
+        }
+        tick = thrdpool_timer_tick(pool, thrdpool_now());
+        ntimers = thrdpool_timer_wheel_expire(&pool->timers, tick, expired, thrdpool_arrsize(expired));
+        for(size_t i = 0u; i < ntimers; i++) {
+            tasks[i] = expired[i]->task;
+            if(expired[i]->period) {
+                /* Runs missed while the pool was too busy are skipped rather than made up for */
+                expired[i]->expires = thrdpool_add_sat(expired[i]->expires, expired[i]->period);
+                if(expired[i]->expires <= tick) {
+                    expired[i]->expires = thrdpool_add_sat(tick, expired[i]->period);
+                }
+                thrdpool_timer_wheel_add(&pool->timers, expired[i]);
+            }
+        }
+        thrdpool_timer_update(pool);
+        pthread_mutex_unlock(&pool->timerlock);
+
+        thrdpool_schedule_or_run_internal(pool, tasks, ntimers);
+    } while(ntimers == thrdpool_arrsize(expired));
+}
+
+bool thrdpool_schedule_after_impl(struct thrdpool *pool, struct thrdpool_timer *timer, uint64_t delay, uint64_t period,
+                                  void(*task)(void *), void *args) {
+    uint64_t ns;
+    bool sooner;
+
+    pthread_mutex_lock(&pool->timerlock);
+    if(thrdpool_timer_armed(timer) || atomic_load(&pool->join)) {
+        pthread_mutex_unlock(&pool->timerlock);
+        return false;
+    }
+
+    timer->task = (struct thrdpool_task) {
+        .handle = task,
+        .args = args
+    };
+    /* Rounded up, so that timers never expire early */
+    ns = thrdpool_add_sat(thrdpool_now() - pool->timerbase, delay);
+    timer->expires = ns / THRDPOOL_TIMER_TICK_NS + (ns % THRDPOOL_TIMER_TICK_NS != 0u);
+    timer->period = period / THRDPOOL_TIMER_TICK_NS + (period % THRDPOOL_TIMER_TICK_NS != 0u);
+    thrdpool_timer_wheel_add(&pool->timers, timer);
+    sooner = thrdpool_timer_update(pool);
+    pthread_mutex_unlock(&pool->timerlock);
+
+    if(sooner) {
+        /* The worker waiting for the previous deadline would oversleep, let it and any
+         * other parked worker take another look */
+        if(thrdpool_event_waiters(&pool->parked)) {
+            thrdpool_wake_all(pool);
+        }
+    }
+    return true;
+}
+
+bool thrdpool_timer_cancel_impl(struct thrdpool *pool, struct thrdpool_timer *timer) {
+    bool armed;
+
+    pthread_mutex_lock(&pool->timerlock);
+    armed = thrdpool_timer_armed(timer);
+    if(armed) {
+        thrdpool_timer_wheel_remove(&pool->timers, timer);
+        thrdpool_timer_update(pool);
+    }
+    pthread_mutex_unlock(&pool->timerlock);
+    return armed;
+}
+
+/* Wait in epoll_wait as the leader for at most timeout unless null, queueing the tasks of
+ * watches that fired. Returns false if the timeout expired */
+static bool thrdpool_reactor_wait(struct thrdpool_worker *self, unsigned key, struct timespec const *timeout) {
+    struct thrdpool *pool = self->pool;
+    struct epoll_event events[THRDPOOL_BATCH_CAPACITY];
+    struct thrdpool_task tasks[THRDPOOL_BATCH_CAPACITY];
+    struct thrdpool_watch *watch;
+    size_t ntasks = 0u;
+    uint64_t ms = UINT64_MAX;
+    uint64_t drained;
+    int nevents = -1;
+
+    if(timeout) {
+        /* Rounded up, so that the leader does not wake up just before its deadline */
+        ms = (uint64_t)timeout->tv_sec * 1000u + ((uint64_t)timeout->tv_nsec + 999999u) / 1000000u;
+    }
+
+    pthread_mutex_lock(&pool->watchlock);
+    atomic_store(&pool->polling, true);
+    pthread_mutex_unlock(&pool->watchlock);
+
+    /* Only once visible as polling, notifiers either interrupt epoll_wait or are seen here */
+    if(!thrdpool_event_signaled(&pool->parked, key)) {
+        nevents = epoll_wait(pool->epfd, events, (int)thrdpool_arrsize(events), ms < INT_MAX ? (int)ms : INT_MAX);
+        if(nevents < 0 && errno != EINTR) {
+            fprintf(stderr, "Error polling watched fds: %s\n", strerror(errno));
+        }
     }
 
+    /* Under the lock, so that watches returned by epoll_wait cannot be disarmed and
+     * released while they are being handled */
+    pthread_mutex_lock(&pool->watchlock);
+    for(int i = 0; i < nevents; i++) {
+        watch = events[i].data.ptr;
+        if(!watch) {
+            if(read(pool->wakefd, &drained, sizeof(drained)) < 0 && errno != EAGAIN) {
+                fprintf(stderr, "Error reading eventfd: %s\n", strerror(errno));
+            }
+            continue;
+        }
+        if(watch->armed) {
+            watch->armed = false;
+            watch->revents = events[i].events;
+            atomic_fetch_sub(&pool->nwatches, 1u);
+            tasks[ntasks++] = (struct thrdpool_task) {
+                .handle = watch->handle,
+                .args = watch->args
+            };
+        }
+    }
+    atomic_store(&pool->polling, false);
+    ++pool->npolled;
+    pthread_cond_broadcast(&pool->polled);
+    pthread_mutex_unlock(&pool->watchlock);
+
+    thrdpool_event_cancel(&pool->parked);
+
+    thrdpool_schedule_or_run_internal(pool, tasks, ntasks);
+    return nevents != 0;
+}
+
+bool thrdpool_watch_fd_impl(struct thrdpool *pool, struct thrdpool_watch *watch, int fd, uint32_t events,
+                            thrdpool_taskhandle task, void *args) {
+    /* One-shot, so that the fd is not reported again before the task has handled it */
+    struct epoll_event ev = {
+        .events = events | EPOLLONESHOT,
+        .data.ptr = watch
+    };
+    bool success = false;
+    int err;
+
+    pthread_mutex_lock(&pool->watchlock);
+    if(watch->armed || atomic_load(&pool->join)) {
+        goto epilogue;
+    }
+
+    if(watch->registered && watch->fd != fd) {
+        /* The previous fd may already have been closed, removing it from the instance */
+        epoll_ctl(pool->epfd, EPOLL_CTL_DEL, watch->fd, 0);
+        watch->registered = false;
+    }
+    err = epoll_ctl(pool->epfd, watch->registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &ev);
+    if(err && watch->registered && errno == ENOENT) {
+        /* Closed and reopened under the same number since last armed */
+        err = epoll_ctl(pool->epfd, EPOLL_CTL_ADD, fd, &ev);
+    }
+    if(err) {
+        fprintf(stderr, "Error watching fd %d: %s\n", fd, strerror(errno));
+        watch->registered = false;
+        goto epilogue;
+    }
+
+    watch->handle = task;
+    watch->args = args;
+    watch->fd = fd;
+    watch->registered = true;
+    watch->armed = true;
+    atomic_fetch_add(&pool->nwatches, 1u);
+    success = true;
+
+epilogue:
+    pthread_mutex_unlock(&pool->watchlock);
+
+    if(success && !atomic_load(&pool->polling)) {
+        /* Workers that parked while no watches were armed do not poll, let one of them
+         * take the lead */
+        if(thrdpool_event_waiters(&pool->parked)) {
+            thrdpool_wake_all(pool);
+        }
+    }
     return success;
 }
+
+bool thrdpool_unwatch_fd_impl(struct thrdpool *pool, struct thrdpool_watch *watch) {
+    size_t npolled;
+    bool armed;
+
+    pthread_mutex_lock(&pool->watchlock);
+    armed = watch->armed;
+    if(armed) {
+        watch->armed = false;
+        atomic_fetch_sub(&pool->nwatches, 1u);
+    }
+    if(watch->registered) {
+        epoll_ctl(pool->epfd, EPOLL_CTL_DEL, watch->fd, 0);
+        watch->registered = false;
+    }
+    /* The leader may have been handed the watch by epoll_wait before it was removed,
+     * wait for it to be done with what it got */
+    if(atomic_load(&pool->polling)) {
+        npolled = pool->npolled;
+        thrdpool_kick(pool);
+        while(pool->npolled == npolled) {
+            pthread_cond_wait(&pool->polled, &pool->watchlock);
+        }
+    }
+    pthread_mutex_unlock(&pool->watchlock);
+    return armed;
+}
+
+size_t thrdpool_schedule_batch_impl(struct thrdpool *pool, struct thrdpool_task const *tasks, size_t ntasks) {
+    size_t npushed;
+
+    /* Groups must be updated before the tasks get a chance to finish */
+    for(size_t i = 0u; i < ntasks; i++) {
+        if(tasks[i].group) {
+            thrdpool_group_add(tasks[i].group, 1u);
+        }
+    }
+
+    npushed = thrdpool_push(pool, tasks, ntasks);
+    thrdpool_discard(&tasks[npushed], ntasks - npushed);
+    return npushed;
+}
+
+bool thrdpool_wait_idle_impl(struct thrdpool *pool) {
+    struct thrdpool_worker *self = thrdpool_current;
+    if(self && self->pool == pool) {
+        /* The pool would never become idle */
+        return false;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    ++pool->nidlewaiters;
+    while(!atomic_load(&pool->join) &&
+          (atomic_load(&pool->idle) < pool->size || thrdpool_has_work(pool))) {
+        pthread_cond_wait(&pool->quiescent, &pool->lock);
+    }
+    --pool->nidlewaiters;
+    pthread_mutex_unlock(&pool->lock);
+    return true;
+}
+
+size_t thrdpool_pending_impl(struct thrdpool *pool) {
+    size_t ntasks;
+#ifdef THRDPOOL_TASKQ_LOCKFREE
+    ntasks = thrdpool_queued(pool);
+#else
+    pthread_mutex_lock(&pool->lock);
+    ntasks = thrdpool_queued(pool);
+    pthread_mutex_unlock(&pool->lock);
+#endif
+
+    for(size_t i = 0u; i < pool->capacity; i++) {
+        ntasks += atomic_load_explicit(&pool->workers[i].nclaimed, memory_order_relaxed);
+        ntasks += atomic_load_explicit(&pool->workers[i].nextstate, memory_order_relaxed) == THRDPOOL_NEXT_FULL;
+        if(pool->sched == THRDPOOL_SCHED_STEAL) {
+            ntasks += thrdpool_deque_size(&pool->workers[i].dq);
+        }
+    }
+    return ntasks;
+}
+
+void thrdpool_flush_impl(struct thrdpool *pool) {
+    struct thrdpool_task tasks[THRDPOOL_BATCH_CAPACITY];
+    size_t ntasks;
+    size_t nflushed = 0u;
+
+    /* The queues may be larger than what fits on the stack, drain them a batch at a time */
+#ifdef THRDPOOL_TASKQ_LOCKFREE
+    for(size_t i = 0u; i < pool->nqueues; i++) {
+        do {
+            ntasks = thrdpool_taskq_pop_batch(&pool->q[i], tasks, thrdpool_arrsize(tasks));
+            thrdpool_discard(tasks, ntasks);
+            nflushed += ntasks;
+        } while(ntasks == thrdpool_arrsize(tasks));
+    }
+
+    if(nflushed) {
+        thrdpool_notify_producers(pool, nflushed);
+    }
+#else
+    size_t nblocked = 0u;
+    for(size_t i = 0u; i < pool->nqueues; i++) {
+        do {
+            pthread_mutex_lock(&pool->lock);
+            ntasks = thrdpool_taskq_pop_batch(&pool->q[i], tasks, thrdpool_arrsize(tasks));
+            thrdpool_publish(pool);
+            nblocked = atomic_load(&pool->nblocked);
+            pthread_mutex_unlock(&pool->lock);
+
+            thrdpool_discard(tasks, ntasks);
+            nflushed += ntasks;
+        } while(ntasks == thrdpool_arrsize(tasks));
+    }
+
+    if(nflushed && nblocked) {
+        pthread_cond_broadcast(&pool->notfull);
+    }
+#endif
+
+    if(pool->sched == THRDPOOL_SCHED_STEAL) {
+        for(size_t i = 0u; i < pool->capacity; i++) {
+            while(thrdpool_deque_size(&pool->workers[i].dq)) {
+                if(thrdpool_deque_steal(&pool->workers[i].dq, &tasks[0])) {
+                    thrdpool_discard(&tasks[0], 1u);
+                }
+            }
+        }
+    }
+}
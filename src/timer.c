@@ -0,0 +1,138 @@
+#include <thrdpool/timer.h>
+
+#include <string.h>
+
+void thrdpool_timer_init(struct thrdpool_timer *timer);
+bool thrdpool_timer_armed(struct thrdpool_timer const *timer);
+
+/* Group of bits of tick resolved by level */
+static inline unsigned thrdpool_timer_digit(uint64_t tick, unsigned level) {
+    return (unsigned)(tick >> (level * THRDPOOL_TIMER_BITS)) & (THRDPOOL_TIMER_SLOTS - 1u);
+}
+
+/* Mask of the bits of a tick resolved by the levels below level */
+static inline uint64_t thrdpool_timer_low(unsigned level) {
+    return (UINT64_C(1) << (level * THRDPOOL_TIMER_BITS)) - 1u;
+}
+
+/* Move the timers in the slots the wheel has just reached the start of down a level,
+ * highest level first so that no timer is moved past a slot about to be emptied */
+static void thrdpool_timer_cascade(struct thrdpool_timer_wheel *wheel) {
+    struct thrdpool_timer *timer;
+    struct thrdpool_timer *next;
+    unsigned slot;
+    unsigned top = 0u;
+
+    while(top + 1u < THRDPOOL_TIMER_LEVELS && !(wheel->now & thrdpool_timer_low(top + 1u))) {
+        ++top;
+    }
+
+    for(unsigned level = top; level > 0u; level--) {
+        slot = thrdpool_timer_digit(wheel->now, level);
+        timer = wheel->slots[level * THRDPOOL_TIMER_SLOTS + slot];
+        if(!timer) {
+            continue;
+        }
+        wheel->slots[level * THRDPOOL_TIMER_SLOTS + slot] = 0;
+        wheel->occupied[level] &= ~(UINT64_C(1) << slot);
+        for(; timer; timer = next) {
+            next = timer->next;
+            thrdpool_timer_wheel_add(wheel, timer);
+        }
+    }
+}
+
+void thrdpool_timer_wheel_init(struct thrdpool_timer_wheel *wheel) {
+    wheel->now = 0u;
+    memset(wheel->occupied, 0, sizeof(wheel->occupied));
+    memset(wheel->slots, 0, sizeof(wheel->slots));
+}
+
+void thrdpool_timer_wheel_add(struct thrdpool_timer_wheel *wheel, struct thrdpool_timer *timer) {
+    uint64_t at = timer->expires > wheel->now ? timer->expires : wheel->now;
+    uint64_t diff = at ^ wheel->now;
+    unsigned level = diff ? (63u - (unsigned)__builtin_clzll(diff)) / THRDPOOL_TIMER_BITS : 0u;
+    unsigned slot = thrdpool_timer_digit(at, level);
+
+    timer->slot = level * THRDPOOL_TIMER_SLOTS + slot;
+    timer->next = wheel->slots[timer->slot];
+    if(timer->next) {
+        timer->next->pprev = &timer->next;
+    }
+    timer->pprev = &wheel->slots[timer->slot];
+    wheel->slots[timer->slot] = timer;
+    wheel->occupied[level] |= UINT64_C(1) << slot;
+}
+
+void thrdpool_timer_wheel_remove(struct thrdpool_timer_wheel *wheel, struct thrdpool_timer *timer) {
+    *timer->pprev = timer->next;
+    if(timer->next) {
+        timer->next->pprev = timer->pprev;
+    }
+    if(!wheel->slots[timer->slot]) {
+        wheel->occupied[timer->slot / THRDPOOL_TIMER_SLOTS] &= ~(UINT64_C(1) << (timer->slot % THRDPOOL_TIMER_SLOTS));
+    }
+    timer->next = 0;
+    timer->pprev = 0;
+}
+
+size_t thrdpool_timer_wheel_expire(struct thrdpool_timer_wheel *wheel, uint64_t tick, struct thrdpool_timer **expired, size_t n) {
+    struct thrdpool_timer **slot;
+    size_t nexpired = 0u;
+    uint64_t next;
+
+    while(wheel->now <= tick) {
+        thrdpool_timer_cascade(wheel);
+
+        slot = &wheel->slots[thrdpool_timer_digit(wheel->now, 0u)];
+        while(*slot && nexpired < n) {
+            expired[nexpired] = *slot;
+            thrdpool_timer_wheel_remove(wheel, expired[nexpired++]);
+        }
+        if(*slot) {
+            break;
+        }
+
+        /* Skip ahead to whatever happens next, nothing is due in between */
+        ++wheel->now;
+        next = thrdpool_timer_wheel_next(wheel);
+        wheel->now = next <= tick ? next : tick + 1u;
+    }
+    return nexpired;
+}
+
+uint64_t thrdpool_timer_wheel_next(struct thrdpool_timer_wheel const *wheel) {
+    unsigned shift;
+    uint64_t occupied;
+    uint64_t tick;
+
+    /* Slots below the current one on a level are always empty, and anything on a level
+     * happens before anything on those above it */
+    for(unsigned level = 0u; level < THRDPOOL_TIMER_LEVELS; level++) {
+        occupied = wheel->occupied[level] & (~UINT64_C(0) << thrdpool_timer_digit(wheel->now, level));
+        if(!occupied) {
+            continue;
+        }
+
+        shift = level * THRDPOOL_TIMER_BITS;
+        tick = shift + THRDPOOL_TIMER_BITS < 64u ? wheel->now & ~thrdpool_timer_low(level + 1u) : 0u;
+        tick |= (uint64_t)__builtin_ctzll(occupied) << shift;
+        /* The current slot of a level above the first is only occupied at its start */
+        return tick > wheel->now ? tick : wheel->now;
+    }
+    return UINT64_MAX;
+}
+
+void thrdpool_timer_wheel_clear(struct thrdpool_timer_wheel *wheel) {
+    struct thrdpool_timer *timer;
+    struct thrdpool_timer *next;
+
+    for(size_t i = 0u; i < THRDPOOL_TIMER_LEVELS * THRDPOOL_TIMER_SLOTS; i++) {
+        for(timer = wheel->slots[i]; timer; timer = next) {
+            next = timer->next;
+            thrdpool_timer_init(timer);
+        }
+        wheel->slots[i] = 0;
+    }
+    memset(wheel->occupied, 0, sizeof(wheel->occupied));
+}
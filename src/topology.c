@@ -0,0 +1,255 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <thrdpool/thrdpool.h>
+#include <thrdpool/topology.h>
+
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define THRDPOOL_TOPOLOGY_PATH_SIZE 256u
+#define THRDPOOL_TOPOLOGY_LINE_SIZE 4096u
+
+/* Compared member by member, ties are broken by the index of the CPU */
+struct thrdpool_topology_key {
+    unsigned key[3];
+    size_t idx;
+};
+
+static bool thrdpool_topology_line(char const *path, char *buf, size_t size) {
+    bool success;
+    FILE *fp = fopen(path, "r");
+    if(!fp) {
+        return false;
+    }
+    success = fgets(buf, (int)size, fp) != 0;
+    fclose(fp);
+    return success;
+}
+
+static bool thrdpool_topology_value(char const *path, unsigned *value) {
+    char buf[32];
+    char *end;
+    unsigned long v;
+
+    if(!thrdpool_topology_line(path, buf, sizeof(buf))) {
+        return false;
+    }
+    v = strtoul(buf, &end, 10);
+    if(end == buf) {
+        return false;
+    }
+    *value = (unsigned)v;
+    return true;
+}
+
+/* Read a list of ranges such as "0-3,8,10-11", keeping at most max ids */
+static size_t thrdpool_topology_list(char const *path, unsigned *ids, size_t max) {
+    char buf[THRDPOOL_TOPOLOGY_LINE_SIZE];
+    char const *str = buf;
+    char *end;
+    unsigned long lo;
+    unsigned long hi;
+    size_t n = 0u;
+
+    if(!thrdpool_topology_line(path, buf, sizeof(buf))) {
+        return 0u;
+    }
+
+    while(*str && *str != '\n') {
+        lo = strtoul(str, &end, 10);
+        if(end == str) {
+            break;
+        }
+        hi = lo;
+        if(*end == '-') {
+            str = end + 1;
+            hi = strtoul(str, &end, 10);
+            if(end == str) {
+                break;
+            }
+        }
+        for(; lo <= hi && n < max; lo++) {
+            ids[n++] = (unsigned)lo;
+        }
+        str = *end == ',' ? end + 1 : end;
+    }
+    return n;
+}
+
+static size_t thrdpool_topology_find(struct thrdpool_topology const *topo, unsigned id) {
+    size_t i = 0u;
+    while(i < topo->ncpus && topo->cpus[i].id != id) {
+        ++i;
+    }
+    return i;
+}
+
+bool thrdpool_topology_discover(struct thrdpool_topology *topo, char const *sysfs) {
+    char path[THRDPOOL_TOPOLOGY_PATH_SIZE];
+    unsigned ids[THRDPOOL_MAX_CPUS];
+    unsigned nodes[THRDPOOL_MAX_CPUS];
+    size_t nids;
+    size_t nnodes;
+    size_t idx;
+    bool populated;
+
+    if(!sysfs) {
+        sysfs = "/sys";
+    }
+
+    topo->ncpus = 0u;
+    topo->nnodes = 1u;
+
+    snprintf(path, sizeof(path), "%s/devices/system/cpu/online", sysfs);
+    nids = thrdpool_topology_list(path, ids, thrdpool_arrsize(ids));
+    for(size_t i = 0u; i < nids; i++) {
+        if(ids[i] >= THRDPOOL_MAX_CPUS) {
+            continue;
+        }
+        topo->cpus[topo->ncpus] = (struct thrdpool_cpu) {
+            .id = ids[i],
+            .core = ids[i],
+            .package = 0u,
+            .node = 0u
+        };
+
+        /* Missing on some architectures, each CPU is then a core of its own */
+        snprintf(path, sizeof(path), "%s/devices/system/cpu/cpu%u/topology/core_id", sysfs, ids[i]);
+        thrdpool_topology_value(path, &topo->cpus[topo->ncpus].core);
+        snprintf(path, sizeof(path), "%s/devices/system/cpu/cpu%u/topology/physical_package_id", sysfs, ids[i]);
+        thrdpool_topology_value(path, &topo->cpus[topo->ncpus].package);
+        ++topo->ncpus;
+    }
+    if(!topo->ncpus) {
+        return false;
+    }
+
+    /* Kernels built without NUMA support have no node directory */
+    snprintf(path, sizeof(path), "%s/devices/system/node/online", sysfs);
+    nnodes = thrdpool_topology_list(path, nodes, thrdpool_arrsize(nodes));
+    if(!nnodes) {
+        return true;
+    }
+
+    /* Memory-only nodes are skipped so that node indices stay dense */
+    topo->nnodes = 0u;
+    for(size_t i = 0u; i < nnodes; i++) {
+        snprintf(path, sizeof(path), "%s/devices/system/node/node%u/cpulist", sysfs, nodes[i]);
+        nids = thrdpool_topology_list(path, ids, thrdpool_arrsize(ids));
+        populated = false;
+        for(size_t j = 0u; j < nids; j++) {
+            idx = thrdpool_topology_find(topo, ids[j]);
+            if(idx < topo->ncpus) {
+                topo->cpus[idx].node = (unsigned)topo->nnodes;
+                populated = true;
+            }
+        }
+        topo->nnodes += populated;
+    }
+    if(!topo->nnodes) {
+        topo->nnodes = 1u;
+    }
+    return true;
+}
+
+static int thrdpool_topology_compare(void const *lhs, void const *rhs) {
+    struct thrdpool_topology_key const *l = lhs;
+    struct thrdpool_topology_key const *r = rhs;
+    for(size_t i = 0u; i < thrdpool_arrsize(l->key); i++) {
+        if(l->key[i] != r->key[i]) {
+            return l->key[i] < r->key[i] ? -1 : 1;
+        }
+    }
+    return (l->idx > r->idx) - (l->idx < r->idx);
+}
+
+size_t thrdpool_topology_order(struct thrdpool_topology const *topo, enum thrdpool_affinity affinity,
+                               unsigned const *cpus, size_t ncpus, size_t *order) {
+    struct thrdpool_topology_key keys[THRDPOOL_MAX_CPUS];
+    struct thrdpool_cpu const *cpu;
+    struct thrdpool_cpu const *prev;
+    unsigned core = 0u;
+    unsigned thread = 0u;
+
+    switch(affinity) {
+        case THRDPOOL_AFFINITY_LIST:
+            if(ncpus > THRDPOOL_MAX_CPUS) {
+                ncpus = THRDPOOL_MAX_CPUS;
+            }
+            for(size_t i = 0u; i < ncpus; i++) {
+                order[i] = thrdpool_topology_find(topo, cpus[i]);
+                if(order[i] == topo->ncpus) {
+                    return 0u;
+                }
+            }
+            return ncpus;
+        case THRDPOOL_AFFINITY_COMPACT:
+        case THRDPOOL_AFFINITY_SCATTER:
+            break;
+        default:
+            return 0u;
+    }
+
+    /* Hardware threads of a core end up next to each other, as do the cores of a node */
+    for(size_t i = 0u; i < topo->ncpus; i++) {
+        cpu = &topo->cpus[i];
+        keys[i] = (struct thrdpool_topology_key) {
+            .key = { cpu->node, cpu->package, cpu->core },
+            .idx = i
+        };
+    }
+    qsort(keys, topo->ncpus, sizeof(keys[0]), thrdpool_topology_compare);
+
+    if(affinity == THRDPOOL_AFFINITY_SCATTER) {
+        /* Take the first thread of the first core of each node, then the first thread of
+         * the second core of each node and so on, hardware threads sharing a core last */
+        for(size_t i = 0u; i < topo->ncpus; i++) {
+            cpu = &topo->cpus[keys[i].idx];
+            if(i) {
+                prev = &topo->cpus[keys[i - 1u].idx];
+                if(prev->node != cpu->node) {
+                    core = 0u;
+                    thread = 0u;
+                }
+                else if(prev->package != cpu->package || prev->core != cpu->core) {
+                    ++core;
+                    thread = 0u;
+                }
+                else {
+                    ++thread;
+                }
+            }
+            keys[i].key[0] = thread;
+            keys[i].key[1] = core;
+            keys[i].key[2] = cpu->node;
+        }
+        qsort(keys, topo->ncpus, sizeof(keys[0]), thrdpool_topology_compare);
+    }
+
+    for(size_t i = 0u; i < topo->ncpus; i++) {
+        order[i] = keys[i].idx;
+    }
+    return topo->ncpus;
+}
+
+int thrdpool_topology_bind(pthread_attr_t *attr, unsigned cpu) {
+    cpu_set_t set;
+    if(cpu >= CPU_SETSIZE) {
+        return EINVAL;
+    }
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_attr_setaffinity_np(attr, sizeof(set), &set);
+}
+
+unsigned thrdpool_topology_cpu(void) {
+    int cpu = sched_getcpu();
+    if(cpu < 0 || (unsigned)cpu >= THRDPOOL_MAX_CPUS) {
+        return THRDPOOL_MAX_CPUS;
+    }
+    return (unsigned)cpu;
+}
@@ -0,0 +1,217 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <thrdpool/thrdpool.h>
+#include <thrdpool/trace.h>
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef THRDPOOL_TRACE
+
+#define THRDPOOL_TRACE_CACHE_SIZE 4u
+
+uint64_t thrdpool_trace_id(struct thrdpool_trace_ring *ring);
+void thrdpool_trace_record(struct thrdpool_trace_ring *ring, enum thrdpool_trace_type type, struct thrdpool_task const *task);
+
+/* Rings claimed by the current thread in pools it is not a worker of */
+static _Thread_local struct {
+    uint64_t epoch;
+    struct thrdpool_trace_ring *ring;
+} thrdpool_trace_cache[THRDPOOL_TRACE_CACHE_SIZE];
+static _Thread_local unsigned thrdpool_trace_victim;
+
+static atomic_uint_least64_t thrdpool_trace_epochs = 1u;
+
+uint64_t thrdpool_trace_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+void thrdpool_trace_init(struct thrdpool_trace_ring *ring, size_t tid) {
+    atomic_init(&ring->begin, 0u);
+    atomic_init(&ring->end, 0u);
+    ring->tid = tid;
+    ring->nextid = 0u;
+}
+
+void thrdpool_trace_pool_init(struct thrdpool *pool) {
+    /* A pool reinitialized at the same address must not reuse rings cached by producers */
+    pool->traceepoch = atomic_fetch_add_explicit(&thrdpool_trace_epochs, 1u, memory_order_relaxed);
+    atomic_init(&pool->nproducers, 0u);
+    for(size_t i = 0u; i < pool->capacity; i++) {
+        thrdpool_trace_init(&pool->workers[i].trace, i);
+    }
+    for(size_t i = 0u; i < THRDPOOL_TRACE_PRODUCERS; i++) {
+        thrdpool_trace_init(&pool->producers[i], pool->capacity + i);
+    }
+}
+
+void thrdpool_trace_record_at(struct thrdpool_trace_ring *ring, enum thrdpool_trace_type type,
+                              struct thrdpool_task const *task, uint64_t ts) {
+    size_t idx = atomic_load_explicit(&ring->end, memory_order_relaxed);
+    struct thrdpool_trace_event *event = &ring->events[idx & (THRDPOOL_TRACE_EVENTS - 1u)];
+
+    atomic_store_explicit(&ring->begin, idx + 1u, memory_order_relaxed);
+    /* Readers that see any part of the new event also see begin */
+    atomic_thread_fence(memory_order_release);
+
+    atomic_store_explicit(&event->ts, ts, memory_order_relaxed);
+    atomic_store_explicit(&event->id, task ? task->traceid : 0u, memory_order_relaxed);
+    atomic_store_explicit(&event->handle, task ? (uintptr_t)task->handle : 0u, memory_order_relaxed);
+    atomic_store_explicit(&event->type, (unsigned)type, memory_order_relaxed);
+
+    atomic_store_explicit(&ring->end, idx + 1u, memory_order_release);
+}
+
+struct thrdpool_trace_ring *thrdpool_trace_producer(struct thrdpool *pool) {
+    size_t idx;
+    struct thrdpool_trace_ring *ring = 0;
+    unsigned slot;
+
+    for(unsigned i = 0u; i < THRDPOOL_TRACE_CACHE_SIZE; i++) {
+        if(thrdpool_trace_cache[i].epoch == pool->traceepoch) {
+            return thrdpool_trace_cache[i].ring;
+        }
+    }
+
+    idx = atomic_fetch_add_explicit(&pool->nproducers, 1u, memory_order_relaxed);
+    if(idx < THRDPOOL_TRACE_PRODUCERS) {
+        ring = &pool->producers[idx];
+    }
+
+    /* Cache failures as well, so that untraced threads do not keep bumping nproducers */
+    slot = thrdpool_trace_victim++ % THRDPOOL_TRACE_CACHE_SIZE;
+    thrdpool_trace_cache[slot].epoch = pool->traceepoch;
+    thrdpool_trace_cache[slot].ring = ring;
+    return ring;
+}
+
+static char const *thrdpool_trace_name(enum thrdpool_trace_type type) {
+    switch(type) {
+        case THRDPOOL_TRACE_ENQUEUE:
+            return "enqueue";
+        case THRDPOOL_TRACE_DEQUEUE:
+            return "dequeue";
+        case THRDPOOL_TRACE_STEAL:
+            return "steal";
+        case THRDPOOL_TRACE_START:
+        case THRDPOOL_TRACE_END:
+            return "task";
+        default:
+            return "parked";
+    }
+}
+
+static void thrdpool_trace_write(FILE *fp, struct thrdpool_trace_event *event, size_t tid) {
+    enum thrdpool_trace_type type = (enum thrdpool_trace_type)atomic_load_explicit(&event->type, memory_order_relaxed);
+    uint64_t ts = atomic_load_explicit(&event->ts, memory_order_relaxed);
+    uint64_t id = atomic_load_explicit(&event->id, memory_order_relaxed);
+    uintptr_t handle = atomic_load_explicit(&event->handle, memory_order_relaxed);
+    char const *ph;
+
+    switch(type) {
+        case THRDPOOL_TRACE_START:
+        case THRDPOOL_TRACE_PARK:
+            ph = "B";
+            break;
+        case THRDPOOL_TRACE_END:
+        case THRDPOOL_TRACE_UNPARK:
+            ph = "E";
+            break;
+        default:
+            ph = "i";
+            break;
+    }
+
+    fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%" PRIu64 ".%03u,\"pid\":1,\"tid\":%zu",
+            thrdpool_trace_name(type), ph, ts / 1000u, (unsigned)(ts % 1000u), tid);
+    if(*ph == 'i') {
+        fputs(",\"s\":\"t\"", fp);
+    }
+    if(id) {
+        fprintf(fp, ",\"args\":{\"task\":%" PRIu64 ",\"handle\":\"%#" PRIxPTR "\"}", id, handle);
+    }
+    fputc('}', fp);
+
+    /* Flow arrows from where a task was scheduled to where it ran */
+    if(id && (type == THRDPOOL_TRACE_ENQUEUE || type == THRDPOOL_TRACE_START)) {
+        fprintf(fp, ",\n{\"name\":\"task\",\"cat\":\"flow\",\"ph\":\"%s\",\"id\":%" PRIu64 ","
+                    "\"ts\":%" PRIu64 ".%03u,\"pid\":1,\"tid\":%zu%s}",
+                type == THRDPOOL_TRACE_ENQUEUE ? "s" : "f", id,
+                ts / 1000u, (unsigned)(ts % 1000u), tid,
+                type == THRDPOOL_TRACE_START ? ",\"bp\":\"e\"" : "");
+    }
+}
+
+static void thrdpool_trace_write_ring(FILE *fp, struct thrdpool_trace_ring *ring, struct thrdpool_trace_event *events) {
+    size_t end = atomic_load_explicit(&ring->end, memory_order_acquire);
+    size_t first = end > THRDPOOL_TRACE_EVENTS ? end - THRDPOOL_TRACE_EVENTS : 0u;
+    size_t begin;
+
+    /* Copy before checking which events were overwritten in the meantime */
+    for(size_t i = first; i < end; i++) {
+        struct thrdpool_trace_event *src = &ring->events[i & (THRDPOOL_TRACE_EVENTS - 1u)];
+        struct thrdpool_trace_event *dst = &events[i - first];
+        atomic_init(&dst->ts, atomic_load_explicit(&src->ts, memory_order_relaxed));
+        atomic_init(&dst->id, atomic_load_explicit(&src->id, memory_order_relaxed));
+        atomic_init(&dst->handle, atomic_load_explicit(&src->handle, memory_order_relaxed));
+        atomic_init(&dst->type, atomic_load_explicit(&src->type, memory_order_relaxed));
+    }
+    atomic_thread_fence(memory_order_acquire);
+    begin = atomic_load_explicit(&ring->begin, memory_order_relaxed);
+
+    for(size_t i = first; i < end; i++) {
+        if(i + THRDPOOL_TRACE_EVENTS >= begin) {
+            thrdpool_trace_write(fp, &events[i - first], ring->tid);
+        }
+    }
+}
+
+bool thrdpool_trace_dump_impl(struct thrdpool *pool, FILE *fp) {
+    size_t nproducers = atomic_load_explicit(&pool->nproducers, memory_order_acquire);
+    struct thrdpool_trace_event *events = malloc(THRDPOOL_TRACE_EVENTS * sizeof(*events));
+    if(!events) {
+        fprintf(stderr, "Error allocating trace buffer: %s\n", strerror(errno));
+        return false;
+    }
+
+    if(nproducers > THRDPOOL_TRACE_PRODUCERS) {
+        nproducers = THRDPOOL_TRACE_PRODUCERS;
+    }
+
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+          "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"thrdpool\"}}", fp);
+    for(size_t i = 0u; i < pool->capacity; i++) {
+        fprintf(fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,"
+                    "\"args\":{\"name\":\"worker %zu\"}}", pool->workers[i].trace.tid, i);
+    }
+    for(size_t i = 0u; i < nproducers; i++) {
+        fprintf(fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,"
+                    "\"args\":{\"name\":\"producer %zu\"}}", pool->producers[i].tid, i);
+    }
+
+    for(size_t i = 0u; i < pool->capacity; i++) {
+        thrdpool_trace_write_ring(fp, &pool->workers[i].trace, events);
+    }
+    for(size_t i = 0u; i < nproducers; i++) {
+        thrdpool_trace_write_ring(fp, &pool->producers[i], events);
+    }
+    fputs("\n]}\n", fp);
+
+    free(events);
+    return !ferror(fp);
+}
+
+#else
+
+bool thrdpool_trace_dump_impl(struct thrdpool *pool, FILE *fp) {
+    (void)pool;
+    (void)fp;
+    return false;
+}
+
+#endif
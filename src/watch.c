@@ -0,0 +1,3 @@
+#include <thrdpool/watch.h>
+
+void thrdpool_watch_init(struct thrdpool_watch *watch);
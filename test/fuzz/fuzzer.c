@@ -16,18 +16,15 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
-static unsigned processed;
 static unsigned parsum;
 
 static pthread_mutex_t lock;
-static pthread_cond_t cv;
+static struct thrdpool_group group;
 
 static void accumulate(void *p) {
     pthread_mutex_lock(&lock);
     parsum += *(uint8_t *)p;
-    ++processed;
     pthread_mutex_unlock(&lock);
-    pthread_cond_signal(&cv);
 }
 
 thrdpool_decl(pool, 1);
@@ -41,20 +38,15 @@ static bool process(uint8_t const *data, size_t size) {
     }
 
     parsum = 0u;
-    processed = 0u;
 
     for(unsigned i = 0; i < size; i++) {
         seqsum += data[i];
-        while(!thrdpool_schedule(&pool, accumulate, (void *)&data[i])) {
-            pthread_yield();
-        }
+        thrdpool_schedule_group_wait(&pool, &group, accumulate, (void *)&data[i]);
     }
 
-    pthread_mutex_lock(&lock);
-    while(processed < size) {
-        pthread_cond_wait(&cv, &lock);
-    }
+    thrdpool_group_wait(&group);
 
+    pthread_mutex_lock(&lock);
     if(seqsum != parsum) {
         fprintf(stderr, "Sums do not match, sequential: %u, parallel: %u\n", seqsum, parsum);
         success = false;
@@ -65,9 +57,9 @@ static bool process(uint8_t const *data, size_t size) {
 }
 
 static void cleanup(void) {
-    pthread_mutex_destroy(&lock);
-    pthread_cond_destroy(&cv);
     thrdpool_destroy(&pool);
+    pthread_mutex_destroy(&lock);
+    thrdpool_group_destroy(&group);
 }
 
 int LLVMFuzzerTestOneInput(uint8_t const* data, size_t size) {
@@ -78,7 +70,7 @@ int LLVMFuzzerTestOneInput(uint8_t const* data, size_t size) {
     if(!initialized) {
         assert(thrdpool_init(&pool));
         assert(!pthread_mutex_init(&lock, 0));
-        assert(!pthread_cond_init(&cv, 0));
+        assert(thrdpool_group_init(&group));
         atexit(cleanup);
         initialized = true;
     }
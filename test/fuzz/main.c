@@ -20,8 +20,7 @@
 #define str_expand(x) str(x)
 
 static pthread_mutex_t lock;
-static pthread_cond_t cv;
-static unsigned processed;
+static struct thrdpool_group group;
 static unsigned parsum;
 
 static unsigned volatile child_alive = 1;
@@ -60,9 +59,7 @@ static bool set_sighandler(void) {
 static void accumulate(void *p) {
     pthread_mutex_lock(&lock);
     parsum += *(uint8_t *)p;
-    ++processed;
     pthread_mutex_unlock(&lock);
-    pthread_cond_signal(&cv);
 }
 
 thrdpool_decl(pool, 32);
@@ -72,6 +69,7 @@ static bool process(struct shmbuf *shmb) {
     bool success = true;
 
     static uint8_t data[FUZZ_MAXLEN];
+    static struct thrdpool_task tasks[FUZZ_MAXLEN];
     size_t size = shmb->size;
     memcpy(data, shmb->data, size);
 
@@ -81,22 +79,29 @@ static bool process(struct shmbuf *shmb) {
 
     pthread_mutex_lock(&lock);
     parsum = 0u;
-    processed = 0u;
     pthread_mutex_unlock(&lock);
 
     for(unsigned i = 0; i < size; i++) {
         seqsum += data[i];
-        while(!thrdpool_schedule(&pool, accumulate, &data[i])) {
-            pthread_yield();
+        tasks[i] = (struct thrdpool_task) {
+            .handle = accumulate,
+            .args = &data[i],
+            .group = &group
+        };
+    }
+
+    for(size_t scheduled = 0u; scheduled < size;) {
+        scheduled += thrdpool_schedule_batch(&pool, &tasks[scheduled], size - scheduled);
+        /* Queue full, sleep until there is room for at least one more */
+        if(scheduled < size && thrdpool_schedule_group_wait(&pool, &group, accumulate, &data[scheduled])) {
+            ++scheduled;
         }
     }
 
     /* Wait until all data has been processed */
-    pthread_mutex_lock(&lock);
-    while(processed < size) {
-        pthread_cond_wait(&cv, &lock);
-    }
+    thrdpool_group_wait(&group);
 
+    pthread_mutex_lock(&lock);
     if(seqsum != parsum) {
         fprintf(stderr, "Sums do not match, sequential: %u, parallel: %u\n", seqsum, parsum);
         success = false;
@@ -116,22 +121,21 @@ int main(int argc, char **argv) {
     bool thrdpool_inited = false;
     struct shmbuf *shmb = MAP_FAILED;
 
-    err = pthread_cond_init(&cv, 0);
-    if(err) {
-        fprintf(stderr, "pthread_cond_init: %s\n", strerror(err));
+    if(!thrdpool_group_init(&group)) {
+        fputs("thrdpool_group_init\n", stderr);
         return 1;
     }
     err = pthread_mutex_init(&lock, 0);
     if(err) {
         fprintf(stderr, "pthread_mutex_init: %s\n", strerror(err));
-        pthread_cond_destroy(&cv);
+        thrdpool_group_destroy(&group);
         return 1;
     }
 
     int fd = shm_open(SHMPATH, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
     if(fd == -1) {
         perror("shm_open");
-        pthread_cond_destroy(&cv);
+        thrdpool_group_destroy(&group);
         pthread_mutex_destroy(&lock);
         return 1;
     }
@@ -219,7 +223,7 @@ epilogue:
     }
     close(fd);
     shm_unlink(SHMPATH);
-    pthread_cond_destroy(&cv);
+    thrdpool_group_destroy(&group);
     pthread_mutex_destroy(&lock);
     return status;
 }
@@ -0,0 +1,103 @@
+#include <unity.h>
+#include <thrdpool/deque.h>
+
+#include <pthread.h>
+#include <stdint.h>
+
+#define NTHIEVES 3u
+#define NSTRESS_TASKS 4096u
+
+static struct thrdpool_deque dq;
+static unsigned executed[NSTRESS_TASKS];
+static atomic_uint nexecuted;
+
+void setUp(void) {
+    thrdpool_deque_init(&dq);
+}
+
+void mark(void *args) {
+    ++executed[(uintptr_t)args];
+    atomic_fetch_add(&nexecuted, 1u);
+}
+
+void nop(void *args) {
+    (void)args;
+}
+
+static void *thief(void *args) {
+    (void)args;
+    struct thrdpool_task task;
+    while(atomic_load(&nexecuted) < NSTRESS_TASKS) {
+        if(thrdpool_deque_steal(&dq, &task)) {
+            thrdpool_call(&task);
+        }
+    }
+    return 0;
+}
+
+void test_deque_pop_lifo(void) {
+    struct thrdpool_task task;
+    TEST_ASSERT_TRUE(thrdpool_deque_push(&dq, &(struct thrdpool_task) { .handle = nop, .args = (void *)1u }));
+    TEST_ASSERT_TRUE(thrdpool_deque_push(&dq, &(struct thrdpool_task) { .handle = nop, .args = (void *)2u }));
+    TEST_ASSERT_EQUAL_UINT32((unsigned)thrdpool_deque_size(&dq), 2u);
+
+    TEST_ASSERT_TRUE(thrdpool_deque_pop(&dq, &task));
+    TEST_ASSERT_EQUAL_PTR(task.args, (void *)2u);
+    TEST_ASSERT_TRUE(thrdpool_deque_pop(&dq, &task));
+    TEST_ASSERT_EQUAL_PTR(task.args, (void *)1u);
+    TEST_ASSERT_FALSE(thrdpool_deque_pop(&dq, &task));
+    TEST_ASSERT_EQUAL_UINT32((unsigned)thrdpool_deque_size(&dq), 0u);
+}
+
+void test_deque_steal_fifo(void) {
+    struct thrdpool_task task;
+    TEST_ASSERT_TRUE(thrdpool_deque_push(&dq, &(struct thrdpool_task) { .handle = nop, .args = (void *)1u }));
+    TEST_ASSERT_TRUE(thrdpool_deque_push(&dq, &(struct thrdpool_task) { .handle = nop, .args = (void *)2u }));
+
+    TEST_ASSERT_TRUE(thrdpool_deque_steal(&dq, &task));
+    TEST_ASSERT_EQUAL_PTR(task.args, (void *)1u);
+    TEST_ASSERT_TRUE(thrdpool_deque_pop(&dq, &task));
+    TEST_ASSERT_EQUAL_PTR(task.args, (void *)2u);
+    TEST_ASSERT_FALSE(thrdpool_deque_steal(&dq, &task));
+}
+
+void test_deque_capacity(void) {
+    struct thrdpool_task task;
+    for(unsigned i = 0u; i < THRDPOOL_DEQUE_CAPACITY; i++) {
+        TEST_ASSERT_TRUE(thrdpool_deque_push(&dq, &(struct thrdpool_task) { .handle = nop, .args = 0 }));
+    }
+    TEST_ASSERT_FALSE(thrdpool_deque_push(&dq, &(struct thrdpool_task) { .handle = nop, .args = 0 }));
+
+    TEST_ASSERT_TRUE(thrdpool_deque_steal(&dq, &task));
+    TEST_ASSERT_TRUE(thrdpool_deque_push(&dq, &(struct thrdpool_task) { .handle = nop, .args = 0 }));
+    TEST_ASSERT_FALSE(thrdpool_deque_push(&dq, &(struct thrdpool_task) { .handle = nop, .args = 0 }));
+}
+
+void test_deque_concurrent_steal(void) {
+    pthread_t thieves[NTHIEVES];
+    struct thrdpool_task task;
+
+    atomic_store(&nexecuted, 0u);
+    for(unsigned i = 0u; i < NTHIEVES; i++) {
+        TEST_ASSERT_EQUAL_INT32(pthread_create(&thieves[i], 0, thief, 0), 0);
+    }
+
+    for(uintptr_t i = 0u; i < NSTRESS_TASKS; i++) {
+        while(!thrdpool_deque_push(&dq, &(struct thrdpool_task) { .handle = mark, .args = (void *)i })) {
+            if(thrdpool_deque_pop(&dq, &task)) {
+                thrdpool_call(&task);
+            }
+        }
+    }
+    while(thrdpool_deque_pop(&dq, &task)) {
+        thrdpool_call(&task);
+    }
+
+    for(unsigned i = 0u; i < NTHIEVES; i++) {
+        TEST_ASSERT_EQUAL_INT32(pthread_join(thieves[i], 0), 0);
+    }
+
+    for(unsigned i = 0u; i < NSTRESS_TASKS; i++) {
+        TEST_ASSERT_EQUAL_UINT32(executed[i], 1u);
+    }
+}
@@ -0,0 +1,84 @@
+#include <unity.h>
+#include <thrdpool/event.h>
+
+#include <pthread.h>
+
+#define NROUNDS 20000u
+
+static struct thrdpool_event ev;
+static atomic_uint turn;
+
+void setUp(void) {
+    thrdpool_event_init(&ev);
+    atomic_store(&turn, 0u);
+}
+
+void tearDown(void) { }
+
+/* Wait for the turn counter to reach value */
+static void await(unsigned value) {
+    unsigned key;
+    while(1) {
+        key = thrdpool_event_prepare(&ev);
+        if(atomic_load_explicit(&turn, memory_order_relaxed) == value) {
+            thrdpool_event_cancel(&ev);
+            return;
+        }
+        thrdpool_event_wait(&ev, key, 0);
+    }
+}
+
+static void advance(void) {
+    atomic_fetch_add(&turn, 1u);
+    if(thrdpool_event_waiters(&ev)) {
+        thrdpool_event_notify(&ev, 1u);
+    }
+}
+
+static void *ping(void *args) {
+    (void)args;
+    for(unsigned i = 0u; i < NROUNDS; i++) {
+        await(2u * i + 1u);
+        advance();
+    }
+    return 0;
+}
+
+void test_event_waiters(void) {
+    unsigned key = thrdpool_event_prepare(&ev);
+    TEST_ASSERT_EQUAL_UINT32(1u, thrdpool_event_waiters(&ev));
+    TEST_ASSERT_EQUAL_UINT32(key, atomic_load(&ev.seq));
+    thrdpool_event_cancel(&ev);
+    TEST_ASSERT_EQUAL_UINT32(0u, thrdpool_event_waiters(&ev));
+}
+
+void test_event_stale_key(void) {
+    unsigned key = thrdpool_event_prepare(&ev);
+    thrdpool_event_notify(&ev, 1u);
+    /* Notified since the key was read, must not block */
+    thrdpool_event_wait(&ev, key, 0);
+    TEST_ASSERT_EQUAL_UINT32(0u, thrdpool_event_waiters(&ev));
+    TEST_ASSERT_TRUE(key != atomic_load(&ev.seq));
+}
+
+void test_event_timeout(void) {
+    struct timespec timeout = { .tv_sec = 0, .tv_nsec = 1000000 };
+    unsigned key = thrdpool_event_prepare(&ev);
+    TEST_ASSERT_FALSE(thrdpool_event_wait(&ev, key, &timeout));
+    TEST_ASSERT_EQUAL_UINT32(0u, thrdpool_event_waiters(&ev));
+}
+
+void test_event_ping_pong(void) {
+    pthread_t thrd;
+    TEST_ASSERT_EQUAL_INT32(0, pthread_create(&thrd, 0, ping, 0));
+
+    /* A lost wakeup leaves both threads waiting for each other */
+    for(unsigned i = 0u; i < NROUNDS; i++) {
+        await(2u * i);
+        advance();
+    }
+    await(2u * NROUNDS);
+
+    TEST_ASSERT_EQUAL_INT32(0, pthread_join(thrd, 0));
+    TEST_ASSERT_EQUAL_UINT32(0u, thrdpool_event_waiters(&ev));
+}
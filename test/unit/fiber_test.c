@@ -0,0 +1,169 @@
+#include <unity.h>
+
+#include <thrdpool/thrdpool.h>
+
+#include <sched.h>
+
+#define NFIBERS 1000u
+#define NCHILDREN 64u
+#define NYIELDS 100u
+
+static atomic_uint started;
+static atomic_uint resumed;
+static atomic_uint children;
+static atomic_uint seq;
+static unsigned order[2u * NYIELDS];
+static struct thrdpool_group gate;
+
+thrdpool_decl(pool, 2u);
+
+static enum thrdpool_sched const scheds[] = { THRDPOOL_SCHED_SHARED, THRDPOOL_SCHED_STEAL };
+
+void setUp(void) {
+    atomic_store(&started, 0u);
+    atomic_store(&resumed, 0u);
+    atomic_store(&children, 0u);
+    atomic_store(&seq, 0u);
+}
+
+void tearDown(void) { }
+
+static void init_pool(enum thrdpool_sched sched, size_t nworkers) {
+    struct thrdpool_attr attr = thrdpool_attr_init();
+    attr.sched = sched;
+    TEST_ASSERT_TRUE(thrdpool_init_impl(&pool.d_pool, nworkers, &attr));
+}
+
+void wait_gate(void *arg) {
+    (void)arg;
+    atomic_fetch_add(&started, 1u);
+    thrdpool_await(&gate);
+    atomic_fetch_add(&resumed, 1u);
+}
+
+void child(void *arg) {
+    (void)arg;
+    atomic_fetch_add(&children, 1u);
+}
+
+void parent(void *arg) {
+    struct thrdpool_group group;
+    (void)arg;
+
+    TEST_ASSERT_TRUE(thrdpool_group_init(&group));
+    for(unsigned i = 0u; i < NCHILDREN; i++) {
+        TEST_ASSERT_TRUE(thrdpool_schedule_group_wait(&pool, &group, child, 0));
+    }
+    /* With a single worker, blocking it here would leave the children unrun */
+    thrdpool_await(&group);
+    TEST_ASSERT_EQUAL_UINT32(NCHILDREN, atomic_load(&children));
+    TEST_ASSERT_TRUE(thrdpool_group_destroy(&group));
+}
+
+void yielder(void *arg) {
+    unsigned id = *(unsigned *)arg;
+    for(unsigned i = 0u; i < NYIELDS; i++) {
+        order[atomic_fetch_add(&seq, 1u)] = id;
+        TEST_ASSERT_TRUE(thrdpool_yield());
+    }
+}
+
+void test_fiber_await_many(void) {
+    struct thrdpool_group group;
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        setUp();
+        init_pool(scheds[i], 2u);
+        TEST_ASSERT_TRUE(thrdpool_group_init(&group));
+        TEST_ASSERT_TRUE(thrdpool_group_init(&gate));
+        thrdpool_group_add(&gate, 1u);
+
+        for(unsigned j = 0u; j < NFIBERS; j++) {
+            while(!thrdpool_schedule_fiber_group(&pool, &group, wait_gate, 0)) {
+                sched_yield();
+            }
+        }
+        /* Every fiber is suspended at once on the two workers */
+        while(atomic_load(&started) < NFIBERS) {
+            sched_yield();
+        }
+        TEST_ASSERT_EQUAL_UINT32(0u, atomic_load(&resumed));
+        TEST_ASSERT_EQUAL_UINT64(NFIBERS, thrdpool_group_pending(&group));
+
+        thrdpool_group_done(&gate);
+        thrdpool_group_wait(&group);
+        TEST_ASSERT_EQUAL_UINT32(NFIBERS, atomic_load(&resumed));
+
+        TEST_ASSERT_TRUE(thrdpool_group_destroy(&gate));
+        TEST_ASSERT_TRUE(thrdpool_group_destroy(&group));
+        TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+    }
+}
+
+void test_fiber_await_children(void) {
+    struct thrdpool_group group;
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        setUp();
+        init_pool(scheds[i], 1u);
+        TEST_ASSERT_TRUE(thrdpool_group_init(&group));
+
+        TEST_ASSERT_TRUE(thrdpool_schedule_fiber_group(&pool, &group, parent, 0));
+        thrdpool_group_wait(&group);
+        TEST_ASSERT_EQUAL_UINT32(NCHILDREN, atomic_load(&children));
+
+        TEST_ASSERT_TRUE(thrdpool_group_destroy(&group));
+        TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+    }
+}
+
+void test_fiber_yield(void) {
+    struct thrdpool_group group;
+    unsigned ids[] = { 1u, 2u };
+    unsigned last;
+    unsigned first;
+
+    TEST_ASSERT_FALSE(thrdpool_yield());
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        setUp();
+        init_pool(scheds[i], 1u);
+        TEST_ASSERT_TRUE(thrdpool_group_init(&group));
+
+        TEST_ASSERT_TRUE(thrdpool_schedule_fiber_group(&pool, &group, yielder, &ids[0]));
+        TEST_ASSERT_TRUE(thrdpool_schedule_fiber_group(&pool, &group, yielder, &ids[1]));
+        thrdpool_group_wait(&group);
+        TEST_ASSERT_EQUAL_UINT32(2u * NYIELDS, atomic_load(&seq));
+
+        /* Each yield lets the other fiber run on the single worker */
+        first = 0u;
+        last = 0u;
+        for(unsigned j = 0u; j < 2u * NYIELDS; j++) {
+            if(order[j] == ids[0]) {
+                last = j;
+            }
+            else if(!first) {
+                first = j;
+            }
+        }
+        TEST_ASSERT_TRUE(first < last);
+
+        TEST_ASSERT_TRUE(thrdpool_group_destroy(&group));
+        TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+    }
+}
+
+void test_fiber_await_outside(void) {
+    init_pool(THRDPOOL_SCHED_SHARED, 2u);
+    TEST_ASSERT_TRUE(thrdpool_group_init(&gate));
+
+    for(unsigned i = 0u; i < NCHILDREN; i++) {
+        TEST_ASSERT_TRUE(thrdpool_schedule_group_wait(&pool, &gate, child, 0));
+    }
+    /* Not a fiber, waits like thrdpool_group_wait */
+    thrdpool_await(&gate);
+    TEST_ASSERT_EQUAL_UINT32(NCHILDREN, atomic_load(&children));
+
+    TEST_ASSERT_TRUE(thrdpool_group_destroy(&gate));
+    TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+}
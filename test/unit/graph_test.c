@@ -0,0 +1,203 @@
+#include <unity.h>
+
+#include <thrdpool/thrdpool.h>
+
+#include <sched.h>
+#include <stdint.h>
+
+#define FANOUT 200u
+#define CHAIN_LENGTH 1000u
+
+static atomic_uint ticks;
+static atomic_uint stamps[FANOUT + 2u];
+static unsigned chained;
+static atomic_bool release;
+
+thrdpool_decl(pool, 4u);
+
+static enum thrdpool_sched const scheds[] = { THRDPOOL_SCHED_SHARED, THRDPOOL_SCHED_STEAL };
+
+void setUp(void) {
+    atomic_store(&ticks, 0u);
+    for(unsigned i = 0u; i < FANOUT + 2u; i++) {
+        atomic_store(&stamps[i], 0u);
+    }
+    chained = 0u;
+    atomic_store(&release, false);
+}
+
+void tearDown(void) { }
+
+/* Record when the node ran, starting at 1 */
+void stamp(void *arg) {
+    atomic_store((atomic_uint *)arg, atomic_fetch_add(&ticks, 1u) + 1u);
+}
+
+void chain(void *arg) {
+    (void)arg;
+    /* Plain increments, each node must see what its predecessor did */
+    ++chained;
+}
+
+void hold(void *arg) {
+    (void)arg;
+    while(!atomic_load(&release)) {
+        sched_yield();
+    }
+}
+
+static void init_pool(enum thrdpool_sched sched, size_t nworkers) {
+    struct thrdpool_attr attr = thrdpool_attr_init();
+    attr.sched = sched;
+    TEST_ASSERT_TRUE(thrdpool_init_impl(&pool.d_pool, nworkers, &attr));
+}
+
+void test_graph_diamond(void) {
+    struct thrdpool_node *nodes[4];
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        thrdpool_graph_decl(graph, 4u, 4u);
+        setUp();
+        init_pool(scheds[i], 4u);
+        TEST_ASSERT_TRUE(thrdpool_graph_init(&graph));
+
+        for(unsigned j = 0u; j < 4u; j++) {
+            nodes[j] = thrdpool_graph_node(&graph, stamp, &stamps[j]);
+        }
+        TEST_ASSERT_TRUE(thrdpool_graph_edge(&graph, nodes[0], nodes[1]));
+        TEST_ASSERT_TRUE(thrdpool_graph_edge(&graph, nodes[0], nodes[2]));
+        TEST_ASSERT_TRUE(thrdpool_graph_edge(&graph, nodes[1], nodes[3]));
+        TEST_ASSERT_TRUE(thrdpool_graph_edge(&graph, nodes[2], nodes[3]));
+
+        TEST_ASSERT_TRUE(thrdpool_graph_submit(&pool, &graph));
+        thrdpool_graph_wait(&graph);
+
+        TEST_ASSERT_EQUAL_UINT32(1u, atomic_load(&stamps[0]));
+        TEST_ASSERT_TRUE(atomic_load(&stamps[1]) > 1u && atomic_load(&stamps[1]) < 4u);
+        TEST_ASSERT_TRUE(atomic_load(&stamps[2]) > 1u && atomic_load(&stamps[2]) < 4u);
+        TEST_ASSERT_EQUAL_UINT32(4u, atomic_load(&stamps[3]));
+
+        TEST_ASSERT_TRUE(thrdpool_graph_destroy(&graph));
+        TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+    }
+}
+
+void test_graph_fan_out_fan_in(void) {
+    static thrdpool_graph_decl(graph, FANOUT + 2u, 2u * FANOUT);
+    struct thrdpool_node *source;
+    struct thrdpool_node *sink;
+    struct thrdpool_node *node;
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        setUp();
+        init_pool(scheds[i], 4u);
+        TEST_ASSERT_TRUE(thrdpool_graph_init(&graph));
+
+        source = thrdpool_graph_node(&graph, stamp, &stamps[0]);
+        sink = thrdpool_graph_node(&graph, stamp, &stamps[FANOUT + 1u]);
+        for(unsigned j = 1u; j <= FANOUT; j++) {
+            node = thrdpool_graph_node(&graph, stamp, &stamps[j]);
+            TEST_ASSERT_TRUE(thrdpool_graph_edge(&graph, source, node));
+            TEST_ASSERT_TRUE(thrdpool_graph_edge(&graph, node, sink));
+        }
+        TEST_ASSERT_NULL(thrdpool_graph_node(&graph, stamp, 0));
+        TEST_ASSERT_FALSE(thrdpool_graph_edge(&graph, source, sink));
+
+        /* Graphs may be submitted again once finished */
+        for(unsigned run = 0u; run < 2u; run++) {
+            atomic_store(&ticks, 0u);
+            TEST_ASSERT_TRUE(thrdpool_graph_submit(&pool, &graph));
+            thrdpool_graph_wait(&graph);
+
+            TEST_ASSERT_EQUAL_UINT32(1u, atomic_load(&stamps[0]));
+            for(unsigned j = 1u; j <= FANOUT; j++) {
+                TEST_ASSERT_TRUE(atomic_load(&stamps[j]) > 1u && atomic_load(&stamps[j]) <= FANOUT + 1u);
+            }
+            TEST_ASSERT_EQUAL_UINT32(FANOUT + 2u, atomic_load(&stamps[FANOUT + 1u]));
+        }
+
+        TEST_ASSERT_TRUE(thrdpool_graph_destroy(&graph));
+        TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+    }
+}
+
+void test_graph_chain(void) {
+    static thrdpool_graph_decl(graph, CHAIN_LENGTH, CHAIN_LENGTH - 1u);
+    struct thrdpool_node *prev;
+    struct thrdpool_node *node;
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        setUp();
+        init_pool(scheds[i], 4u);
+        TEST_ASSERT_TRUE(thrdpool_graph_init(&graph));
+
+        prev = thrdpool_graph_node(&graph, chain, 0);
+        for(unsigned j = 1u; j < CHAIN_LENGTH; j++) {
+            node = thrdpool_graph_node(&graph, chain, 0);
+            TEST_ASSERT_TRUE(thrdpool_graph_edge(&graph, prev, node));
+            prev = node;
+        }
+
+        TEST_ASSERT_TRUE(thrdpool_graph_submit(&pool, &graph));
+        thrdpool_graph_wait(&graph);
+        TEST_ASSERT_EQUAL_UINT32(CHAIN_LENGTH, chained);
+
+        TEST_ASSERT_TRUE(thrdpool_graph_destroy(&graph));
+        TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+    }
+}
+
+void test_graph_submit_running(void) {
+    thrdpool_graph_decl(graph, 2u, 1u);
+    struct thrdpool_node *held;
+
+    init_pool(THRDPOOL_SCHED_SHARED, 2u);
+    TEST_ASSERT_TRUE(thrdpool_graph_init(&graph));
+    held = thrdpool_graph_node(&graph, hold, 0);
+    TEST_ASSERT_TRUE(thrdpool_graph_edge(&graph, held, thrdpool_graph_node(&graph, stamp, &stamps[0])));
+
+    TEST_ASSERT_TRUE(thrdpool_graph_submit(&pool, &graph));
+    TEST_ASSERT_FALSE(thrdpool_graph_submit(&pool, &graph));
+    atomic_store(&release, true);
+    thrdpool_graph_wait(&graph);
+    TEST_ASSERT_EQUAL_UINT32(1u, atomic_load(&stamps[0]));
+
+    TEST_ASSERT_TRUE(thrdpool_graph_destroy(&graph));
+    TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+}
+
+void nested(void *arg) {
+    thrdpool_graph_decl(graph, 8u, 7u);
+    struct thrdpool_node *root;
+    (void)arg;
+
+    TEST_ASSERT_TRUE(thrdpool_graph_init(&graph));
+    root = thrdpool_graph_node(&graph, stamp, &stamps[0]);
+    for(unsigned i = 1u; i < 8u; i++) {
+        TEST_ASSERT_TRUE(thrdpool_graph_edge(&graph, root, thrdpool_graph_node(&graph, stamp, &stamps[i])));
+    }
+
+    TEST_ASSERT_TRUE(thrdpool_graph_submit(&pool, &graph));
+    /* The only worker runs the nested graph itself */
+    thrdpool_graph_wait(&graph);
+    TEST_ASSERT_EQUAL_UINT32(8u, atomic_load(&ticks));
+    TEST_ASSERT_TRUE(thrdpool_graph_destroy(&graph));
+}
+
+void test_graph_nested(void) {
+    thrdpool_graph_decl(graph, 1u, 1u);
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        setUp();
+        init_pool(scheds[i], 1u);
+        TEST_ASSERT_TRUE(thrdpool_graph_init(&graph));
+        thrdpool_graph_node(&graph, nested, 0);
+
+        TEST_ASSERT_TRUE(thrdpool_graph_submit(&pool, &graph));
+        thrdpool_graph_wait(&graph);
+        TEST_ASSERT_EQUAL_UINT32(8u, atomic_load(&ticks));
+
+        TEST_ASSERT_TRUE(thrdpool_graph_destroy(&graph));
+        TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+    }
+}
@@ -0,0 +1,71 @@
+#include <unity.h>
+#include <thrdpool/group.h>
+#include <thrdpool/task.h>
+
+#include <pthread.h>
+
+#define NTHREADS 4u
+#define NTASKS_PER_THREAD 1024u
+
+static struct thrdpool_group group;
+static atomic_uint nexecuted;
+
+void setUp(void) {
+    TEST_ASSERT_TRUE(thrdpool_group_init(&group));
+}
+
+void tearDown(void) {
+    TEST_ASSERT_TRUE(thrdpool_group_destroy(&group));
+}
+
+void count(void *args) {
+    (void)args;
+    atomic_fetch_add(&nexecuted, 1u);
+}
+
+static void *runner(void *args) {
+    (void)args;
+    struct thrdpool_task task = {
+        .handle = count,
+        .group = &group
+    };
+    for(unsigned i = 0u; i < NTASKS_PER_THREAD; i++) {
+        thrdpool_call(&task);
+    }
+    return 0;
+}
+
+void test_group_empty(void) {
+    TEST_ASSERT_EQUAL_UINT32(0u, (unsigned)thrdpool_group_pending(&group));
+    /* Must not block */
+    thrdpool_group_wait(&group);
+}
+
+void test_group_add_done(void) {
+    thrdpool_group_add(&group, 3u);
+    TEST_ASSERT_EQUAL_UINT32(3u, (unsigned)thrdpool_group_pending(&group));
+    thrdpool_group_done(&group);
+    thrdpool_group_done(&group);
+    TEST_ASSERT_EQUAL_UINT32(1u, (unsigned)thrdpool_group_pending(&group));
+    thrdpool_group_done(&group);
+    TEST_ASSERT_EQUAL_UINT32(0u, (unsigned)thrdpool_group_pending(&group));
+    thrdpool_group_wait(&group);
+}
+
+void test_group_concurrent_wait(void) {
+    pthread_t thrds[NTHREADS];
+
+    atomic_store(&nexecuted, 0u);
+    thrdpool_group_add(&group, NTHREADS * NTASKS_PER_THREAD);
+    for(unsigned i = 0u; i < NTHREADS; i++) {
+        TEST_ASSERT_EQUAL_INT32(pthread_create(&thrds[i], 0, runner, 0), 0);
+    }
+
+    thrdpool_group_wait(&group);
+    TEST_ASSERT_EQUAL_UINT32(NTHREADS * NTASKS_PER_THREAD, atomic_load(&nexecuted));
+    TEST_ASSERT_EQUAL_UINT32(0u, (unsigned)thrdpool_group_pending(&group));
+
+    for(unsigned i = 0u; i < NTHREADS; i++) {
+        TEST_ASSERT_EQUAL_INT32(pthread_join(thrds[i], 0), 0);
+    }
+}
@@ -0,0 +1,248 @@
+#include <unity.h>
+
+#include <thrdpool/thrdpool.h>
+
+#include <stdint.h>
+
+#define RANGE_SIZE 10000u
+#define NESTED_SIZE 64u
+
+static atomic_uint visited[RANGE_SIZE];
+
+void setUp(void) {
+    for(unsigned i = 0u; i < RANGE_SIZE; i++) {
+        atomic_store(&visited[i], 0u);
+    }
+}
+
+void tearDown(void) { }
+
+void visit(size_t lo, size_t hi, void *ctx) {
+    TEST_ASSERT_TRUE(lo < hi);
+    for(size_t i = lo; i < hi; i++) {
+        atomic_fetch_add(&visited[i], 1u);
+    }
+    if(ctx) {
+        atomic_fetch_add((atomic_uint *)ctx, 1u);
+    }
+}
+
+static void assert_visited(size_t begin, size_t end) {
+    for(size_t i = 0u; i < RANGE_SIZE; i++) {
+        TEST_ASSERT_EQUAL_UINT32(i >= begin && i < end, atomic_load(&visited[i]));
+    }
+}
+
+thrdpool_decl(nested_pool, 4u);
+
+static uint64_t const zero = 0u;
+
+void visit_nested(size_t lo, size_t hi, void *ctx) {
+    (void)ctx;
+    for(size_t i = lo; i < hi; i++) {
+        thrdpool_parallel_for(&nested_pool, i * NESTED_SIZE, (i + 1u) * NESTED_SIZE, 1u, visit, 0);
+    }
+}
+
+void test_parallel_for(void) {
+    struct thrdpool_attr attr = thrdpool_attr_init();
+    enum thrdpool_sched scheds[] = { THRDPOOL_SCHED_SHARED, THRDPOOL_SCHED_STEAL };
+    size_t grains[] = { 0u, 1u, 7u, RANGE_SIZE };
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        thrdpool_decl(pool, 8u);
+        attr.sched = scheds[i];
+        TEST_ASSERT_TRUE(thrdpool_init_attr(&pool, &attr));
+
+        for(unsigned j = 0u; j < thrdpool_arrsize(grains); j++) {
+            setUp();
+            thrdpool_parallel_for(&pool, 0u, RANGE_SIZE, grains[j], visit, 0);
+            assert_visited(0u, RANGE_SIZE);
+        }
+
+        TEST_ASSERT_EQUAL_UINT32(0u, (unsigned)thrdpool_pending(&pool));
+        TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+    }
+}
+
+void test_parallel_for_subrange(void) {
+    thrdpool_decl(pool, 3u);
+    TEST_ASSERT_TRUE(thrdpool_init(&pool));
+
+    thrdpool_parallel_for(&pool, 17u, 4711u, 0u, visit, 0);
+    assert_visited(17u, 4711u);
+
+    /* Empty ranges are no-ops */
+    thrdpool_parallel_for(&pool, 100u, 100u, 0u, visit, 0);
+    thrdpool_parallel_for(&pool, 100u, 50u, 0u, visit, 0);
+    assert_visited(17u, 4711u);
+
+    TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+}
+
+void test_parallel_for_grain(void) {
+    static atomic_uint nchunks;
+    thrdpool_decl(pool, 4u);
+    TEST_ASSERT_TRUE(thrdpool_init(&pool));
+
+    /* A single chunk runs on the calling thread only */
+    atomic_store(&nchunks, 0u);
+    thrdpool_parallel_for(&pool, 0u, 100u, 100u, visit, &nchunks);
+    TEST_ASSERT_EQUAL_UINT32(1u, atomic_load(&nchunks));
+    assert_visited(0u, 100u);
+
+    /* Chunks are never smaller than the grain size, except for the last one */
+    setUp();
+    atomic_store(&nchunks, 0u);
+    thrdpool_parallel_for(&pool, 0u, 1000u, 100u, visit, &nchunks);
+    TEST_ASSERT_TRUE(atomic_load(&nchunks) <= 10u);
+    assert_visited(0u, 1000u);
+
+    TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+}
+
+void test_parallel_for_nested(void) {
+    struct thrdpool_attr attr = thrdpool_attr_init();
+    enum thrdpool_sched scheds[] = { THRDPOOL_SCHED_SHARED, THRDPOOL_SCHED_STEAL };
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        setUp();
+        attr.sched = scheds[i];
+        TEST_ASSERT_TRUE(thrdpool_init_attr(&nested_pool, &attr));
+
+        thrdpool_parallel_for(&nested_pool, 0u, RANGE_SIZE / NESTED_SIZE, 1u, visit_nested, 0);
+        assert_visited(0u, (RANGE_SIZE / NESTED_SIZE) * NESTED_SIZE);
+
+        TEST_ASSERT_TRUE(thrdpool_destroy(&nested_pool));
+    }
+}
+
+struct minmax {
+    size_t min;
+    size_t max;
+    uint64_t sum;
+};
+
+void fold_sum(size_t lo, size_t hi, void *acc, void *ctx) {
+    (void)ctx;
+    for(size_t i = lo; i < hi; i++) {
+        *(uint64_t *)acc += i;
+    }
+}
+
+void combine_sum(void *acc, void const *partial, void *ctx) {
+    (void)ctx;
+    *(uint64_t *)acc += *(uint64_t const *)partial;
+}
+
+void fold_minmax(size_t lo, size_t hi, void *acc, void *ctx) {
+    struct minmax *mm = acc;
+    size_t const *values = ctx;
+    for(size_t i = lo; i < hi; i++) {
+        mm->min = values[i] < mm->min ? values[i] : mm->min;
+        mm->max = values[i] > mm->max ? values[i] : mm->max;
+        mm->sum += values[i];
+    }
+}
+
+void combine_minmax(void *acc, void const *partial, void *ctx) {
+    (void)ctx;
+    struct minmax *mm = acc;
+    struct minmax const *p = partial;
+    mm->min = p->min < mm->min ? p->min : mm->min;
+    mm->max = p->max > mm->max ? p->max : mm->max;
+    mm->sum += p->sum;
+}
+
+void fold_nested(size_t lo, size_t hi, void *acc, void *ctx) {
+    (void)ctx;
+    uint64_t sum;
+    for(size_t i = lo; i < hi; i++) {
+        sum = 0u;
+        TEST_ASSERT_TRUE(thrdpool_parallel_reduce(&nested_pool, i * NESTED_SIZE, (i + 1u) * NESTED_SIZE,
+                                                  1u, &sum, &zero, fold_sum, combine_sum, 0));
+        *(uint64_t *)acc += sum;
+    }
+}
+
+void test_parallel_reduce(void) {
+    uint64_t sum;
+    struct thrdpool_attr attr = thrdpool_attr_init();
+    enum thrdpool_sched scheds[] = { THRDPOOL_SCHED_SHARED, THRDPOOL_SCHED_STEAL };
+    size_t grains[] = { 0u, 1u, 7u, RANGE_SIZE };
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        thrdpool_decl(pool, 8u);
+        attr.sched = scheds[i];
+        TEST_ASSERT_TRUE(thrdpool_init_attr(&pool, &attr));
+
+        for(unsigned j = 0u; j < thrdpool_arrsize(grains); j++) {
+            sum = 0u;
+            TEST_ASSERT_TRUE(thrdpool_parallel_reduce(&pool, 0u, RANGE_SIZE, grains[j], &sum, &zero, fold_sum, combine_sum, 0));
+            TEST_ASSERT_EQUAL_UINT64((uint64_t)RANGE_SIZE * (RANGE_SIZE - 1u) / 2u, sum);
+
+            /* The initial value is counted once however many threads take part */
+            sum = 17u;
+            TEST_ASSERT_TRUE(thrdpool_parallel_reduce(&pool, 0u, RANGE_SIZE, grains[j], &sum, &zero, fold_sum, combine_sum, 0));
+            TEST_ASSERT_EQUAL_UINT64((uint64_t)RANGE_SIZE * (RANGE_SIZE - 1u) / 2u + 17u, sum);
+        }
+
+        /* An empty range leaves the result untouched */
+        sum = 17u;
+        TEST_ASSERT_TRUE(thrdpool_parallel_reduce(&pool, 10u, 10u, 0u, &sum, &zero, fold_sum, combine_sum, 0));
+        TEST_ASSERT_EQUAL_UINT64(17u, sum);
+
+        TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+    }
+}
+
+void test_parallel_reduce_struct(void) {
+    static size_t values[RANGE_SIZE];
+    struct minmax const identity = { .min = SIZE_MAX, .max = 0u, .sum = 0u };
+    struct minmax mm = identity;
+    uint64_t sum = 0u;
+
+    for(size_t i = 0u; i < RANGE_SIZE; i++) {
+        values[i] = (i * 7919u) % RANGE_SIZE + 3u;
+        sum += values[i];
+    }
+
+    thrdpool_decl(pool, 4u);
+    TEST_ASSERT_TRUE(thrdpool_init(&pool));
+
+    TEST_ASSERT_TRUE(thrdpool_parallel_reduce(&pool, 0u, RANGE_SIZE, 0u, &mm, &identity, fold_minmax, combine_minmax, values));
+    TEST_ASSERT_EQUAL_UINT32(3u, (unsigned)mm.min);
+    TEST_ASSERT_EQUAL_UINT32(RANGE_SIZE + 2u, (unsigned)mm.max);
+    TEST_ASSERT_EQUAL_UINT64(sum, mm.sum);
+
+    TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+}
+
+void test_parallel_reduce_too_large(void) {
+    unsigned char const identity[THRDPOOL_REDUCE_SIZE + 1u] = { 0u };
+    unsigned char acc[THRDPOOL_REDUCE_SIZE + 1u] = { 0u };
+
+    thrdpool_decl(pool, 2u);
+    TEST_ASSERT_TRUE(thrdpool_init(&pool));
+    TEST_ASSERT_FALSE(thrdpool_parallel_reduce(&pool, 0u, RANGE_SIZE, 0u, &acc, &identity, fold_sum, combine_sum, 0));
+    TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+}
+
+void test_parallel_reduce_nested(void) {
+    uint64_t sum;
+    struct thrdpool_attr attr = thrdpool_attr_init();
+    enum thrdpool_sched scheds[] = { THRDPOOL_SCHED_SHARED, THRDPOOL_SCHED_STEAL };
+    size_t n = (RANGE_SIZE / NESTED_SIZE) * NESTED_SIZE;
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        attr.sched = scheds[i];
+        TEST_ASSERT_TRUE(thrdpool_init_attr(&nested_pool, &attr));
+
+        sum = 0u;
+        TEST_ASSERT_TRUE(thrdpool_parallel_reduce(&nested_pool, 0u, RANGE_SIZE / NESTED_SIZE, 1u, &sum, &zero,
+                                                  fold_nested, combine_sum, 0));
+        TEST_ASSERT_EQUAL_UINT64((uint64_t)n * (n - 1u) / 2u, sum);
+
+        TEST_ASSERT_TRUE(thrdpool_destroy(&nested_pool));
+    }
+}
@@ -0,0 +1,199 @@
+#include <unity.h>
+
+#include <thrdpool/thrdpool.h>
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define FIB_N 18u
+#define FIB_RESULT 2584u
+#define NELEMS 4096u
+#define SORT_CUTOFF 16u
+#define TREE_DEPTH 8u
+#define TREE_NODES ((1u << (TREE_DEPTH + 1u)) - 1u)
+#define TREE_ROUNDS 64u
+
+struct fib {
+    unsigned n;
+    uint64_t result;
+};
+
+struct sort {
+    unsigned *elems;
+    size_t nelems;
+};
+
+static unsigned elems[NELEMS];
+/* Times each node of the tree was entered and left, numbered as in a binary heap */
+static atomic_uint entered[TREE_NODES];
+static atomic_uint left[TREE_NODES];
+
+thrdpool_decl(pool, 2u);
+
+static enum thrdpool_sched const scheds[] = { THRDPOOL_SCHED_SHARED, THRDPOOL_SCHED_STEAL };
+
+void setUp(void) { }
+void tearDown(void) { }
+
+static void init_pool(enum thrdpool_sched sched, unsigned nextlimit) {
+    struct thrdpool_attr attr = thrdpool_attr_init();
+    attr.sched = sched;
+    attr.nextlimit = nextlimit;
+    TEST_ASSERT_TRUE(thrdpool_init_impl(&pool.d_pool, 2u, &attr));
+}
+
+/* Waits at every level, far deeper than there are workers */
+void fib(void *arg) {
+    struct fib *f = arg;
+    struct fib a = { .n = f->n - 1u };
+    struct fib b = { .n = f->n - 2u };
+    struct thrdpool_group group;
+
+    if(f->n < 2u) {
+        f->result = f->n;
+        return;
+    }
+
+    TEST_ASSERT_TRUE(thrdpool_group_init(&group));
+    TEST_ASSERT_TRUE(thrdpool_spawn(&pool, &group, fib, &a));
+    fib(&b);
+    thrdpool_sync(&pool, &group);
+    TEST_ASSERT_TRUE(thrdpool_group_destroy(&group));
+    f->result = a.result + b.result;
+}
+
+void quicksort(void *arg) {
+    struct sort *s = arg;
+    struct sort lo;
+    struct sort hi;
+    struct thrdpool_group group;
+    unsigned pivot;
+    unsigned tmp;
+    size_t i = 0u;
+
+    if(s->nelems < SORT_CUTOFF) {
+        for(size_t j = 1u; j < s->nelems; j++) {
+            tmp = s->elems[j];
+            for(i = j; i && s->elems[i - 1u] > tmp; i--) {
+                s->elems[i] = s->elems[i - 1u];
+            }
+            s->elems[i] = tmp;
+        }
+        return;
+    }
+
+    pivot = s->elems[s->nelems / 2u];
+    s->elems[s->nelems / 2u] = s->elems[s->nelems - 1u];
+    s->elems[s->nelems - 1u] = pivot;
+    for(size_t j = 0u; j + 1u < s->nelems; j++) {
+        if(s->elems[j] < pivot) {
+            tmp = s->elems[i];
+            s->elems[i++] = s->elems[j];
+            s->elems[j] = tmp;
+        }
+    }
+    s->elems[s->nelems - 1u] = s->elems[i];
+    s->elems[i] = pivot;
+
+    lo = (struct sort) { .elems = s->elems, .nelems = i };
+    hi = (struct sort) { .elems = s->elems + i + 1u, .nelems = s->nelems - i - 1u };
+
+    TEST_ASSERT_TRUE(thrdpool_group_init(&group));
+    TEST_ASSERT_TRUE(thrdpool_spawn(&pool, &group, quicksort, &lo));
+    quicksort(&hi);
+    thrdpool_sync(&pool, &group);
+    TEST_ASSERT_TRUE(thrdpool_group_destroy(&group));
+}
+
+/* Spawns the left subtree and walks the right one inline. Every child must have run to
+ * completion exactly once by the time sync returns, and never again after */
+void tree(void *arg) {
+    size_t node = (size_t)(uintptr_t)arg;
+    size_t lchild = 2u * node + 1u;
+    struct thrdpool_group group;
+
+    TEST_ASSERT_EQUAL_UINT32(1u, atomic_fetch_add(&entered[node], 1u) + 1u);
+    if(lchild < TREE_NODES) {
+        TEST_ASSERT_TRUE(thrdpool_group_init(&group));
+        TEST_ASSERT_TRUE(thrdpool_spawn(&pool, &group, tree, (void *)(uintptr_t)lchild));
+        tree((void *)(uintptr_t)(lchild + 1u));
+        thrdpool_sync(&pool, &group);
+        TEST_ASSERT_EQUAL_UINT32(1u, atomic_load(&left[lchild]));
+        TEST_ASSERT_TRUE(thrdpool_group_destroy(&group));
+    }
+    atomic_fetch_add(&left[node], 1u);
+}
+
+void test_spawn_fib(void) {
+    struct thrdpool_group group;
+    struct fib f = { .n = FIB_N };
+    unsigned const nextlimits[] = { THRDPOOL_NEXT_LIMIT, 0u };
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        for(unsigned j = 0u; j < thrdpool_arrsize(nextlimits); j++) {
+            init_pool(scheds[i], nextlimits[j]);
+            TEST_ASSERT_TRUE(thrdpool_group_init(&group));
+
+            f.result = 0u;
+            TEST_ASSERT_TRUE(thrdpool_spawn(&pool, &group, fib, &f));
+            thrdpool_sync(&pool, &group);
+            TEST_ASSERT_EQUAL_UINT64(FIB_RESULT, f.result);
+
+            TEST_ASSERT_TRUE(thrdpool_group_destroy(&group));
+            TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+        }
+    }
+}
+
+void test_spawn_quicksort(void) {
+    struct thrdpool_group group;
+    struct sort s = { .elems = elems, .nelems = NELEMS };
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        init_pool(scheds[i], THRDPOOL_NEXT_LIMIT);
+        TEST_ASSERT_TRUE(thrdpool_group_init(&group));
+        srand(i);
+        for(unsigned j = 0u; j < NELEMS; j++) {
+            elems[j] = (unsigned)rand();
+        }
+
+        TEST_ASSERT_TRUE(thrdpool_spawn(&pool, &group, quicksort, &s));
+        thrdpool_sync(&pool, &group);
+        for(unsigned j = 1u; j < NELEMS; j++) {
+            TEST_ASSERT_TRUE(elems[j - 1u] <= elems[j]);
+        }
+
+        TEST_ASSERT_TRUE(thrdpool_group_destroy(&group));
+        TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+    }
+}
+
+void test_spawn_stress(void) {
+    struct thrdpool_group group;
+    unsigned const nextlimits[] = { THRDPOOL_NEXT_LIMIT, 1u, 0u };
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        for(unsigned j = 0u; j < thrdpool_arrsize(nextlimits); j++) {
+            init_pool(scheds[i], nextlimits[j]);
+            for(unsigned k = 0u; k < TREE_ROUNDS; k++) {
+                for(unsigned l = 0u; l < TREE_NODES; l++) {
+                    atomic_store(&entered[l], 0u);
+                    atomic_store(&left[l], 0u);
+                }
+
+                TEST_ASSERT_TRUE(thrdpool_group_init(&group));
+                TEST_ASSERT_TRUE(thrdpool_spawn(&pool, &group, tree, (void *)(uintptr_t)0u));
+                thrdpool_sync(&pool, &group);
+                TEST_ASSERT_TRUE(thrdpool_group_destroy(&group));
+                TEST_ASSERT_EQUAL_UINT32(1u, atomic_load(&left[0]));
+            }
+            /* A task run twice would show up once all workers are done */
+            TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+            for(unsigned l = 0u; l < TREE_NODES; l++) {
+                TEST_ASSERT_EQUAL_UINT32(1u, atomic_load(&entered[l]));
+                TEST_ASSERT_EQUAL_UINT32(1u, atomic_load(&left[l]));
+            }
+        }
+    }
+}
@@ -0,0 +1,207 @@
+#include <unity.h>
+
+#include <thrdpool/thrdpool.h>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+
+struct blockargs {
+    pthread_mutex_t lock;
+    pthread_cond_t cv;
+    unsigned value;
+};
+
+void task_nop(void *arg) {
+    (void)arg;
+}
+
+void task_block(void *args) {
+    struct blockargs *ba = args;
+
+    pthread_mutex_lock(&ba->lock);
+    ++ba->value;
+    pthread_cond_signal(&ba->cv);
+    /* Hold the worker until released by the main thread */
+    while(ba->value < 2u) {
+        pthread_cond_wait(&ba->cv, &ba->lock);
+    }
+    pthread_mutex_unlock(&ba->lock);
+}
+
+static uint64_t hist_sum(uint64_t const *hist) {
+    uint64_t sum = 0u;
+    for(unsigned i = 0u; i < THRDPOOL_STATS_BUCKETS; i++) {
+        sum += hist[i];
+    }
+    return sum;
+}
+
+void test_stats_bucket(void) {
+    TEST_ASSERT_EQUAL_UINT32(0u, (unsigned)thrdpool_stats_bucket(0u));
+    TEST_ASSERT_EQUAL_UINT32(0u, (unsigned)thrdpool_stats_bucket(1u));
+    TEST_ASSERT_EQUAL_UINT32(1u, (unsigned)thrdpool_stats_bucket(2u));
+    TEST_ASSERT_EQUAL_UINT32(1u, (unsigned)thrdpool_stats_bucket(3u));
+    TEST_ASSERT_EQUAL_UINT32(10u, (unsigned)thrdpool_stats_bucket(1024u));
+    TEST_ASSERT_EQUAL_UINT32(10u, (unsigned)thrdpool_stats_bucket(2047u));
+    TEST_ASSERT_EQUAL_UINT32(THRDPOOL_STATS_BUCKETS - 1u, (unsigned)thrdpool_stats_bucket(UINT64_MAX));
+}
+
+void test_stats_quantile(void) {
+    uint64_t hist[THRDPOOL_STATS_BUCKETS] = { 0u };
+    TEST_ASSERT_EQUAL_UINT64(0u, thrdpool_stats_quantile(hist, 0.5));
+
+    /* 90 samples in [8, 16) ns, 10 in [1024, 2048) ns */
+    hist[3] = 90u;
+    hist[10] = 10u;
+    TEST_ASSERT_EQUAL_UINT64(15u, thrdpool_stats_quantile(hist, 0.0));
+    TEST_ASSERT_EQUAL_UINT64(15u, thrdpool_stats_quantile(hist, 0.5));
+    TEST_ASSERT_EQUAL_UINT64(15u, thrdpool_stats_quantile(hist, 0.9));
+    TEST_ASSERT_EQUAL_UINT64(2047u, thrdpool_stats_quantile(hist, 0.99));
+    TEST_ASSERT_EQUAL_UINT64(2047u, thrdpool_stats_quantile(hist, 1.0));
+
+    hist[THRDPOOL_STATS_BUCKETS - 1u] = 1u;
+    TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, thrdpool_stats_quantile(hist, 1.0));
+}
+
+void test_stats_disabled(void) {
+#ifdef THRDPOOL_STATS
+    TEST_IGNORE();
+#else
+    struct thrdpool_stats stats;
+    thrdpool_decl(pool, 1u);
+    TEST_ASSERT_TRUE(thrdpool_init(&pool));
+
+    TEST_ASSERT_FALSE(thrdpool_stats(&pool, &stats));
+    TEST_ASSERT_EQUAL_UINT64(0u, stats.executed);
+    TEST_ASSERT_FALSE(thrdpool_worker_stats(&pool, 0u, &stats));
+    TEST_ASSERT_EQUAL_UINT64(0u, hist_sum(stats.run));
+
+    TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+#endif
+}
+
+void test_stats_executed(void) {
+#ifndef THRDPOOL_STATS
+    TEST_IGNORE();
+#else
+    struct thrdpool_group group;
+    struct thrdpool_stats stats;
+    struct thrdpool_stats wstats;
+    struct thrdpool_attr attr = thrdpool_attr_init();
+    enum thrdpool_sched scheds[] = { THRDPOOL_SCHED_SHARED, THRDPOOL_SCHED_STEAL };
+    uint64_t executed;
+    uint64_t steals;
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        thrdpool_decl(pool, 4u);
+        unsigned ntasks = 4u * (unsigned)thrdpool_taskq_capacity(&pool);
+        attr.sched = scheds[i];
+        TEST_ASSERT_TRUE(thrdpool_group_init(&group));
+        TEST_ASSERT_TRUE(thrdpool_init_attr(&pool, &attr));
+
+        TEST_ASSERT_TRUE(thrdpool_stats(&pool, &stats));
+        TEST_ASSERT_EQUAL_UINT64(0u, stats.executed);
+
+        for(unsigned j = 0u; j < ntasks; j++) {
+            TEST_ASSERT_TRUE(thrdpool_schedule_group_wait(&pool, &group, task_nop, 0));
+        }
+        thrdpool_group_wait(&group);
+
+        /* Counters are updated before the group is notified */
+        TEST_ASSERT_TRUE(thrdpool_stats(&pool, &stats));
+        TEST_ASSERT_EQUAL_UINT64(ntasks, stats.executed);
+        TEST_ASSERT_EQUAL_UINT64(ntasks, hist_sum(stats.wait));
+        TEST_ASSERT_EQUAL_UINT64(ntasks, hist_sum(stats.run));
+        if(scheds[i] == THRDPOOL_SCHED_SHARED) {
+            TEST_ASSERT_EQUAL_UINT64(0u, stats.steals);
+        }
+
+        executed = 0u;
+        steals = 0u;
+        for(unsigned j = 0u; j < thrdpool_size(&pool); j++) {
+            TEST_ASSERT_TRUE(thrdpool_worker_stats(&pool, j, &wstats));
+            TEST_ASSERT_EQUAL_UINT64(wstats.executed, hist_sum(wstats.run));
+            TEST_ASSERT_EQUAL_UINT64(0u, wstats.rejected);
+            executed += wstats.executed;
+            steals += wstats.steals;
+        }
+        TEST_ASSERT_EQUAL_UINT64(ntasks, executed);
+        TEST_ASSERT_EQUAL_UINT64(stats.steals, steals);
+        TEST_ASSERT_FALSE(thrdpool_worker_stats(&pool, thrdpool_size(&pool), &wstats));
+
+        TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+        TEST_ASSERT_TRUE(thrdpool_group_destroy(&group));
+    }
+#endif
+}
+
+void test_stats_rejected(void) {
+#ifndef THRDPOOL_STATS
+    TEST_IGNORE();
+#else
+    struct thrdpool_stats stats;
+    static struct blockargs args;
+    TEST_ASSERT_EQUAL_INT32(pthread_mutex_init(&args.lock, 0), 0);
+    TEST_ASSERT_EQUAL_INT32(pthread_cond_init(&args.cv, 0), 0);
+    args.value = 0u;
+
+    thrdpool_decl(pool, 1u);
+    TEST_ASSERT_TRUE(thrdpool_init(&pool));
+
+    /* Keep the only worker busy */
+    pthread_mutex_lock(&args.lock);
+    TEST_ASSERT_TRUE(thrdpool_schedule(&pool, task_block, &args));
+    while(args.value < 1u) {
+        pthread_cond_wait(&args.cv, &args.lock);
+    }
+    pthread_mutex_unlock(&args.lock);
+
+    for(unsigned i = 0u; i < thrdpool_taskq_capacity(&pool); i++) {
+        TEST_ASSERT_TRUE(thrdpool_schedule(&pool, task_nop, 0));
+    }
+    TEST_ASSERT_FALSE(thrdpool_schedule(&pool, task_nop, 0));
+    TEST_ASSERT_FALSE(thrdpool_schedule(&pool, task_nop, 0));
+
+    TEST_ASSERT_TRUE(thrdpool_stats(&pool, &stats));
+    TEST_ASSERT_EQUAL_UINT64(2u, stats.rejected);
+
+    pthread_mutex_lock(&args.lock);
+    ++args.value;
+    pthread_mutex_unlock(&args.lock);
+    pthread_cond_signal(&args.cv);
+
+    TEST_ASSERT_TRUE(thrdpool_wait_idle(&pool));
+    TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+    TEST_ASSERT_EQUAL_INT32(pthread_mutex_destroy(&args.lock), 0);
+    TEST_ASSERT_EQUAL_INT32(pthread_cond_destroy(&args.cv), 0);
+#endif
+}
+
+void test_stats_idle(void) {
+#ifndef THRDPOOL_STATS
+    TEST_IGNORE();
+#else
+    struct thrdpool_group group;
+    struct thrdpool_stats stats;
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = 2000000 };
+
+    thrdpool_decl(pool, 1u);
+    TEST_ASSERT_TRUE(thrdpool_group_init(&group));
+    TEST_ASSERT_TRUE(thrdpool_init(&pool));
+
+    TEST_ASSERT_TRUE(thrdpool_wait_idle(&pool));
+    nanosleep(&ts, 0);
+
+    /* Idle time is accounted for once the worker wakes up */
+    TEST_ASSERT_TRUE(thrdpool_schedule_group(&pool, &group, task_nop, 0));
+    thrdpool_group_wait(&group);
+
+    TEST_ASSERT_TRUE(thrdpool_stats(&pool, &stats));
+    TEST_ASSERT_TRUE(stats.idle_ns >= 1000000u);
+    TEST_ASSERT_EQUAL_UINT64(1u, stats.executed);
+
+    TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+    TEST_ASSERT_TRUE(thrdpool_group_destroy(&group));
+#endif
+}
@@ -0,0 +1,259 @@
+#include <unity.h>
+
+#include <thrdpool/thrdpool.h>
+
+#include <pthread.h>
+#include <sched.h>
+
+#define NSTRANDS 8u
+#define NPOSTS 256u
+#define CAPACITY 4u
+
+struct post {
+    unsigned strand;
+    unsigned seq;
+};
+
+static thrdpool_strand_decl(strands[NSTRANDS], NPOSTS);
+static thrdpool_strand_decl(small, CAPACITY);
+static struct post posts[NSTRANDS][NPOSTS];
+static atomic_uint next[NSTRANDS];
+static atomic_bool busy[NSTRANDS];
+static atomic_uint nran;
+static atomic_uint overtaken;
+static atomic_bool release;
+static atomic_bool blocked;
+static struct thrdpool_group group;
+
+thrdpool_decl(pool, 4u);
+
+static enum thrdpool_sched const scheds[] = { THRDPOOL_SCHED_SHARED, THRDPOOL_SCHED_STEAL };
+
+void setUp(void) {
+    for(unsigned i = 0u; i < NSTRANDS; i++) {
+        atomic_store(&next[i], 0u);
+        atomic_store(&busy[i], false);
+    }
+    atomic_store(&nran, 0u);
+    atomic_store(&overtaken, 0u);
+    atomic_store(&release, false);
+    atomic_store(&blocked, false);
+}
+
+void tearDown(void) { }
+
+static void init_pool(enum thrdpool_sched sched, size_t nworkers) {
+    struct thrdpool_attr attr = thrdpool_attr_init();
+    attr.sched = sched;
+    TEST_ASSERT_TRUE(thrdpool_init_impl(&pool.d_pool, nworkers, &attr));
+}
+
+void ordered(void *arg) {
+    struct post *post = arg;
+
+    /* Never runs alongside another task of the same strand */
+    TEST_ASSERT_FALSE(atomic_exchange(&busy[post->strand], true));
+    TEST_ASSERT_EQUAL_UINT32(post->seq, atomic_load(&next[post->strand]));
+    atomic_store(&next[post->strand], post->seq + 1u);
+    atomic_store(&busy[post->strand], false);
+}
+
+void block(void *arg) {
+    (void)arg;
+    atomic_store(&blocked, true);
+    while(!atomic_load(&release)) {
+        sched_yield();
+    }
+}
+
+void count(void *arg) {
+    (void)arg;
+    atomic_fetch_add(&nran, 1u);
+}
+
+void *post_blocked(void *arg) {
+    /* Waits for room in the full queue of the pool until it is destroyed */
+    atomic_store((atomic_bool *)arg, thrdpool_strand_post_group(&pool, &small, &group, count, 0));
+    return 0;
+}
+
+void *wait_idle(void *arg) {
+    (void)arg;
+    /* The held worker keeps the pool busy until it is destroyed */
+    TEST_ASSERT_TRUE(thrdpool_wait_idle(&pool));
+    return 0;
+}
+
+void *destroy_pool(void *arg) {
+    atomic_store((atomic_bool *)arg, thrdpool_destroy(&pool));
+    return 0;
+}
+
+void overtake(void *arg) {
+    (void)arg;
+    atomic_store(&overtaken, atomic_load(&nran) + 1u);
+}
+
+void test_strand_order(void) {
+    for(unsigned i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        setUp();
+        init_pool(scheds[i], 4u);
+        TEST_ASSERT_TRUE(thrdpool_group_init(&group));
+        for(unsigned j = 0u; j < NSTRANDS; j++) {
+            TEST_ASSERT_TRUE(thrdpool_strand_init(&strands[j]));
+        }
+
+        /* Interleaved so that every strand is active at once */
+        for(unsigned j = 0u; j < NPOSTS; j++) {
+            for(unsigned k = 0u; k < NSTRANDS; k++) {
+                posts[k][j] = (struct post) { .strand = k, .seq = j };
+                TEST_ASSERT_TRUE(thrdpool_strand_post_group(&pool, &strands[k], &group, ordered, &posts[k][j]));
+            }
+        }
+        thrdpool_group_wait(&group);
+
+        for(unsigned j = 0u; j < NSTRANDS; j++) {
+            TEST_ASSERT_EQUAL_UINT32(NPOSTS, atomic_load(&next[j]));
+            TEST_ASSERT_EQUAL_UINT64(0u, thrdpool_strand_pending(&strands[j]));
+        }
+        TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+        for(unsigned j = 0u; j < NSTRANDS; j++) {
+            TEST_ASSERT_TRUE(thrdpool_strand_destroy(&strands[j]));
+        }
+        TEST_ASSERT_TRUE(thrdpool_group_destroy(&group));
+    }
+}
+
+void test_strand_single_slot(void) {
+    init_pool(THRDPOOL_SCHED_SHARED, 1u);
+    TEST_ASSERT_TRUE(thrdpool_group_init(&group));
+    TEST_ASSERT_TRUE(thrdpool_strand_init(&small));
+
+    TEST_ASSERT_TRUE(thrdpool_strand_post_group(&pool, &small, &group, block, 0));
+    while(!atomic_load(&blocked)) {
+        sched_yield();
+    }
+
+    /* The strand's task is running, those posted meanwhile wait in the strand */
+    for(unsigned i = 0u; i < CAPACITY; i++) {
+        TEST_ASSERT_TRUE(thrdpool_strand_post_group(&pool, &small, &group, count, 0));
+    }
+    TEST_ASSERT_FALSE(thrdpool_strand_post_group(&pool, &small, &group, count, 0));
+    TEST_ASSERT_EQUAL_UINT64(CAPACITY, thrdpool_strand_pending(&small));
+    TEST_ASSERT_EQUAL_UINT64(0u, thrdpool_pending(&pool));
+    TEST_ASSERT_FALSE(thrdpool_strand_destroy(&small));
+
+    atomic_store(&release, true);
+    thrdpool_group_wait(&group);
+    TEST_ASSERT_EQUAL_UINT32(CAPACITY, atomic_load(&nran));
+
+    TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+    TEST_ASSERT_TRUE(thrdpool_strand_destroy(&small));
+    TEST_ASSERT_TRUE(thrdpool_group_destroy(&group));
+}
+
+void test_strand_batch(void) {
+    for(unsigned i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        setUp();
+        init_pool(scheds[i], 1u);
+        TEST_ASSERT_TRUE(thrdpool_group_init(&group));
+        TEST_ASSERT_TRUE(thrdpool_strand_init(&strands[0]));
+
+        TEST_ASSERT_TRUE(thrdpool_schedule_group_wait(&pool, &group, block, 0));
+        while(!atomic_load(&blocked)) {
+            sched_yield();
+        }
+        for(unsigned j = 0u; j < NPOSTS; j++) {
+            TEST_ASSERT_TRUE(thrdpool_strand_post_group(&pool, &strands[0], &group, count, 0));
+        }
+        /* The strand occupies a single slot in the queue however many tasks it holds */
+        TEST_ASSERT_EQUAL_UINT64(1u, thrdpool_pending(&pool));
+        TEST_ASSERT_TRUE(thrdpool_schedule_group_wait(&pool, &group, overtake, 0));
+        atomic_store(&release, true);
+        thrdpool_group_wait(&group);
+
+        /* The strand went to the back of the queue after its first batch */
+        TEST_ASSERT_EQUAL_UINT32(NPOSTS, atomic_load(&nran));
+        TEST_ASSERT_EQUAL_UINT32(THRDPOOL_STRAND_BATCH + 1u, atomic_load(&overtaken));
+
+        TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+        TEST_ASSERT_TRUE(thrdpool_strand_destroy(&strands[0]));
+        TEST_ASSERT_TRUE(thrdpool_group_destroy(&group));
+    }
+}
+
+void test_strand_post_destroyed(void) {
+    pthread_t poster;
+    pthread_t destroyer;
+    atomic_bool posted = true;
+    atomic_bool destroyed = false;
+
+    init_pool(THRDPOOL_SCHED_SHARED, 1u);
+    TEST_ASSERT_TRUE(thrdpool_group_init(&group));
+    TEST_ASSERT_TRUE(thrdpool_strand_init(&small));
+
+    TEST_ASSERT_TRUE(thrdpool_schedule(&pool, block, 0));
+    while(!atomic_load(&blocked)) {
+        sched_yield();
+    }
+    while(thrdpool_schedule(&pool, count, 0));
+
+    /* The first post blocks scheduling the draining task, later ones are accepted */
+    TEST_ASSERT_EQUAL_INT32(0, pthread_create(&poster, 0, post_blocked, &posted));
+    while(!thrdpool_strand_pending(&small)) {
+        sched_yield();
+    }
+    TEST_ASSERT_TRUE(thrdpool_strand_post_group(&pool, &small, &group, count, 0));
+    TEST_ASSERT_TRUE(thrdpool_strand_post_group(&pool, &small, &group, count, 0));
+
+    TEST_ASSERT_EQUAL_INT32(0, pthread_create(&destroyer, 0, destroy_pool, &destroyed));
+    TEST_ASSERT_EQUAL_INT32(0, pthread_join(poster, 0));
+    TEST_ASSERT_FALSE(atomic_load(&posted));
+
+    /* None of the tasks run, yet their groups are done and the strand is idle */
+    thrdpool_group_wait(&group);
+    TEST_ASSERT_EQUAL_UINT64(0u, thrdpool_strand_pending(&small));
+    TEST_ASSERT_TRUE(thrdpool_strand_destroy(&small));
+
+    atomic_store(&release, true);
+    TEST_ASSERT_EQUAL_INT32(0, pthread_join(destroyer, 0));
+    TEST_ASSERT_TRUE(atomic_load(&destroyed));
+    TEST_ASSERT_EQUAL_UINT32(0u, atomic_load(&nran));
+    TEST_ASSERT_TRUE(thrdpool_group_destroy(&group));
+}
+
+void test_strand_destroy_pending(void) {
+    pthread_t waiter;
+    pthread_t destroyer;
+    atomic_bool destroyed = false;
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        setUp();
+        init_pool(scheds[i], 1u);
+        TEST_ASSERT_TRUE(thrdpool_group_init(&group));
+        TEST_ASSERT_TRUE(thrdpool_strand_init(&small));
+
+        TEST_ASSERT_TRUE(thrdpool_schedule(&pool, block, 0));
+        while(!atomic_load(&blocked)) {
+            sched_yield();
+        }
+        /* The draining task waits in the queue behind the held worker */
+        for(unsigned j = 0u; j < CAPACITY; j++) {
+            TEST_ASSERT_TRUE(thrdpool_strand_post_group(&pool, &small, &group, count, 0));
+        }
+
+        TEST_ASSERT_EQUAL_INT32(0, pthread_create(&waiter, 0, wait_idle, 0));
+        TEST_ASSERT_EQUAL_INT32(0, pthread_create(&destroyer, 0, destroy_pool, &destroyed));
+        TEST_ASSERT_EQUAL_INT32(0, pthread_join(waiter, 0));
+        atomic_store(&release, true);
+        TEST_ASSERT_EQUAL_INT32(0, pthread_join(destroyer, 0));
+        TEST_ASSERT_TRUE(atomic_load(&destroyed));
+
+        /* Discarded along with the draining task, the strand is left idle */
+        thrdpool_group_wait(&group);
+        TEST_ASSERT_EQUAL_UINT32(0u, atomic_load(&nran));
+        TEST_ASSERT_EQUAL_UINT64(0u, thrdpool_strand_pending(&small));
+        TEST_ASSERT_TRUE(thrdpool_strand_destroy(&small));
+        TEST_ASSERT_TRUE(thrdpool_group_destroy(&group));
+    }
+}
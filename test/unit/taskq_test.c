@@ -1,6 +1,13 @@
 #include <unity.h>
 #include <thrdpool/taskq.h>
 
+#include <pthread.h>
+#include <stdint.h>
+
+#define NPRODUCERS 2u
+#define NCONSUMERS 2u
+#define NTASKS_PER_PRODUCER 4096u
+
 static unsigned gval = 32;
 
 void inc(void *args) {
@@ -9,6 +16,10 @@ void inc(void *args) {
     }
 }
 
+void mark(void *args) {
+    ++*(unsigned *)args;
+}
+
 void zero(void *args) {
     if(args) {
         *(unsigned *)args = 0u;
@@ -63,7 +74,7 @@ void test_taskq_wrap(void) {
 
     struct thrdpool_taskq q = thrdpool_taskq_init();
 
-    for(unsigned i = 0; i < thrdpool_arrsize(q.tasks); i++) {
+    for(unsigned i = 0; i < THRDPOOL_TASKQ_CAPACITY; i++) {
         TEST_ASSERT_TRUE(thrdpool_taskq_push(&q, inc, &value));
     }
     TEST_ASSERT_FALSE(thrdpool_taskq_push(&q, zero, &value));
@@ -75,7 +86,7 @@ void test_taskq_wrap(void) {
 
     struct thrdpool_task *task;
 
-    for(unsigned i = 0; i < thrdpool_arrsize(q.tasks) - 2u; i++) {
+    for(unsigned i = 0; i < THRDPOOL_TASKQ_CAPACITY - 2u; i++) {
         task = thrdpool_taskq_front(&q);
         thrdpool_call(task);
         TEST_ASSERT_EQUAL_UINT32(value, gval);
@@ -107,3 +118,272 @@ void test_taskq_pop_back(void) {
     thrdpool_call(task);
     TEST_ASSERT_EQUAL_UINT32(value, gval);
 }
+
+void test_taskq_pop(void) {
+    unsigned value = 0u;
+    struct thrdpool_task task;
+    struct thrdpool_taskq q = thrdpool_taskq_init();
+
+    TEST_ASSERT_FALSE(thrdpool_taskq_pop(&q, &task));
+    TEST_ASSERT_TRUE(thrdpool_taskq_push(&q, zero, &value));
+    TEST_ASSERT_TRUE(thrdpool_taskq_push(&q, inc, &value));
+
+    TEST_ASSERT_TRUE(thrdpool_taskq_pop(&q, &task));
+    TEST_ASSERT_TRUE(task.handle == zero);
+    TEST_ASSERT_EQUAL_UINT32((unsigned)thrdpool_taskq_size(&q), 1u);
+
+    TEST_ASSERT_TRUE(thrdpool_taskq_pop(&q, &task));
+    TEST_ASSERT_TRUE(task.handle == inc);
+    TEST_ASSERT_FALSE(thrdpool_taskq_pop(&q, &task));
+    TEST_ASSERT_EQUAL_UINT32((unsigned)thrdpool_taskq_size(&q), 0u);
+}
+
+void test_taskq_clear(void) {
+    struct thrdpool_task task;
+    struct thrdpool_taskq q = thrdpool_taskq_init();
+
+    for(unsigned i = 0; i < THRDPOOL_TASKQ_CAPACITY; i++) {
+        TEST_ASSERT_TRUE(thrdpool_taskq_push(&q, inc, 0));
+    }
+    thrdpool_taskq_clear(&q);
+    TEST_ASSERT_EQUAL_UINT32((unsigned)thrdpool_taskq_size(&q), 0u);
+    TEST_ASSERT_FALSE(thrdpool_taskq_pop(&q, &task));
+    TEST_ASSERT_TRUE(thrdpool_taskq_push(&q, inc, 0));
+}
+
+void test_taskq_push_batch(void) {
+    unsigned value = 0u;
+    struct thrdpool_task task;
+    struct thrdpool_task tasks[THRDPOOL_TASKQ_CAPACITY + 2u];
+    struct thrdpool_taskq q = thrdpool_taskq_init();
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(tasks); i++) {
+        tasks[i] = (struct thrdpool_task) { .handle = i & 1u ? zero : inc, .args = &value };
+    }
+
+    TEST_ASSERT_EQUAL_UINT32((unsigned)thrdpool_taskq_push_batch(&q, tasks, 3u), 3u);
+    TEST_ASSERT_EQUAL_UINT32((unsigned)thrdpool_taskq_size(&q), 3u);
+
+    /* Only the remaining capacity is accepted */
+    TEST_ASSERT_EQUAL_UINT32((unsigned)thrdpool_taskq_push_batch(&q, tasks, thrdpool_arrsize(tasks)),
+                             THRDPOOL_TASKQ_CAPACITY - 3u);
+    TEST_ASSERT_EQUAL_UINT32((unsigned)thrdpool_taskq_size(&q), THRDPOOL_TASKQ_CAPACITY);
+    TEST_ASSERT_EQUAL_UINT32((unsigned)thrdpool_taskq_push_batch(&q, tasks, 1u), 0u);
+
+    for(unsigned i = 0u; i < 3u; i++) {
+        TEST_ASSERT_TRUE(thrdpool_taskq_pop(&q, &task));
+        TEST_ASSERT_TRUE(task.handle == tasks[i].handle);
+    }
+    for(unsigned i = 0u; i < THRDPOOL_TASKQ_CAPACITY - 3u; i++) {
+        TEST_ASSERT_TRUE(thrdpool_taskq_pop(&q, &task));
+        TEST_ASSERT_TRUE(task.handle == tasks[i].handle);
+    }
+    TEST_ASSERT_FALSE(thrdpool_taskq_pop(&q, &task));
+
+    /* Wrap around */
+    TEST_ASSERT_EQUAL_UINT32((unsigned)thrdpool_taskq_push_batch(&q, tasks, 5u), 5u);
+    TEST_ASSERT_EQUAL_UINT32((unsigned)thrdpool_taskq_size(&q), 5u);
+}
+
+void test_taskq_pop_batch(void) {
+    unsigned value = 0u;
+    struct thrdpool_task tasks[THRDPOOL_TASKQ_CAPACITY];
+    struct thrdpool_taskq q = thrdpool_taskq_init();
+
+    TEST_ASSERT_EQUAL_UINT32((unsigned)thrdpool_taskq_pop_batch(&q, tasks, 4u), 0u);
+
+    for(unsigned i = 0u; i < 3u; i++) {
+        TEST_ASSERT_TRUE(thrdpool_taskq_push(&q, i & 1u ? zero : inc, &value));
+    }
+
+    TEST_ASSERT_EQUAL_UINT32((unsigned)thrdpool_taskq_pop_batch(&q, tasks, 2u), 2u);
+    TEST_ASSERT_TRUE(tasks[0].handle == inc);
+    TEST_ASSERT_TRUE(tasks[1].handle == zero);
+    TEST_ASSERT_EQUAL_UINT32((unsigned)thrdpool_taskq_size(&q), 1u);
+
+    /* Only what is in the queue is popped */
+    TEST_ASSERT_EQUAL_UINT32((unsigned)thrdpool_taskq_pop_batch(&q, tasks, 4u), 1u);
+    TEST_ASSERT_TRUE(tasks[0].handle == inc);
+    TEST_ASSERT_EQUAL_UINT32((unsigned)thrdpool_taskq_size(&q), 0u);
+
+    /* Wrap around */
+    for(unsigned i = 0u; i < THRDPOOL_TASKQ_CAPACITY; i++) {
+        TEST_ASSERT_TRUE(thrdpool_taskq_push(&q, i & 1u ? zero : inc, &value));
+    }
+    TEST_ASSERT_EQUAL_UINT32((unsigned)thrdpool_taskq_pop_batch(&q, tasks, thrdpool_arrsize(tasks)),
+                             THRDPOOL_TASKQ_CAPACITY);
+    for(unsigned i = 0u; i < thrdpool_arrsize(tasks); i++) {
+        TEST_ASSERT_TRUE(tasks[i].handle == (i & 1u ? zero : inc));
+    }
+}
+
+static struct thrdpool_taskq sharedq;
+static unsigned marks[NPRODUCERS * NTASKS_PER_PRODUCER];
+static pthread_mutex_t donelock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned consumed;
+
+#ifndef THRDPOOL_TASKQ_LOCKFREE
+static pthread_mutex_t qlock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/* The locked queue relies on its owner for synchronization */
+static void qlock_acquire(void) {
+#ifndef THRDPOOL_TASKQ_LOCKFREE
+    pthread_mutex_lock(&qlock);
+#endif
+}
+
+static void qlock_release(void) {
+#ifndef THRDPOOL_TASKQ_LOCKFREE
+    pthread_mutex_unlock(&qlock);
+#endif
+}
+
+static void *producer(void *args) {
+    uintptr_t offset = (uintptr_t)args * NTASKS_PER_PRODUCER;
+    bool pushed;
+    for(uintptr_t i = 0u; i < NTASKS_PER_PRODUCER; i++) {
+        do {
+            qlock_acquire();
+            pushed = thrdpool_taskq_push(&sharedq, mark, &marks[offset + i]);
+            qlock_release();
+        } while(!pushed);
+    }
+    return 0;
+}
+
+static void *consumer(void *args) {
+    (void)args;
+    bool popped;
+    bool done = false;
+    struct thrdpool_task task;
+    while(!done) {
+        qlock_acquire();
+        popped = thrdpool_taskq_pop(&sharedq, &task);
+        qlock_release();
+
+        pthread_mutex_lock(&donelock);
+        if(popped) {
+            thrdpool_call(&task);
+            ++consumed;
+        }
+        done = consumed == thrdpool_arrsize(marks);
+        pthread_mutex_unlock(&donelock);
+    }
+    return 0;
+}
+
+void test_taskq_concurrent(void) {
+    pthread_t producers[NPRODUCERS];
+    pthread_t consumers[NCONSUMERS];
+
+    sharedq = thrdpool_taskq_init();
+    consumed = 0u;
+
+    for(uintptr_t i = 0u; i < NCONSUMERS; i++) {
+        TEST_ASSERT_EQUAL_INT32(pthread_create(&consumers[i], 0, consumer, 0), 0);
+    }
+    for(uintptr_t i = 0u; i < NPRODUCERS; i++) {
+        TEST_ASSERT_EQUAL_INT32(pthread_create(&producers[i], 0, producer, (void *)i), 0);
+    }
+
+    for(unsigned i = 0u; i < NPRODUCERS; i++) {
+        TEST_ASSERT_EQUAL_INT32(pthread_join(producers[i], 0), 0);
+    }
+    for(unsigned i = 0u; i < NCONSUMERS; i++) {
+        TEST_ASSERT_EQUAL_INT32(pthread_join(consumers[i], 0), 0);
+    }
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(marks); i++) {
+        TEST_ASSERT_EQUAL_UINT32(marks[i], 1u);
+    }
+    TEST_ASSERT_EQUAL_UINT32((unsigned)thrdpool_taskq_size(&sharedq), 0u);
+}
+
+
+void test_taskq_segmented_growth(void) {
+#ifndef THRDPOOL_TASKQ_SEGMENTED
+    TEST_IGNORE();
+#else
+    unsigned values[4u * THRDPOOL_TASKQ_SEGMENT_SIZE];
+    struct thrdpool_task task;
+    struct thrdpool_taskq q = thrdpool_taskq_init();
+
+    TEST_ASSERT_EQUAL_UINT32(0u, (unsigned)q.nsegments);
+    for(unsigned i = 0u; i < thrdpool_arrsize(values) && i < THRDPOOL_TASKQ_CAPACITY; i++) {
+        TEST_ASSERT_TRUE(thrdpool_taskq_push(&q, mark, &values[i]));
+    }
+    TEST_ASSERT_EQUAL_UINT32(4u, (unsigned)q.nsegments);
+
+    /* FIFO across segment boundaries */
+    for(unsigned i = 0u; i < thrdpool_arrsize(values) && i < THRDPOOL_TASKQ_CAPACITY; i++) {
+        TEST_ASSERT_TRUE(thrdpool_taskq_pop(&q, &task));
+        TEST_ASSERT_EQUAL_PTR(&values[i], task.args);
+    }
+    TEST_ASSERT_FALSE(thrdpool_taskq_pop(&q, &task));
+
+    thrdpool_taskq_destroy(&q);
+    TEST_ASSERT_EQUAL_UINT32(0u, (unsigned)q.nsegments);
+#endif
+}
+
+void test_taskq_segmented_recycling(void) {
+#ifndef THRDPOOL_TASKQ_SEGMENTED
+    TEST_IGNORE();
+#else
+    struct thrdpool_task task;
+    struct thrdpool_task tasks[3u * THRDPOOL_TASKQ_SEGMENT_SIZE / 2u];
+    struct thrdpool_taskq q = thrdpool_taskq_init();
+    size_t nsegments;
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(tasks); i++) {
+        tasks[i] = (struct thrdpool_task) { .handle = inc };
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(thrdpool_arrsize(tasks), (unsigned)thrdpool_taskq_push_batch(&q, tasks, thrdpool_arrsize(tasks)));
+    nsegments = q.nsegments;
+
+    /* A steady backlog reuses drained segments */
+    for(unsigned i = 0u; i < 64u * THRDPOOL_TASKQ_SEGMENT_SIZE; i++) {
+        TEST_ASSERT_TRUE(thrdpool_taskq_pop(&q, &task));
+        TEST_ASSERT_TRUE(thrdpool_taskq_push(&q, inc, 0));
+        TEST_ASSERT_TRUE(q.nsegments <= nsegments + 1u);
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(thrdpool_arrsize(tasks), (unsigned)thrdpool_taskq_pop_batch(&q, tasks, thrdpool_arrsize(tasks)));
+    TEST_ASSERT_EQUAL_UINT32(0u, (unsigned)thrdpool_taskq_size(&q));
+    TEST_ASSERT_TRUE(q.nsegments <= THRDPOOL_TASKQ_SPARE_SEGMENTS + 1u);
+
+    thrdpool_taskq_destroy(&q);
+#endif
+}
+
+void test_taskq_segmented_pop_back(void) {
+#ifndef THRDPOOL_TASKQ_SEGMENTED
+    TEST_IGNORE();
+#else
+    unsigned values[THRDPOOL_TASKQ_SEGMENT_SIZE + 1u];
+    struct thrdpool_task task;
+    struct thrdpool_taskq q = thrdpool_taskq_init();
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(values); i++) {
+        TEST_ASSERT_TRUE(thrdpool_taskq_push(&q, mark, &values[i]));
+    }
+
+    /* Drops the second segment */
+    thrdpool_taskq_pop_back(&q);
+    thrdpool_taskq_pop_back(&q);
+    TEST_ASSERT_EQUAL_UINT32(THRDPOOL_TASKQ_SEGMENT_SIZE - 1u, (unsigned)thrdpool_taskq_size(&q));
+
+    TEST_ASSERT_TRUE(thrdpool_taskq_push(&q, mark, &values[0]));
+    for(unsigned i = 0u; i < THRDPOOL_TASKQ_SEGMENT_SIZE - 1u; i++) {
+        TEST_ASSERT_TRUE(thrdpool_taskq_pop(&q, &task));
+        TEST_ASSERT_EQUAL_PTR(&values[i], task.args);
+    }
+    TEST_ASSERT_TRUE(thrdpool_taskq_pop(&q, &task));
+    TEST_ASSERT_EQUAL_PTR(&values[0], task.args);
+    TEST_ASSERT_FALSE(thrdpool_taskq_pop(&q, &task));
+
+    thrdpool_taskq_destroy(&q);
+#endif
+}
@@ -3,6 +3,9 @@
 #include <thrdpool/thrdpool.h>
 
 #include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
 
 static pthread_mutex_t lock;
 static pthread_cond_t cv;
@@ -48,14 +51,14 @@ void task_signal(void *args) {
 void test_thrdpool_size(void) {
     {
         thrdpool_decl(pool, 1u);
-        TEST_ASSERT_EQUAL_UINT32((unsigned)sizeof(pool), sizeof(struct thrdpool) + sizeof(pthread_t));
+        TEST_ASSERT_EQUAL_UINT32((unsigned)sizeof(pool), sizeof(struct thrdpool) + sizeof(struct thrdpool_worker));
         TEST_ASSERT_TRUE(thrdpool_init(&pool));
         TEST_ASSERT_EQUAL_UINT32((unsigned)thrdpool_size(&pool), 1u);
         TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
     }
     {
         thrdpool_decl(pool, 8u);
-        TEST_ASSERT_EQUAL_UINT32((unsigned)sizeof(pool), sizeof(struct thrdpool) + 8u * sizeof(pthread_t));
+        TEST_ASSERT_EQUAL_UINT32((unsigned)sizeof(pool), sizeof(struct thrdpool) + 8u * sizeof(struct thrdpool_worker));
         TEST_ASSERT_TRUE(thrdpool_init(&pool));
         TEST_ASSERT_EQUAL_UINT32((unsigned)thrdpool_size(&pool), 8u);
         TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
@@ -132,10 +135,8 @@ void test_scheduling_20_workers(void) {
     pthread_mutex_lock(&lock);
 
     for(unsigned i = 0u; i < max_enq; i++) {
-        /* If queue is full, allow workers some time to pick tasks */
-        while(!thrdpool_schedule(&pool, task_inc, &value)) {
-            pthread_yield();
-        }
+        /* If queue is full, wait for workers to pick tasks */
+        TEST_ASSERT_TRUE(thrdpool_schedule_wait(&pool, task_inc, &value));
     }
 
     while(value < max_enq) {
@@ -160,10 +161,8 @@ void test_scheduling_128_workers(void) {
     pthread_mutex_lock(&lock);
 
     for(unsigned i = 0u; i < max_enq; i++) {
-        /* If queue is full, allow workers time to pick tasks */
-        while(!thrdpool_schedule(&pool, task_inc, &value)) {
-            pthread_yield();
-        }
+        /* If queue is full, wait for workers to pick tasks */
+        TEST_ASSERT_TRUE(thrdpool_schedule_wait(&pool, task_inc, &value));
     }
 
     while(value < max_enq) {
@@ -223,6 +222,42 @@ void test_pending(void) {
     TEST_ASSERT_EQUAL_INT32(pthread_cond_destroy(&args.cv), 0);
 }
 
+void test_busy_worker_not_woken(void) {
+    static struct signalargs args;
+    unsigned seq;
+
+    TEST_ASSERT_EQUAL_INT32(pthread_mutex_init(&args.lock, 0), 0);
+    TEST_ASSERT_EQUAL_INT32(pthread_cond_init(&args.cv, 0), 0);
+
+    thrdpool_decl(pool, 1u);
+    TEST_ASSERT_TRUE(thrdpool_init(&pool));
+
+    pthread_mutex_lock(&lock);
+
+    /* Keep the only worker busy */
+    pthread_mutex_lock(&args.lock);
+    TEST_ASSERT_TRUE(thrdpool_schedule(&pool, task_signal, &args));
+    pthread_cond_wait(&args.cv, &args.lock);
+    pthread_mutex_unlock(&args.lock);
+
+    /* No worker is parked, so scheduling must not notify anyone */
+    seq = atomic_load(&pool.d_pool.parked.seq);
+    for(unsigned i = 0u; i < 8u; i++) {
+        TEST_ASSERT_TRUE(thrdpool_schedule(&pool, task_signal, &args));
+    }
+    TEST_ASSERT_EQUAL_UINT32(seq, atomic_load(&pool.d_pool.parked.seq));
+
+    while(args.value < 9u) {
+        pthread_cond_wait(&cv, &lock);
+    }
+    pthread_mutex_unlock(&lock);
+
+    TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+
+    TEST_ASSERT_EQUAL_INT32(pthread_mutex_destroy(&args.lock), 0);
+    TEST_ASSERT_EQUAL_INT32(pthread_cond_destroy(&args.cv), 0);
+}
+
 void test_schedule_flushing(void) {
     static struct signalargs args;
 
@@ -267,3 +302,1006 @@ void test_schedule_flushing(void) {
     TEST_ASSERT_EQUAL_INT32(pthread_mutex_destroy(&args.lock), 0);
     TEST_ASSERT_EQUAL_INT32(pthread_cond_destroy(&args.cv), 0);
 }
+
+struct copyargs {
+    atomic_uint *sum;
+    unsigned values[4];
+};
+
+void task_sum_copy(void *arg) {
+    struct copyargs *ca = arg;
+    for(unsigned i = 0u; i < thrdpool_arrsize(ca->values); i++) {
+        atomic_fetch_add(ca->sum, ca->values[i]);
+    }
+}
+
+void test_schedule_copy(void) {
+    static atomic_uint sum;
+    struct copyargs args;
+    unsigned char large[THRDPOOL_TASK_INLINE_SIZE + 1u] = { 0u };
+    enum thrdpool_sched scheds[] = { THRDPOOL_SCHED_SHARED, THRDPOOL_SCHED_STEAL };
+    struct thrdpool_attr attr = thrdpool_attr_init();
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        thrdpool_decl(pool, 4u);
+        attr.sched = scheds[i];
+        atomic_store(&sum, 0u);
+        TEST_ASSERT_TRUE(thrdpool_init_attr(&pool, &attr));
+
+        args.sum = &sum;
+        for(unsigned j = 0u; j < 64u; j++) {
+            for(unsigned k = 0u; k < thrdpool_arrsize(args.values); k++) {
+                args.values[k] = j;
+            }
+            TEST_ASSERT_TRUE(thrdpool_schedule_copy(&pool, task_sum_copy, &args, sizeof(args)));
+            /* The task works on its own copy */
+            memset(args.values, 0xff, sizeof(args.values));
+            /* Keep within the capacity of the bounded queues */
+            if(j % 16u == 15u) {
+                TEST_ASSERT_TRUE(thrdpool_wait_idle(&pool));
+            }
+        }
+
+        TEST_ASSERT_FALSE(thrdpool_schedule_copy(&pool, task_sum_copy, large, sizeof(large)));
+
+        TEST_ASSERT_TRUE(thrdpool_wait_idle(&pool));
+        TEST_ASSERT_EQUAL_UINT32(4u * (63u * 64u / 2u), atomic_load(&sum));
+        TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+    }
+}
+
+void test_schedule_batch(void) {
+    static struct signalargs args;
+    struct thrdpool_task tasks[THRDPOOL_TASKQ_CAPACITY + 4u];
+
+    TEST_ASSERT_EQUAL_INT32(pthread_mutex_init(&args.lock, 0), 0);
+    TEST_ASSERT_EQUAL_INT32(pthread_cond_init(&args.cv, 0), 0);
+
+    for(unsigned i = 0u; i < sizeof(tasks) / sizeof(tasks[0]); i++) {
+        tasks[i] = (struct thrdpool_task) { .handle = task_signal, .args = &args };
+    }
+
+    thrdpool_decl(pool, 1u);
+    TEST_ASSERT_TRUE(thrdpool_init(&pool));
+
+    pthread_mutex_lock(&lock);
+
+    /* Schedule first task */
+    pthread_mutex_lock(&args.lock);
+    TEST_ASSERT_EQUAL_UINT32((unsigned)thrdpool_schedule_batch(&pool, tasks, 1u), 1u);
+
+    /* Wait for worker to grab job from pool */
+    pthread_cond_wait(&args.cv, &args.lock);
+    /* Done with setup lock */
+    pthread_mutex_unlock(&args.lock);
+
+    /* Only as many tasks as there is room for are accepted */
+    TEST_ASSERT_EQUAL_UINT32((unsigned)thrdpool_schedule_batch(&pool, tasks, sizeof(tasks) / sizeof(tasks[0])),
+                             (unsigned)thrdpool_taskq_capacity(&pool));
+    TEST_ASSERT_EQUAL_UINT32((unsigned)thrdpool_schedule_batch(&pool, tasks, 1u), 0u);
+
+    /* Wait for worker to finish */
+    while(args.value < thrdpool_taskq_capacity(&pool) + 1u) {
+        pthread_cond_wait(&cv, &lock);
+    }
+
+    TEST_ASSERT_EQUAL_UINT32((unsigned)thrdpool_pending(&pool), 0u);
+    pthread_mutex_unlock(&lock);
+
+    TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+    TEST_ASSERT_EQUAL_INT32(pthread_mutex_destroy(&args.lock), 0);
+    TEST_ASSERT_EQUAL_INT32(pthread_cond_destroy(&args.cv), 0);
+}
+
+void test_schedule_batch_20_workers(void) {
+    unsigned value = 0u;
+    struct thrdpool_task tasks[256];
+    thrdpool_decl(pool, 20u);
+    TEST_ASSERT_TRUE(thrdpool_init(&pool));
+
+    for(unsigned i = 0u; i < sizeof(tasks) / sizeof(tasks[0]); i++) {
+        tasks[i] = (struct thrdpool_task) { .handle = task_inc, .args = &value };
+    }
+
+    pthread_mutex_lock(&lock);
+
+    for(size_t scheduled = 0u; scheduled < sizeof(tasks) / sizeof(tasks[0]);) {
+        scheduled += thrdpool_schedule_batch(&pool, &tasks[scheduled], sizeof(tasks) / sizeof(tasks[0]) - scheduled);
+        /* Allow workers to drain the queue */
+        pthread_cond_wait(&cv, &lock);
+    }
+
+    while(value < sizeof(tasks) / sizeof(tasks[0])) {
+        pthread_cond_wait(&cv, &lock);
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(0u, (unsigned)thrdpool_pending(&pool));
+    TEST_ASSERT_EQUAL_UINT32(sizeof(tasks) / sizeof(tasks[0]), value);
+
+    pthread_mutex_unlock(&lock);
+
+    TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+}
+
+void test_batch_claiming(void) {
+    static struct signalargs args;
+    struct thrdpool_task tasks[8];
+    struct thrdpool_attr attr = thrdpool_attr_init();
+    attr.batch = 4u;
+
+    TEST_ASSERT_EQUAL_INT32(pthread_mutex_init(&args.lock, 0), 0);
+    TEST_ASSERT_EQUAL_INT32(pthread_cond_init(&args.cv, 0), 0);
+
+    for(unsigned i = 0u; i < sizeof(tasks) / sizeof(tasks[0]); i++) {
+        tasks[i] = (struct thrdpool_task) { .handle = task_signal, .args = &args };
+    }
+
+    thrdpool_decl(pool, 1u);
+    TEST_ASSERT_TRUE(thrdpool_init_attr(&pool, &attr));
+
+    pthread_mutex_lock(&lock);
+
+    pthread_mutex_lock(&args.lock);
+    TEST_ASSERT_EQUAL_UINT32((unsigned)thrdpool_schedule_batch(&pool, tasks, sizeof(tasks) / sizeof(tasks[0])),
+                             sizeof(tasks) / sizeof(tasks[0]));
+
+    /* Wait for worker to start on the first task */
+    pthread_cond_wait(&args.cv, &args.lock);
+    pthread_mutex_unlock(&args.lock);
+
+    /* Worker claimed 4 tasks, 3 of which are yet to be started */
+    TEST_ASSERT_EQUAL_UINT32((unsigned)thrdpool_pending(&pool), 7u);
+
+    while(args.value < sizeof(tasks) / sizeof(tasks[0])) {
+        pthread_cond_wait(&cv, &lock);
+    }
+
+    TEST_ASSERT_EQUAL_UINT32((unsigned)thrdpool_pending(&pool), 0u);
+    pthread_mutex_unlock(&lock);
+
+    TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+    TEST_ASSERT_EQUAL_INT32(pthread_mutex_destroy(&args.lock), 0);
+    TEST_ASSERT_EQUAL_INT32(pthread_cond_destroy(&args.cv), 0);
+}
+
+void test_batch_claiming_20_workers(void) {
+    enum thrdpool_sched scheds[] = { THRDPOOL_SCHED_SHARED, THRDPOOL_SCHED_STEAL };
+    struct thrdpool_attr attr = thrdpool_attr_init();
+    attr.batch = 8u;
+
+    for(unsigned s = 0u; s < sizeof(scheds) / sizeof(scheds[0]); s++) {
+        unsigned value = 0u;
+        attr.sched = scheds[s];
+        thrdpool_decl(pool, 20u);
+        TEST_ASSERT_TRUE(thrdpool_init_attr(&pool, &attr));
+
+        unsigned max_enq = 8u * (thrdpool_size(&pool) + thrdpool_taskq_capacity(&pool));
+
+        pthread_mutex_lock(&lock);
+
+        for(unsigned i = 0u; i < max_enq; i++) {
+            /* If queue is full, allow workers some time to pick tasks */
+            while(!thrdpool_schedule(&pool, task_inc, &value)) {
+                pthread_cond_wait(&cv, &lock);
+            }
+        }
+
+        while(value < max_enq) {
+            pthread_cond_wait(&cv, &lock);
+        }
+
+        TEST_ASSERT_EQUAL_UINT32(0u, (unsigned)thrdpool_pending(&pool));
+        TEST_ASSERT_EQUAL_UINT32(max_enq, value);
+
+        pthread_mutex_unlock(&lock);
+
+        TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+    }
+}
+
+void test_schedule_wait(void) {
+    static struct signalargs args;
+    struct timespec deadline;
+
+    TEST_ASSERT_EQUAL_INT32(pthread_mutex_init(&args.lock, 0), 0);
+    TEST_ASSERT_EQUAL_INT32(pthread_cond_init(&args.cv, 0), 0);
+
+    thrdpool_decl(pool, 1u);
+    TEST_ASSERT_TRUE(thrdpool_init(&pool));
+
+    pthread_mutex_lock(&lock);
+
+    /* Schedule first task */
+    pthread_mutex_lock(&args.lock);
+    TEST_ASSERT_TRUE(thrdpool_schedule_wait(&pool, task_signal, &args));
+
+    /* Wait for worker to grab job from pool */
+    pthread_cond_wait(&args.cv, &args.lock);
+    /* Done with setup lock */
+    pthread_mutex_unlock(&args.lock);
+
+    for(unsigned i = 0u; i < thrdpool_taskq_capacity(&pool); i++) {
+        TEST_ASSERT_TRUE(thrdpool_schedule_wait(&pool, task_signal, &args));
+    }
+
+    /* Worker is blocked on the global lock, the queue stays full */
+    TEST_ASSERT_EQUAL_INT32(clock_gettime(CLOCK_MONOTONIC, &deadline), 0);
+    deadline.tv_nsec += 10000000;
+    if(deadline.tv_nsec >= 1000000000) {
+        deadline.tv_nsec -= 1000000000;
+        ++deadline.tv_sec;
+    }
+    TEST_ASSERT_FALSE(thrdpool_schedule_timed(&pool, task_signal, &args, &deadline));
+
+    /* Let the worker drain the queue */
+    pthread_mutex_unlock(&lock);
+
+    for(unsigned i = 0u; i < thrdpool_taskq_capacity(&pool); i++) {
+        TEST_ASSERT_TRUE(thrdpool_schedule_wait(&pool, task_signal, &args));
+    }
+
+    TEST_ASSERT_EQUAL_INT32(clock_gettime(CLOCK_MONOTONIC, &deadline), 0);
+    deadline.tv_sec += 60;
+    TEST_ASSERT_TRUE(thrdpool_schedule_timed(&pool, task_signal, &args, &deadline));
+
+    pthread_mutex_lock(&lock);
+    while(args.value < 2u * thrdpool_taskq_capacity(&pool) + 2u) {
+        pthread_cond_wait(&cv, &lock);
+    }
+    TEST_ASSERT_EQUAL_UINT32((unsigned)thrdpool_pending(&pool), 0u);
+    pthread_mutex_unlock(&lock);
+
+    TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+    TEST_ASSERT_EQUAL_INT32(pthread_mutex_destroy(&args.lock), 0);
+    TEST_ASSERT_EQUAL_INT32(pthread_cond_destroy(&args.cv), 0);
+}
+
+void test_schedule_wait_20_workers(void) {
+    unsigned value = 0u;
+    thrdpool_decl(pool, 20u);
+    TEST_ASSERT_TRUE(thrdpool_init(&pool));
+
+    unsigned max_enq = 16u * (thrdpool_size(&pool) + thrdpool_taskq_capacity(&pool));
+
+    for(unsigned i = 0u; i < max_enq; i++) {
+        TEST_ASSERT_TRUE(thrdpool_schedule_wait(&pool, task_inc, &value));
+    }
+
+    pthread_mutex_lock(&lock);
+    while(value < max_enq) {
+        pthread_cond_wait(&cv, &lock);
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(0u, (unsigned)thrdpool_pending(&pool));
+    TEST_ASSERT_EQUAL_UINT32(max_enq, value);
+
+    pthread_mutex_unlock(&lock);
+
+    TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+}
+
+#define SPAWN_TREE_SIZE 1024u
+
+thrdpool_decl(steal_pool, 4u);
+
+static unsigned spawned;
+
+void task_spawn_tree(void *arg) {
+    uintptr_t node = (uintptr_t)arg;
+
+    /* Scheduled from a worker, children go to its deque */
+    for(uintptr_t child = 2u * node + 1u; child <= 2u * node + 2u && child < SPAWN_TREE_SIZE; child++) {
+        TEST_ASSERT_TRUE(thrdpool_schedule_wait(&steal_pool, task_spawn_tree, (void *)child));
+    }
+
+    pthread_mutex_lock(&lock);
+    ++spawned;
+    pthread_mutex_unlock(&lock);
+    pthread_cond_signal(&cv);
+}
+
+void test_steal_basic_scheduling(void) {
+    unsigned value = 0u;
+    struct thrdpool_attr attr = thrdpool_attr_init();
+    attr.sched = THRDPOOL_SCHED_STEAL;
+
+    thrdpool_decl(pool, 2u);
+    TEST_ASSERT_TRUE(thrdpool_init_attr(&pool, &attr));
+
+    pthread_mutex_lock(&lock);
+    TEST_ASSERT_TRUE(thrdpool_schedule(&pool, task_inc, &value));
+
+    while(value < 1u) {
+        pthread_cond_wait(&cv, &lock);
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(1u, value);
+    pthread_mutex_unlock(&lock);
+
+    TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+}
+
+void test_steal_nested_scheduling(void) {
+    struct thrdpool_attr attr = thrdpool_attr_init();
+    attr.sched = THRDPOOL_SCHED_STEAL;
+
+    spawned = 0u;
+    TEST_ASSERT_TRUE(thrdpool_init_attr(&steal_pool, &attr));
+
+    pthread_mutex_lock(&lock);
+    TEST_ASSERT_TRUE(thrdpool_schedule(&steal_pool, task_spawn_tree, (void *)(uintptr_t)0u));
+
+    while(spawned < SPAWN_TREE_SIZE) {
+        pthread_cond_wait(&cv, &lock);
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(SPAWN_TREE_SIZE, spawned);
+    pthread_mutex_unlock(&lock);
+
+    TEST_ASSERT_EQUAL_UINT32(0u, (unsigned)thrdpool_pending(&steal_pool));
+    TEST_ASSERT_TRUE(thrdpool_destroy(&steal_pool));
+}
+
+void task_block(void *args) {
+    struct signalargs *sa = args;
+
+    pthread_mutex_lock(&sa->lock);
+    ++sa->value;
+    pthread_cond_signal(&sa->cv);
+    /* Hold the worker until released by the main thread */
+    while(sa->value < 2u) {
+        pthread_cond_wait(&sa->cv, &sa->lock);
+    }
+    pthread_mutex_unlock(&sa->lock);
+}
+
+void task_add(void *arg) {
+    atomic_fetch_add((atomic_uint *)arg, 1u);
+}
+
+void test_group_wait(void) {
+    static atomic_uint value;
+    struct thrdpool_group group;
+    struct thrdpool_attr attr = thrdpool_attr_init();
+    enum thrdpool_sched scheds[] = { THRDPOOL_SCHED_SHARED, THRDPOOL_SCHED_STEAL };
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        thrdpool_decl(pool, 4u);
+        attr.sched = scheds[i];
+        atomic_store(&value, 0u);
+        TEST_ASSERT_TRUE(thrdpool_group_init(&group));
+        TEST_ASSERT_TRUE(thrdpool_init_attr(&pool, &attr));
+
+        for(unsigned j = 0u; j < 4u * thrdpool_taskq_capacity(&pool); j++) {
+            TEST_ASSERT_TRUE(thrdpool_schedule_group_wait(&pool, &group, task_add, &value));
+        }
+
+        thrdpool_group_wait(&group);
+        TEST_ASSERT_EQUAL_UINT32(4u * thrdpool_taskq_capacity(&pool), atomic_load(&value));
+        TEST_ASSERT_EQUAL_UINT32(0u, (unsigned)thrdpool_group_pending(&group));
+
+        TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+        TEST_ASSERT_TRUE(thrdpool_group_destroy(&group));
+    }
+}
+
+void test_group_batch(void) {
+    static atomic_uint value;
+    struct thrdpool_group group;
+    struct thrdpool_task tasks[THRDPOOL_TASKQ_CAPACITY + 4u];
+    size_t nscheduled;
+
+    static struct signalargs args;
+    TEST_ASSERT_EQUAL_INT32(pthread_mutex_init(&args.lock, 0), 0);
+    TEST_ASSERT_EQUAL_INT32(pthread_cond_init(&args.cv, 0), 0);
+    args.value = 0u;
+
+    atomic_store(&value, 0u);
+    TEST_ASSERT_TRUE(thrdpool_group_init(&group));
+
+    thrdpool_decl(pool, 1u);
+    TEST_ASSERT_TRUE(thrdpool_init(&pool));
+
+    /* Keep the only worker busy */
+    pthread_mutex_lock(&args.lock);
+    TEST_ASSERT_TRUE(thrdpool_schedule(&pool, task_block, &args));
+    while(args.value < 1u) {
+        pthread_cond_wait(&args.cv, &args.lock);
+    }
+    pthread_mutex_unlock(&args.lock);
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(tasks); i++) {
+        tasks[i] = (struct thrdpool_task) {
+            .handle = task_add,
+            .args = &value,
+            .group = &group
+        };
+    }
+
+    /* Tasks not accepted must not be counted */
+    nscheduled = thrdpool_schedule_batch(&pool, tasks, thrdpool_arrsize(tasks));
+    TEST_ASSERT_EQUAL_UINT32(thrdpool_taskq_capacity(&pool), (unsigned)nscheduled);
+    TEST_ASSERT_EQUAL_UINT32(nscheduled, (unsigned)thrdpool_group_pending(&group));
+
+    pthread_mutex_lock(&args.lock);
+    ++args.value;
+    pthread_mutex_unlock(&args.lock);
+    pthread_cond_signal(&args.cv);
+
+    thrdpool_group_wait(&group);
+    TEST_ASSERT_EQUAL_UINT32(nscheduled, atomic_load(&value));
+
+    TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+    TEST_ASSERT_TRUE(thrdpool_group_destroy(&group));
+    TEST_ASSERT_EQUAL_INT32(pthread_mutex_destroy(&args.lock), 0);
+    TEST_ASSERT_EQUAL_INT32(pthread_cond_destroy(&args.cv), 0);
+}
+
+void test_group_flush(void) {
+    static atomic_uint value;
+    struct thrdpool_group group;
+
+    static struct signalargs args;
+    TEST_ASSERT_EQUAL_INT32(pthread_mutex_init(&args.lock, 0), 0);
+    TEST_ASSERT_EQUAL_INT32(pthread_cond_init(&args.cv, 0), 0);
+    args.value = 0u;
+
+    atomic_store(&value, 0u);
+    TEST_ASSERT_TRUE(thrdpool_group_init(&group));
+
+    thrdpool_decl(pool, 1u);
+    TEST_ASSERT_TRUE(thrdpool_init(&pool));
+
+    pthread_mutex_lock(&args.lock);
+    TEST_ASSERT_TRUE(thrdpool_schedule(&pool, task_block, &args));
+    while(args.value < 1u) {
+        pthread_cond_wait(&args.cv, &args.lock);
+    }
+    pthread_mutex_unlock(&args.lock);
+
+    for(unsigned i = 0u; i < thrdpool_taskq_capacity(&pool); i++) {
+        TEST_ASSERT_TRUE(thrdpool_schedule_group(&pool, &group, task_add, &value));
+    }
+    TEST_ASSERT_EQUAL_UINT32(thrdpool_taskq_capacity(&pool), (unsigned)thrdpool_group_pending(&group));
+
+    /* Flushed tasks count as finished */
+    thrdpool_flush(&pool);
+    TEST_ASSERT_EQUAL_UINT32(0u, (unsigned)thrdpool_group_pending(&group));
+    thrdpool_group_wait(&group);
+
+    pthread_mutex_lock(&args.lock);
+    ++args.value;
+    pthread_mutex_unlock(&args.lock);
+    pthread_cond_signal(&args.cv);
+
+    TEST_ASSERT_TRUE(thrdpool_wait_idle(&pool));
+    TEST_ASSERT_EQUAL_UINT32(0u, atomic_load(&value));
+
+    TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+    TEST_ASSERT_TRUE(thrdpool_group_destroy(&group));
+    TEST_ASSERT_EQUAL_INT32(pthread_mutex_destroy(&args.lock), 0);
+    TEST_ASSERT_EQUAL_INT32(pthread_cond_destroy(&args.cv), 0);
+}
+
+void test_wait_idle(void) {
+    static atomic_uint value;
+    struct thrdpool_attr attr = thrdpool_attr_init();
+    enum thrdpool_sched scheds[] = { THRDPOOL_SCHED_SHARED, THRDPOOL_SCHED_STEAL };
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        thrdpool_decl(pool, 20u);
+        attr.sched = scheds[i];
+        atomic_store(&value, 0u);
+        TEST_ASSERT_TRUE(thrdpool_init_attr(&pool, &attr));
+
+        /* Must not block on a pool that has never seen any work */
+        TEST_ASSERT_TRUE(thrdpool_wait_idle(&pool));
+
+        for(unsigned j = 0u; j < 4u * thrdpool_taskq_capacity(&pool); j++) {
+            TEST_ASSERT_TRUE(thrdpool_schedule_wait(&pool, task_add, &value));
+        }
+
+        TEST_ASSERT_TRUE(thrdpool_wait_idle(&pool));
+        TEST_ASSERT_EQUAL_UINT32(4u * thrdpool_taskq_capacity(&pool), atomic_load(&value));
+        TEST_ASSERT_EQUAL_UINT32(0u, (unsigned)thrdpool_pending(&pool));
+        TEST_ASSERT_EQUAL_UINT32(20u, (unsigned)thrdpool_idle_workers(&pool));
+
+        TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+    }
+}
+
+void test_spin_policies(void) {
+    static atomic_uint value;
+    struct thrdpool_attr attr = thrdpool_attr_init();
+    enum thrdpool_sched scheds[] = { THRDPOOL_SCHED_SHARED, THRDPOOL_SCHED_STEAL };
+    struct {
+        uint64_t spin;
+        unsigned yields;
+    } policies[] = { { 200000u, 0u }, { 0u, 4u }, { 200000u, 4u } };
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        for(unsigned j = 0u; j < thrdpool_arrsize(policies); j++) {
+            thrdpool_decl(pool, 4u);
+            attr.sched = scheds[i];
+            attr.spin = policies[j].spin;
+            attr.yields = policies[j].yields;
+            atomic_store(&value, 0u);
+            TEST_ASSERT_TRUE(thrdpool_init_attr(&pool, &attr));
+
+            for(unsigned k = 0u; k < 4u * thrdpool_taskq_capacity(&pool); k++) {
+                TEST_ASSERT_TRUE(thrdpool_schedule_wait(&pool, task_add, &value));
+            }
+
+            /* Spinning workers park eventually */
+            TEST_ASSERT_TRUE(thrdpool_wait_idle(&pool));
+            TEST_ASSERT_EQUAL_UINT32(4u * thrdpool_taskq_capacity(&pool), atomic_load(&value));
+            TEST_ASSERT_EQUAL_UINT32(4u, (unsigned)thrdpool_idle_workers(&pool));
+
+            TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+        }
+    }
+}
+
+void test_spinning_worker(void) {
+    static atomic_uint value;
+    struct thrdpool_group group;
+    struct thrdpool_attr attr = thrdpool_attr_init();
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = 10000000 };
+    attr.spin = 10000000000u;
+
+    thrdpool_decl(pool, 1u);
+    atomic_store(&value, 0u);
+    TEST_ASSERT_TRUE(thrdpool_group_init(&group));
+    TEST_ASSERT_TRUE(thrdpool_init_attr(&pool, &attr));
+
+    for(unsigned i = 0u; i < 8u; i++) {
+        TEST_ASSERT_TRUE(thrdpool_schedule_group(&pool, &group, task_add, &value));
+        thrdpool_group_wait(&group);
+
+        /* Still polling for tasks rather than parked */
+        nanosleep(&ts, 0);
+        TEST_ASSERT_EQUAL_UINT32(0u, (unsigned)thrdpool_idle_workers(&pool));
+    }
+    TEST_ASSERT_EQUAL_UINT32(8u, atomic_load(&value));
+
+    /* Joining must not wait for the spin to run out */
+    TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+    TEST_ASSERT_TRUE(thrdpool_group_destroy(&group));
+}
+
+static atomic_uint held;
+static atomic_bool release;
+
+void task_hold(void *arg) {
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = 1000000 };
+    (void)arg;
+    atomic_fetch_add(&held, 1u);
+    while(!atomic_load(&release)) {
+        nanosleep(&ts, 0);
+    }
+}
+
+void test_elastic_pool(void) {
+    struct thrdpool_group group;
+    struct thrdpool_attr attr = thrdpool_attr_init();
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = 1000000 };
+    enum thrdpool_sched scheds[] = { THRDPOOL_SCHED_SHARED, THRDPOOL_SCHED_STEAL };
+    unsigned nwaits;
+
+    attr.min = 1u;
+    attr.growdepth = 1u;
+    attr.keepalive = 10000000u;
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        thrdpool_decl(pool, 4u);
+        attr.sched = scheds[i];
+        TEST_ASSERT_TRUE(thrdpool_group_init(&group));
+        TEST_ASSERT_TRUE(thrdpool_init_attr(&pool, &attr));
+        TEST_ASSERT_EQUAL_UINT32(1u, (unsigned)thrdpool_size(&pool));
+        TEST_ASSERT_EQUAL_UINT32(4u, (unsigned)thrdpool_max_workers(&pool));
+
+        /* Grow twice, the second time reusing the slots of retired workers */
+        for(unsigned round = 0u; round < 2u; round++) {
+            atomic_store(&held, 0u);
+            atomic_store(&release, false);
+
+            /* Each task queued while all workers are busy spawns another */
+            for(unsigned j = 0u; j < 4u; j++) {
+                TEST_ASSERT_TRUE(thrdpool_schedule_group(&pool, &group, task_hold, 0));
+                while(atomic_load(&held) < j + 1u) {
+                    nanosleep(&ts, 0);
+                }
+            }
+            TEST_ASSERT_EQUAL_UINT32(4u, (unsigned)thrdpool_size(&pool));
+
+            /* Never beyond max */
+            TEST_ASSERT_TRUE(thrdpool_schedule_group(&pool, &group, task_hold, 0));
+            TEST_ASSERT_EQUAL_UINT32(4u, (unsigned)thrdpool_size(&pool));
+
+            atomic_store(&release, true);
+            thrdpool_group_wait(&group);
+            TEST_ASSERT_EQUAL_UINT32(5u, atomic_load(&held));
+
+            /* Surplus workers retire once idle for keepalive */
+            for(nwaits = 0u; thrdpool_size(&pool) > 1u && nwaits < 5000u; nwaits++) {
+                nanosleep(&ts, 0);
+            }
+            TEST_ASSERT_EQUAL_UINT32(1u, (unsigned)thrdpool_size(&pool));
+            TEST_ASSERT_TRUE(thrdpool_wait_idle(&pool));
+        }
+
+        TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+        TEST_ASSERT_TRUE(thrdpool_group_destroy(&group));
+    }
+}
+
+void test_elastic_grow_wait(void) {
+    struct thrdpool_group group;
+    struct thrdpool_attr attr = thrdpool_attr_init();
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = 1000000 };
+
+    attr.min = 1u;
+    attr.max = 2u;
+    attr.growdepth = SIZE_MAX;
+    attr.growwait = 50000000u;
+
+    thrdpool_decl(pool, 4u);
+    atomic_store(&held, 0u);
+    atomic_store(&release, false);
+    TEST_ASSERT_TRUE(thrdpool_group_init(&group));
+    TEST_ASSERT_TRUE(thrdpool_init_attr(&pool, &attr));
+    /* Slots past max are left for spares */
+    TEST_ASSERT_EQUAL_UINT32(4u, (unsigned)thrdpool_max_workers(&pool));
+
+    TEST_ASSERT_TRUE(thrdpool_schedule_group(&pool, &group, task_hold, 0));
+    while(atomic_load(&held) < 1u) {
+        nanosleep(&ts, 0);
+    }
+
+    /* Queued below growdepth, but for longer than growwait */
+    TEST_ASSERT_TRUE(thrdpool_schedule_group(&pool, &group, task_hold, 0));
+    TEST_ASSERT_EQUAL_UINT32(1u, (unsigned)thrdpool_size(&pool));
+    nanosleep(&(struct timespec) { .tv_sec = 0, .tv_nsec = 60000000 }, 0);
+    TEST_ASSERT_TRUE(thrdpool_schedule_group(&pool, &group, task_hold, 0));
+    TEST_ASSERT_EQUAL_UINT32(2u, (unsigned)thrdpool_size(&pool));
+
+    atomic_store(&release, true);
+    thrdpool_group_wait(&group);
+    TEST_ASSERT_EQUAL_UINT32(3u, atomic_load(&held));
+
+    TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+    TEST_ASSERT_TRUE(thrdpool_group_destroy(&group));
+}
+
+void task_hold_blocking(void *arg) {
+    thrdpool_blocking_begin();
+    /* Nested sections count once */
+    thrdpool_blocking_begin();
+    task_hold(arg);
+    thrdpool_blocking_end();
+    thrdpool_blocking_end();
+}
+
+void test_blocking_spares(void) {
+    static atomic_uint value;
+    struct thrdpool_group blocked;
+    struct thrdpool_group group;
+    struct thrdpool_attr attr = thrdpool_attr_init();
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = 1000000 };
+    enum thrdpool_sched scheds[] = { THRDPOOL_SCHED_SHARED, THRDPOOL_SCHED_STEAL };
+    unsigned nwaits;
+
+    attr.max = 2u;
+
+    /* No-op outside of workers */
+    thrdpool_blocking_begin();
+    thrdpool_blocking_end();
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        thrdpool_decl(pool, 4u);
+        attr.sched = scheds[i];
+        atomic_store(&value, 0u);
+        atomic_store(&held, 0u);
+        atomic_store(&release, false);
+        TEST_ASSERT_TRUE(thrdpool_group_init(&blocked));
+        TEST_ASSERT_TRUE(thrdpool_group_init(&group));
+        TEST_ASSERT_TRUE(thrdpool_init_attr(&pool, &attr));
+        TEST_ASSERT_EQUAL_UINT32(2u, (unsigned)thrdpool_size(&pool));
+
+        /* Block both regular workers */
+        for(unsigned j = 0u; j < 2u; j++) {
+            TEST_ASSERT_TRUE(thrdpool_schedule_group(&pool, &blocked, task_hold_blocking, 0));
+        }
+        while(atomic_load(&held) < 2u) {
+            nanosleep(&ts, 0);
+        }
+        TEST_ASSERT_EQUAL_UINT32(4u, (unsigned)thrdpool_size(&pool));
+
+        /* Spares run tasks in their stead */
+        for(unsigned j = 0u; j < 16u; j++) {
+            TEST_ASSERT_TRUE(thrdpool_schedule_group(&pool, &group, task_add, &value));
+        }
+        thrdpool_group_wait(&group);
+        TEST_ASSERT_EQUAL_UINT32(16u, atomic_load(&value));
+
+        atomic_store(&release, true);
+        thrdpool_group_wait(&blocked);
+
+        /* Spares retire once no longer needed, each waking the next as it goes, so this
+         * takes no longer than it takes them to wake up */
+        for(nwaits = 0u; thrdpool_size(&pool) > 2u && nwaits < 250u; nwaits++) {
+            nanosleep(&ts, 0);
+        }
+        TEST_ASSERT_EQUAL_UINT32(2u, (unsigned)thrdpool_size(&pool));
+
+        TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+        TEST_ASSERT_TRUE(thrdpool_group_destroy(&group));
+        TEST_ASSERT_TRUE(thrdpool_group_destroy(&blocked));
+    }
+}
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+void task_fired(void *arg) {
+    atomic_store((atomic_uint_least64_t *)arg, monotonic_ns());
+}
+
+void test_schedule_after(void) {
+    static atomic_uint_least64_t fired;
+    static atomic_uint value;
+    struct thrdpool_timer timers[2];
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = 1000000 };
+    enum thrdpool_sched scheds[] = { THRDPOOL_SCHED_SHARED, THRDPOOL_SCHED_STEAL };
+    struct thrdpool_attr attr = thrdpool_attr_init();
+    uint64_t start;
+    unsigned nwaits;
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        thrdpool_decl(pool, 2u);
+        attr.sched = scheds[i];
+        atomic_store(&fired, 0u);
+        atomic_store(&value, 0u);
+        thrdpool_timer_init(&timers[0]);
+        thrdpool_timer_init(&timers[1]);
+        TEST_ASSERT_TRUE(thrdpool_init_attr(&pool, &attr));
+
+        start = monotonic_ns();
+        TEST_ASSERT_TRUE(thrdpool_schedule_after(&pool, &timers[0], 20000000u, task_fired, &fired));
+        TEST_ASSERT_FALSE(thrdpool_schedule_after(&pool, &timers[0], 0u, task_fired, &fired));
+
+        /* Cancelled before it expires, never runs */
+        TEST_ASSERT_TRUE(thrdpool_schedule_after(&pool, &timers[1], 10000000u, task_add, &value));
+        TEST_ASSERT_TRUE(thrdpool_timer_cancel(&pool, &timers[1]));
+        TEST_ASSERT_FALSE(thrdpool_timer_cancel(&pool, &timers[1]));
+
+        for(nwaits = 0u; !atomic_load(&fired) && nwaits < 5000u; nwaits++) {
+            nanosleep(&ts, 0);
+        }
+        TEST_ASSERT_TRUE(atomic_load(&fired) >= start + 20000000u);
+        TEST_ASSERT_FALSE(thrdpool_timer_cancel(&pool, &timers[0]));
+        TEST_ASSERT_EQUAL_UINT32(0u, atomic_load(&value));
+
+        /* Timers still armed are disarmed when the pool is destroyed */
+        TEST_ASSERT_TRUE(thrdpool_schedule_after(&pool, &timers[1], 1000000000u, task_add, &value));
+        TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+        TEST_ASSERT_FALSE(thrdpool_timer_armed(&timers[1]));
+        TEST_ASSERT_EQUAL_UINT32(0u, atomic_load(&value));
+    }
+}
+
+void test_schedule_every(void) {
+    static atomic_uint value;
+    struct thrdpool_timer timer;
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = 1000000 };
+    enum thrdpool_sched scheds[] = { THRDPOOL_SCHED_SHARED, THRDPOOL_SCHED_STEAL };
+    struct thrdpool_attr attr = thrdpool_attr_init();
+    unsigned nwaits;
+    unsigned nruns;
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        thrdpool_decl(pool, 2u);
+        attr.sched = scheds[i];
+        atomic_store(&value, 0u);
+        thrdpool_timer_init(&timer);
+        TEST_ASSERT_TRUE(thrdpool_init_attr(&pool, &attr));
+
+        TEST_ASSERT_TRUE(thrdpool_schedule_every(&pool, &timer, 2000000u, task_add, &value));
+        for(nwaits = 0u; atomic_load(&value) < 5u && nwaits < 5000u; nwaits++) {
+            nanosleep(&ts, 0);
+        }
+        TEST_ASSERT_TRUE(atomic_load(&value) >= 5u);
+
+        /* Rearmed after each run until cancelled */
+        TEST_ASSERT_TRUE(thrdpool_timer_cancel(&pool, &timer));
+        TEST_ASSERT_TRUE(thrdpool_wait_idle(&pool));
+        nruns = atomic_load(&value);
+        nanosleep(&(struct timespec) { .tv_sec = 0, .tv_nsec = 10000000 }, 0);
+        TEST_ASSERT_EQUAL_UINT32(nruns, atomic_load(&value));
+
+        TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+    }
+}
+
+#define NEXT_CHAIN_LENGTH 100u
+#define NEXT_LIMIT 4u
+
+thrdpool_decl(next_pool, 1u);
+
+static atomic_uint order;
+static atomic_uint child_ran;
+static atomic_uint other_ran;
+static atomic_uint nchained;
+
+void task_child(void *arg) {
+    (void)arg;
+    atomic_store(&child_ran, atomic_fetch_add(&order, 1u) + 1u);
+}
+
+void task_other(void *arg) {
+    (void)arg;
+    atomic_store(&other_ran, atomic_fetch_add(&order, 1u) + 1u);
+}
+
+void task_parent(void *arg) {
+    (void)arg;
+    atomic_fetch_add(&order, 1u);
+    TEST_ASSERT_TRUE(thrdpool_schedule(&next_pool, task_child, 0));
+}
+
+void task_chain(void *arg) {
+    (void)arg;
+    if(atomic_fetch_add(&nchained, 1u) + 1u < NEXT_CHAIN_LENGTH) {
+        TEST_ASSERT_TRUE(thrdpool_schedule(&next_pool, task_chain, 0));
+    }
+}
+
+void task_chain_other(void *arg) {
+    (void)arg;
+    atomic_store(&other_ran, atomic_load(&nchained));
+}
+
+/* Schedule tasks while the only worker of next_pool is held, so that they are all queued by the time it is released */
+static void schedule_held(void(*first)(void *), void(*second)(void *)) {
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = 1000000 };
+
+    atomic_store(&held, 0u);
+    atomic_store(&release, false);
+    TEST_ASSERT_TRUE(thrdpool_schedule(&next_pool, task_hold, 0));
+    while(!atomic_load(&held)) {
+        nanosleep(&ts, 0);
+    }
+    TEST_ASSERT_TRUE(thrdpool_schedule(&next_pool, first, 0));
+    TEST_ASSERT_TRUE(thrdpool_schedule(&next_pool, second, 0));
+    atomic_store(&release, true);
+    TEST_ASSERT_TRUE(thrdpool_wait_idle(&next_pool));
+}
+
+void test_next_slot(void) {
+    struct thrdpool_attr attr = thrdpool_attr_init();
+    enum thrdpool_sched scheds[] = { THRDPOOL_SCHED_SHARED, THRDPOOL_SCHED_STEAL };
+    unsigned const limits[] = { THRDPOOL_NEXT_LIMIT, 0u };
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        for(unsigned j = 0u; j < thrdpool_arrsize(limits); j++) {
+            attr.sched = scheds[i];
+            attr.nextlimit = limits[j];
+            TEST_ASSERT_TRUE(thrdpool_init_attr(&next_pool, &attr));
+            atomic_store(&order, 0u);
+
+            schedule_held(task_parent, task_other);
+            TEST_ASSERT_EQUAL_UINT32(0u, (unsigned)thrdpool_pending(&next_pool));
+            if(limits[j]) {
+                /* Run right after its parent, ahead of the task queued before it */
+                TEST_ASSERT_EQUAL_UINT32(2u, atomic_load(&child_ran));
+                TEST_ASSERT_EQUAL_UINT32(3u, atomic_load(&other_ran));
+            }
+            else if(scheds[i] == THRDPOOL_SCHED_SHARED) {
+                TEST_ASSERT_EQUAL_UINT32(3u, atomic_load(&child_ran));
+                TEST_ASSERT_EQUAL_UINT32(2u, atomic_load(&other_ran));
+            }
+
+            TEST_ASSERT_TRUE(thrdpool_destroy(&next_pool));
+        }
+    }
+}
+
+void test_next_limit(void) {
+    struct thrdpool_attr attr = thrdpool_attr_init();
+    attr.nextlimit = NEXT_LIMIT;
+    atomic_store(&nchained, 0u);
+    TEST_ASSERT_TRUE(thrdpool_init_attr(&next_pool, &attr));
+
+    /* A task rescheduling itself does not keep the one queued behind it waiting */
+    schedule_held(task_chain, task_chain_other);
+    TEST_ASSERT_EQUAL_UINT32(NEXT_LIMIT + 1u, atomic_load(&other_ran));
+    TEST_ASSERT_EQUAL_UINT32(NEXT_CHAIN_LENGTH, atomic_load(&nchained));
+
+    TEST_ASSERT_TRUE(thrdpool_destroy(&next_pool));
+}
+
+thrdpool_decl(nested_pool, 4u);
+
+void task_nested_child(void *arg) {
+    atomic_fetch_add((atomic_uint *)arg, 1u);
+}
+
+void task_nested_parent(void *arg) {
+    struct thrdpool_group children;
+
+    TEST_ASSERT_TRUE(thrdpool_group_init(&children));
+    TEST_ASSERT_TRUE(thrdpool_schedule_group(&nested_pool, &children, task_nested_child, arg));
+    /* Blocks without helping, so the child left in the next slot is run by another worker */
+    thrdpool_group_wait(&children);
+    TEST_ASSERT_TRUE(thrdpool_group_destroy(&children));
+    atomic_fetch_add((atomic_uint *)arg, 1u);
+}
+
+void test_next_slot_nested_wait(void) {
+    static atomic_uint value;
+    struct thrdpool_attr attr = thrdpool_attr_init();
+    enum thrdpool_sched scheds[] = { THRDPOOL_SCHED_SHARED, THRDPOOL_SCHED_STEAL };
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        attr.sched = scheds[i];
+        atomic_store(&value, 0u);
+        TEST_ASSERT_TRUE(thrdpool_init_attr(&nested_pool, &attr));
+
+        TEST_ASSERT_TRUE(thrdpool_schedule(&nested_pool, task_nested_parent, &value));
+        TEST_ASSERT_TRUE(thrdpool_wait_idle(&nested_pool));
+        TEST_ASSERT_EQUAL_UINT32(2u, atomic_load(&value));
+
+        TEST_ASSERT_TRUE(thrdpool_destroy(&nested_pool));
+    }
+}
+
+#define WORKER_ID_POOL_SIZE 4u
+
+thrdpool_decl(id_pool, WORKER_ID_POOL_SIZE);
+
+static unsigned worker_ids[WORKER_ID_POOL_SIZE + 1u];
+
+void task_worker_id(void *arg) {
+    struct signalargs *sa = arg;
+    size_t id = thrdpool_worker_id(&id_pool);
+
+    pthread_mutex_lock(&sa->lock);
+    ++worker_ids[id < WORKER_ID_POOL_SIZE ? id : WORKER_ID_POOL_SIZE];
+    ++sa->value;
+    pthread_cond_broadcast(&sa->cv);
+    /* Keep the worker busy until all have checked in */
+    while(sa->value < WORKER_ID_POOL_SIZE) {
+        pthread_cond_wait(&sa->cv, &sa->lock);
+    }
+    pthread_mutex_unlock(&sa->lock);
+}
+
+void test_worker_id(void) {
+    static struct signalargs args;
+    TEST_ASSERT_EQUAL_INT32(pthread_mutex_init(&args.lock, 0), 0);
+    TEST_ASSERT_EQUAL_INT32(pthread_cond_init(&args.cv, 0), 0);
+    args.value = 0u;
+
+    TEST_ASSERT_TRUE(thrdpool_init(&id_pool));
+
+    /* Not a worker */
+    TEST_ASSERT_EQUAL_UINT32(WORKER_ID_POOL_SIZE, (unsigned)thrdpool_worker_id(&id_pool));
+
+    for(unsigned i = 0u; i < WORKER_ID_POOL_SIZE; i++) {
+        TEST_ASSERT_TRUE(thrdpool_schedule(&id_pool, task_worker_id, &args));
+    }
+    TEST_ASSERT_TRUE(thrdpool_wait_idle(&id_pool));
+
+    /* Each worker ran exactly one task */
+    for(unsigned i = 0u; i < WORKER_ID_POOL_SIZE; i++) {
+        TEST_ASSERT_EQUAL_UINT32(1u, worker_ids[i]);
+    }
+    TEST_ASSERT_EQUAL_UINT32(0u, worker_ids[WORKER_ID_POOL_SIZE]);
+
+    TEST_ASSERT_TRUE(thrdpool_destroy(&id_pool));
+    TEST_ASSERT_EQUAL_INT32(pthread_mutex_destroy(&args.lock), 0);
+    TEST_ASSERT_EQUAL_INT32(pthread_cond_destroy(&args.cv), 0);
+}
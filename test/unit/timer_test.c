@@ -0,0 +1,166 @@
+#include <unity.h>
+#include <thrdpool/timer.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define NTIMERS 1024u
+
+static struct thrdpool_timer_wheel wheel;
+static struct thrdpool_timer timers[NTIMERS];
+
+void setUp(void) {
+    thrdpool_timer_wheel_init(&wheel);
+    for(unsigned i = 0u; i < NTIMERS; i++) {
+        thrdpool_timer_init(&timers[i]);
+    }
+}
+
+void tearDown(void) { }
+
+static void arm(struct thrdpool_timer *timer, uint64_t expires) {
+    timer->expires = expires;
+    thrdpool_timer_wheel_add(&wheel, timer);
+}
+
+/* Turn the wheel tick by tick as a driver following thrdpool_timer_wheel_next would,
+ * returning the tick timer expired at */
+static uint64_t expiry(struct thrdpool_timer *timer) {
+    struct thrdpool_timer *expired[4];
+    uint64_t tick;
+    size_t n;
+
+    while((tick = thrdpool_timer_wheel_next(&wheel)) != UINT64_MAX) {
+        n = thrdpool_timer_wheel_expire(&wheel, tick, expired, 4u);
+        for(size_t i = 0u; i < n; i++) {
+            if(expired[i] == timer) {
+                return tick;
+            }
+        }
+    }
+    return UINT64_MAX;
+}
+
+void test_timer_expires_on_time(void) {
+    uint64_t const ticks[] = { 0u, 1u, 63u, 64u, 65u, 4095u, 4096u, 262145u, UINT64_C(1) << 40, UINT64_MAX - 1u };
+
+    for(unsigned i = 0u; i < sizeof(ticks) / sizeof(ticks[0]); i++) {
+        arm(&timers[i], ticks[i]);
+    }
+    for(unsigned i = 0u; i < sizeof(ticks) / sizeof(ticks[0]); i++) {
+        TEST_ASSERT_EQUAL_UINT64(ticks[i], expiry(&timers[i]));
+        TEST_ASSERT_FALSE(thrdpool_timer_armed(&timers[i]));
+    }
+    TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, thrdpool_timer_wheel_next(&wheel));
+}
+
+void test_timer_next_bounded(void) {
+    struct thrdpool_timer *expired[1];
+    unsigned nturns = 0u;
+    uint64_t tick;
+
+    /* Reaching a timer takes at most one turn per level */
+    arm(&timers[0], UINT64_C(123456789012));
+    while((tick = thrdpool_timer_wheel_next(&wheel)) != UINT64_MAX) {
+        TEST_ASSERT_TRUE(tick <= timers[0].expires);
+        ++nturns;
+        if(thrdpool_timer_wheel_expire(&wheel, tick, expired, 1u)) {
+            TEST_ASSERT_EQUAL_UINT64(timers[0].expires, tick);
+        }
+    }
+    TEST_ASSERT_TRUE(nturns <= THRDPOOL_TIMER_LEVELS);
+}
+
+void test_timer_past_expiry(void) {
+    struct thrdpool_timer *expired[1];
+    TEST_ASSERT_EQUAL_UINT64(0u, thrdpool_timer_wheel_expire(&wheel, 100u, expired, 1u));
+
+    arm(&timers[0], 50u);
+    TEST_ASSERT_EQUAL_UINT64(101u, thrdpool_timer_wheel_next(&wheel));
+    TEST_ASSERT_EQUAL_UINT64(1u, thrdpool_timer_wheel_expire(&wheel, 101u, expired, 1u));
+    TEST_ASSERT_EQUAL_PTR(&timers[0], expired[0]);
+}
+
+void test_timer_remove(void) {
+    struct thrdpool_timer *expired[NTIMERS];
+
+    arm(&timers[0], 10u);
+    arm(&timers[1], 10u);
+    arm(&timers[2], 5000u);
+    thrdpool_timer_wheel_remove(&wheel, &timers[0]);
+    thrdpool_timer_wheel_remove(&wheel, &timers[2]);
+    TEST_ASSERT_FALSE(thrdpool_timer_armed(&timers[0]));
+    TEST_ASSERT_TRUE(thrdpool_timer_armed(&timers[1]));
+
+    TEST_ASSERT_EQUAL_UINT64(10u, thrdpool_timer_wheel_next(&wheel));
+    TEST_ASSERT_EQUAL_UINT64(1u, thrdpool_timer_wheel_expire(&wheel, 10000u, expired, NTIMERS));
+    TEST_ASSERT_EQUAL_PTR(&timers[1], expired[0]);
+    TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, thrdpool_timer_wheel_next(&wheel));
+}
+
+void test_timer_expire_partial(void) {
+    struct thrdpool_timer *expired[NTIMERS];
+    size_t nexpired = 0u;
+
+    for(unsigned i = 0u; i < 10u; i++) {
+        arm(&timers[i], 70u);
+    }
+    arm(&timers[10], 71u);
+
+    /* Those left over are returned first by the next call */
+    TEST_ASSERT_EQUAL_UINT64(4u, thrdpool_timer_wheel_expire(&wheel, 80u, expired, 4u));
+    TEST_ASSERT_EQUAL_UINT64(70u, thrdpool_timer_wheel_next(&wheel));
+    nexpired += thrdpool_timer_wheel_expire(&wheel, 80u, expired, 6u);
+    TEST_ASSERT_EQUAL_UINT64(6u, nexpired);
+    for(size_t i = 0u; i < nexpired; i++) {
+        TEST_ASSERT_EQUAL_UINT64(70u, expired[i]->expires);
+    }
+    TEST_ASSERT_EQUAL_UINT64(1u, thrdpool_timer_wheel_expire(&wheel, 80u, expired, NTIMERS));
+    TEST_ASSERT_EQUAL_PTR(&timers[10], expired[0]);
+}
+
+void test_timer_random(void) {
+    struct thrdpool_timer *expired[16];
+    uint64_t prev = 0u;
+    uint64_t tick = 0u;
+    size_t nexpired = 0u;
+    size_t n;
+
+    srand(1u);
+    for(unsigned i = 0u; i < NTIMERS; i++) {
+        arm(&timers[i], (uint64_t)rand() % 200000u);
+    }
+
+    while(nexpired < NTIMERS) {
+        prev = tick;
+        tick += (uint64_t)rand() % 1000u;
+        do {
+            n = thrdpool_timer_wheel_expire(&wheel, tick, expired, 16u);
+            for(size_t i = 0u; i < n; i++) {
+                /* Expired by the turn that covered its expiry */
+                TEST_ASSERT_TRUE(expired[i]->expires <= tick);
+                TEST_ASSERT_TRUE(expired[i]->expires >= prev);
+                TEST_ASSERT_FALSE(thrdpool_timer_armed(expired[i]));
+            }
+            nexpired += n;
+        } while(n == 16u);
+
+        /* Remove and re-add some still armed to mix things up */
+        for(unsigned i = (unsigned)tick % 7u; i < NTIMERS; i += 97u) {
+            if(thrdpool_timer_armed(&timers[i])) {
+                thrdpool_timer_wheel_remove(&wheel, &timers[i]);
+                thrdpool_timer_wheel_add(&wheel, &timers[i]);
+            }
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, thrdpool_timer_wheel_next(&wheel));
+}
+
+void test_timer_clear(void) {
+    arm(&timers[0], 10u);
+    arm(&timers[1], 100000u);
+    thrdpool_timer_wheel_clear(&wheel);
+    TEST_ASSERT_FALSE(thrdpool_timer_armed(&timers[0]));
+    TEST_ASSERT_FALSE(thrdpool_timer_armed(&timers[1]));
+    TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, thrdpool_timer_wheel_next(&wheel));
+}
@@ -0,0 +1,267 @@
+#include <unity.h>
+
+#include <thrdpool/thrdpool.h>
+
+#include <ftw.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define NCPUS 8u
+
+struct blockargs {
+    pthread_mutex_t lock;
+    pthread_cond_t cv;
+    unsigned value;
+    unsigned release;
+};
+
+static char sysfs[] = "/tmp/thrdpool_sysfsXXXXXX";
+
+/* Two nodes of one package each, with two cores of two hardware threads. The
+ * siblings of cpu i are numbered i + 4, as on most x86 machines */
+static struct thrdpool_topology const numa = {
+    .ncpus = NCPUS,
+    .nnodes = 2u,
+    .cpus = {
+        { .id = 0u, .core = 0u, .package = 0u, .node = 0u },
+        { .id = 1u, .core = 1u, .package = 0u, .node = 0u },
+        { .id = 2u, .core = 0u, .package = 1u, .node = 1u },
+        { .id = 3u, .core = 1u, .package = 1u, .node = 1u },
+        { .id = 4u, .core = 0u, .package = 0u, .node = 0u },
+        { .id = 5u, .core = 1u, .package = 0u, .node = 0u },
+        { .id = 6u, .core = 0u, .package = 1u, .node = 1u },
+        { .id = 7u, .core = 1u, .package = 1u, .node = 1u }
+    }
+};
+
+static int rmentry(char const *path, struct stat const *sb, int flag, struct FTW *ftw) {
+    (void)sb;
+    (void)flag;
+    (void)ftw;
+    return remove(path);
+}
+
+void setUp(void) {
+    strcpy(sysfs + strlen(sysfs) - 6u, "XXXXXX");
+    TEST_ASSERT_NOT_NULL(mkdtemp(sysfs));
+}
+
+void tearDown(void) {
+    TEST_ASSERT_EQUAL_INT32(0, nftw(sysfs, rmentry, 16, FTW_DEPTH | FTW_PHYS));
+}
+
+/* Write contents to path relative to the fake sysfs, creating directories as needed */
+static void sysfs_write(char const *path, char const *contents) {
+    char buf[256];
+    FILE *fp;
+    snprintf(buf, sizeof(buf), "%s/%s", sysfs, path);
+
+    for(char *sep = strchr(buf + strlen(sysfs) + 1u, '/'); sep; sep = strchr(sep + 1, '/')) {
+        *sep = '\0';
+        mkdir(buf, 0755);
+        *sep = '/';
+    }
+
+    fp = fopen(buf, "w");
+    TEST_ASSERT_NOT_NULL(fp);
+    fputs(contents, fp);
+    fclose(fp);
+}
+
+static void sysfs_cpus(void) {
+    char path[128];
+    char value[16];
+
+    sysfs_write("devices/system/cpu/online", "0-7\n");
+    for(unsigned i = 0u; i < NCPUS; i++) {
+        snprintf(path, sizeof(path), "devices/system/cpu/cpu%u/topology/core_id", i);
+        snprintf(value, sizeof(value), "%u\n", numa.cpus[i].core);
+        sysfs_write(path, value);
+        snprintf(path, sizeof(path), "devices/system/cpu/cpu%u/topology/physical_package_id", i);
+        snprintf(value, sizeof(value), "%u\n", numa.cpus[i].package);
+        sysfs_write(path, value);
+    }
+}
+
+void task_block(void *args) {
+    struct blockargs *ba = args;
+
+    pthread_mutex_lock(&ba->lock);
+    ++ba->value;
+    pthread_cond_broadcast(&ba->cv);
+    while(!ba->release) {
+        pthread_cond_wait(&ba->cv, &ba->lock);
+    }
+    pthread_mutex_unlock(&ba->lock);
+}
+
+void task_nop(void *arg) {
+    (void)arg;
+}
+
+void test_topology_discover(void) {
+    struct thrdpool_topology topo;
+    sysfs_cpus();
+    /* Node 1 only has memory, node 2 gets the index 1 */
+    sysfs_write("devices/system/node/online", "0-2\n");
+    sysfs_write("devices/system/node/node0/cpulist", "0-1,4-5\n");
+    sysfs_write("devices/system/node/node1/cpulist", "\n");
+    sysfs_write("devices/system/node/node2/cpulist", "2-3,6-7\n");
+
+    TEST_ASSERT_TRUE(thrdpool_topology_discover(&topo, sysfs));
+    TEST_ASSERT_EQUAL_UINT32(NCPUS, (unsigned)topo.ncpus);
+    TEST_ASSERT_EQUAL_UINT32(2u, (unsigned)topo.nnodes);
+    for(unsigned i = 0u; i < NCPUS; i++) {
+        TEST_ASSERT_EQUAL_UINT32(numa.cpus[i].id, topo.cpus[i].id);
+        TEST_ASSERT_EQUAL_UINT32(numa.cpus[i].core, topo.cpus[i].core);
+        TEST_ASSERT_EQUAL_UINT32(numa.cpus[i].package, topo.cpus[i].package);
+        TEST_ASSERT_EQUAL_UINT32(numa.cpus[i].node, topo.cpus[i].node);
+    }
+}
+
+void test_topology_discover_without_numa(void) {
+    struct thrdpool_topology topo;
+    sysfs_write("devices/system/cpu/online", "0,2-3\n");
+
+    TEST_ASSERT_TRUE(thrdpool_topology_discover(&topo, sysfs));
+    TEST_ASSERT_EQUAL_UINT32(3u, (unsigned)topo.ncpus);
+    TEST_ASSERT_EQUAL_UINT32(1u, (unsigned)topo.nnodes);
+    TEST_ASSERT_EQUAL_UINT32(2u, topo.cpus[1].id);
+    /* Without topology information, each CPU is a core of its own */
+    TEST_ASSERT_EQUAL_UINT32(2u, topo.cpus[1].core);
+    TEST_ASSERT_EQUAL_UINT32(0u, topo.cpus[1].node);
+
+    TEST_ASSERT_FALSE(thrdpool_topology_discover(&topo, "/nonexistent"));
+}
+
+void test_topology_discover_host(void) {
+    struct thrdpool_topology topo;
+    TEST_ASSERT_TRUE(thrdpool_topology_discover(&topo, 0));
+    TEST_ASSERT_TRUE(topo.ncpus > 0u);
+    TEST_ASSERT_TRUE(topo.nnodes > 0u);
+    for(size_t i = 0u; i < topo.ncpus; i++) {
+        TEST_ASSERT_TRUE(topo.cpus[i].node < topo.nnodes);
+    }
+}
+
+void test_topology_order(void) {
+    size_t order[THRDPOOL_MAX_CPUS];
+    size_t compact[] = { 0u, 4u, 1u, 5u, 2u, 6u, 3u, 7u };
+    size_t scatter[] = { 0u, 2u, 1u, 3u, 4u, 6u, 5u, 7u };
+    unsigned list[] = { 6u, 1u };
+    unsigned offline[] = { 1u, 8u };
+
+    TEST_ASSERT_EQUAL_UINT32(NCPUS, (unsigned)thrdpool_topology_order(&numa, THRDPOOL_AFFINITY_COMPACT, 0, 0u, order));
+    for(unsigned i = 0u; i < NCPUS; i++) {
+        TEST_ASSERT_EQUAL_UINT32((unsigned)compact[i], (unsigned)order[i]);
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(NCPUS, (unsigned)thrdpool_topology_order(&numa, THRDPOOL_AFFINITY_SCATTER, 0, 0u, order));
+    for(unsigned i = 0u; i < NCPUS; i++) {
+        TEST_ASSERT_EQUAL_UINT32((unsigned)scatter[i], (unsigned)order[i]);
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(2u, (unsigned)thrdpool_topology_order(&numa, THRDPOOL_AFFINITY_LIST, list, 2u, order));
+    TEST_ASSERT_EQUAL_UINT32(6u, (unsigned)order[0]);
+    TEST_ASSERT_EQUAL_UINT32(1u, (unsigned)order[1]);
+
+    TEST_ASSERT_EQUAL_UINT32(0u, (unsigned)thrdpool_topology_order(&numa, THRDPOOL_AFFINITY_LIST, offline, 2u, order));
+    TEST_ASSERT_EQUAL_UINT32(0u, (unsigned)thrdpool_topology_order(&numa, THRDPOOL_AFFINITY_NONE, 0, 0u, order));
+}
+
+void test_topology_affinity(void) {
+    cpu_set_t set;
+    struct thrdpool_topology topo;
+    struct thrdpool_attr attr = thrdpool_attr_init();
+    enum thrdpool_affinity affinities[] = { THRDPOOL_AFFINITY_COMPACT, THRDPOOL_AFFINITY_SCATTER, THRDPOOL_AFFINITY_LIST };
+    unsigned cpu;
+
+    TEST_ASSERT_TRUE(thrdpool_topology_discover(&topo, 0));
+    cpu = topo.cpus[topo.ncpus - 1u].id;
+    attr.cpus = &cpu;
+    attr.ncpus = 1u;
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(affinities); i++) {
+        thrdpool_decl(pool, 2u);
+        attr.affinity = affinities[i];
+        TEST_ASSERT_TRUE(thrdpool_init_attr(&pool, &attr));
+
+        for(unsigned j = 0u; j < thrdpool_size(&pool); j++) {
+            struct thrdpool_worker *worker = &pool.d_pool.workers[j];
+            TEST_ASSERT_TRUE(worker->cpu >= 0);
+            if(affinities[i] == THRDPOOL_AFFINITY_LIST) {
+                TEST_ASSERT_EQUAL_UINT32(cpu, (unsigned)worker->cpu);
+            }
+            TEST_ASSERT_EQUAL_INT32(0, pthread_getaffinity_np(worker->thrd, sizeof(set), &set));
+            TEST_ASSERT_EQUAL_INT32(1, CPU_COUNT(&set));
+            TEST_ASSERT_TRUE(CPU_ISSET(worker->cpu, &set));
+        }
+
+        TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+    }
+
+    {
+        thrdpool_decl(pool, 1u);
+        cpu = THRDPOOL_MAX_CPUS;
+        attr.affinity = THRDPOOL_AFFINITY_LIST;
+        TEST_ASSERT_FALSE(thrdpool_init_attr(&pool, &attr));
+    }
+}
+
+void test_topology_numa_queues(void) {
+    static struct blockargs args;
+    struct thrdpool_attr attr = thrdpool_attr_init();
+    enum thrdpool_sched scheds[] = { THRDPOOL_SCHED_SHARED, THRDPOOL_SCHED_STEAL };
+    unsigned capacity;
+
+    TEST_ASSERT_EQUAL_INT32(pthread_mutex_init(&args.lock, 0), 0);
+    TEST_ASSERT_EQUAL_INT32(pthread_cond_init(&args.cv, 0), 0);
+    attr.numa = true;
+    attr.topology = &numa;
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        thrdpool_decl(pool, 2u);
+        capacity = (unsigned)thrdpool_taskq_capacity(&pool);
+        attr.sched = scheds[i];
+        args.value = 0u;
+        args.release = 0u;
+        TEST_ASSERT_TRUE(thrdpool_init_attr(&pool, &attr));
+
+        /* Unpinned workers are spread over the nodes */
+        TEST_ASSERT_EQUAL_UINT32(2u, (unsigned)pool.d_pool.nqueues);
+        TEST_ASSERT_EQUAL_UINT32(0u, (unsigned)pool.d_pool.workers[0].node);
+        TEST_ASSERT_EQUAL_UINT32(1u, (unsigned)pool.d_pool.workers[1].node);
+
+        pthread_mutex_lock(&args.lock);
+        TEST_ASSERT_TRUE(thrdpool_schedule(&pool, task_block, &args));
+        TEST_ASSERT_TRUE(thrdpool_schedule(&pool, task_block, &args));
+        while(args.value < 2u) {
+            pthread_cond_wait(&args.cv, &args.lock);
+        }
+        pthread_mutex_unlock(&args.lock);
+
+        /* Tasks spill over to the queue of the other node once that of the local one is full */
+        for(unsigned j = 0u; j < 2u * capacity; j++) {
+            TEST_ASSERT_TRUE(thrdpool_schedule(&pool, task_nop, 0));
+        }
+        TEST_ASSERT_FALSE(thrdpool_schedule(&pool, task_nop, 0));
+        TEST_ASSERT_EQUAL_UINT32(2u * capacity, (unsigned)thrdpool_pending(&pool));
+
+        pthread_mutex_lock(&args.lock);
+        args.release = 1u;
+        pthread_cond_broadcast(&args.cv);
+        pthread_mutex_unlock(&args.lock);
+
+        /* Workers fall back to the queue of the other node once their own runs dry */
+        TEST_ASSERT_TRUE(thrdpool_wait_idle(&pool));
+        TEST_ASSERT_EQUAL_UINT32(0u, (unsigned)thrdpool_pending(&pool));
+        TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+    }
+
+    TEST_ASSERT_EQUAL_INT32(pthread_mutex_destroy(&args.lock), 0);
+    TEST_ASSERT_EQUAL_INT32(pthread_cond_destroy(&args.cv), 0);
+}
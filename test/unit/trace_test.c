@@ -0,0 +1,134 @@
+#include <unity.h>
+
+#include <thrdpool/thrdpool.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NTASKS 64u
+
+static struct thrdpool_group group;
+
+void setUp(void) {
+    TEST_ASSERT_TRUE(thrdpool_group_init(&group));
+}
+
+void tearDown(void) {
+    TEST_ASSERT_TRUE(thrdpool_group_destroy(&group));
+}
+
+void task_nop(void *arg) {
+    (void)arg;
+}
+
+#ifdef THRDPOOL_TRACE
+static char *dump(struct thrdpool *pool) {
+    long size;
+    char *buf;
+    FILE *fp = tmpfile();
+    TEST_ASSERT_NOT_NULL(fp);
+
+    TEST_ASSERT_TRUE(thrdpool_trace_dump_impl(pool, fp));
+    size = ftell(fp);
+    TEST_ASSERT_TRUE(size > 0);
+    rewind(fp);
+
+    buf = malloc((size_t)size + 1u);
+    TEST_ASSERT_NOT_NULL(buf);
+    TEST_ASSERT_EQUAL_UINT32((unsigned)size, (unsigned)fread(buf, 1u, (size_t)size, fp));
+    buf[size] = '\0';
+    fclose(fp);
+    return buf;
+}
+
+static unsigned count(char const *str, char const *needle) {
+    unsigned n = 0u;
+    while((str = strstr(str, needle))) {
+        ++n;
+        ++str;
+    }
+    return n;
+}
+#endif
+
+void test_trace_disabled(void) {
+#ifdef THRDPOOL_TRACE
+    TEST_IGNORE();
+#else
+    thrdpool_decl(pool, 1u);
+    TEST_ASSERT_TRUE(thrdpool_init(&pool));
+    TEST_ASSERT_FALSE(thrdpool_trace_dump(&pool, stdout));
+    TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+#endif
+}
+
+void test_trace_events(void) {
+#ifndef THRDPOOL_TRACE
+    TEST_IGNORE();
+#else
+    char *json;
+    struct thrdpool_attr attr = thrdpool_attr_init();
+    enum thrdpool_sched scheds[] = { THRDPOOL_SCHED_SHARED, THRDPOOL_SCHED_STEAL };
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        thrdpool_decl(pool, 2u);
+        attr.sched = scheds[i];
+        TEST_ASSERT_TRUE(thrdpool_init_attr(&pool, &attr));
+
+        for(unsigned j = 0u; j < NTASKS; j++) {
+            TEST_ASSERT_TRUE(thrdpool_schedule_group_wait(&pool, &group, task_nop, 0));
+        }
+        thrdpool_group_wait(&group);
+        TEST_ASSERT_TRUE(thrdpool_wait_idle(&pool));
+
+        json = dump(&pool.d_pool);
+        TEST_ASSERT_EQUAL_INT32(0, strncmp(json, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", 39));
+        TEST_ASSERT_EQUAL_INT32(0, strcmp(json + strlen(json) - 4u, "\n]}\n"));
+        TEST_ASSERT_EQUAL_UINT32(count(json, "{"), count(json, "}"));
+
+        TEST_ASSERT_EQUAL_UINT32(1u, count(json, "\"name\":\"producer 0\""));
+        TEST_ASSERT_EQUAL_UINT32(1u, count(json, "\"name\":\"worker 1\""));
+
+        TEST_ASSERT_EQUAL_UINT32(NTASKS, count(json, "\"name\":\"enqueue\""));
+        TEST_ASSERT_EQUAL_UINT32(NTASKS, count(json, "\"name\":\"task\",\"ph\":\"B\""));
+        TEST_ASSERT_EQUAL_UINT32(NTASKS, count(json, "\"name\":\"task\",\"ph\":\"E\""));
+        /* Tasks scheduled from outside the pool all go through the shared queue */
+        TEST_ASSERT_EQUAL_UINT32(NTASKS, count(json, "\"name\":\"dequeue\""));
+        /* One flow arrow per task, from enqueue to start */
+        TEST_ASSERT_EQUAL_UINT32(NTASKS, count(json, "\"ph\":\"s\""));
+        TEST_ASSERT_EQUAL_UINT32(NTASKS, count(json, "\"ph\":\"f\""));
+        TEST_ASSERT_EQUAL_UINT32(count(json, "\"name\":\"parked\",\"ph\":\"B\""),
+                                 count(json, "\"name\":\"parked\",\"ph\":\"E\"") + thrdpool_size(&pool));
+        free(json);
+
+        TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+    }
+#endif
+}
+
+void test_trace_wraparound(void) {
+#ifndef THRDPOOL_TRACE
+    TEST_IGNORE();
+#else
+    char *json;
+    unsigned ntasks = 2u * THRDPOOL_TRACE_EVENTS;
+    thrdpool_decl(pool, 1u);
+    TEST_ASSERT_TRUE(thrdpool_init(&pool));
+
+    for(unsigned i = 0u; i < ntasks; i++) {
+        TEST_ASSERT_TRUE(thrdpool_schedule_group_wait(&pool, &group, task_nop, 0));
+    }
+    thrdpool_group_wait(&group);
+    TEST_ASSERT_TRUE(thrdpool_wait_idle(&pool));
+
+    /* Only the most recent events of each thread are kept */
+    json = dump(&pool.d_pool);
+    TEST_ASSERT_EQUAL_UINT32(THRDPOOL_TRACE_EVENTS, count(json, "\"name\":\"enqueue\""));
+    TEST_ASSERT_TRUE(count(json, "\"name\":\"task\",\"ph\":\"E\"") < THRDPOOL_TRACE_EVENTS);
+    TEST_ASSERT_EQUAL_UINT32(count(json, "{"), count(json, "}"));
+    free(json);
+
+    TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+#endif
+}
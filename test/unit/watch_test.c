@@ -0,0 +1,158 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <unity.h>
+
+#include <thrdpool/thrdpool.h>
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NMESSAGES 100u
+
+static struct thrdpool_watch watch;
+static struct thrdpool_group group;
+static atomic_uint nread;
+static atomic_uint nran;
+static int fds[2];
+
+thrdpool_decl(pool, 2u);
+
+static enum thrdpool_sched const scheds[] = { THRDPOOL_SCHED_SHARED, THRDPOOL_SCHED_STEAL };
+
+void setUp(void) {
+    thrdpool_watch_init(&watch);
+    TEST_ASSERT_TRUE(thrdpool_group_init(&group));
+    atomic_store(&nread, 0u);
+    atomic_store(&nran, 0u);
+}
+
+void tearDown(void) {
+    TEST_ASSERT_TRUE(thrdpool_group_destroy(&group));
+}
+
+static void init_pool(enum thrdpool_sched sched, size_t nworkers) {
+    struct thrdpool_attr attr = thrdpool_attr_init();
+    attr.sched = sched;
+    TEST_ASSERT_TRUE(thrdpool_init_impl(&pool.d_pool, nworkers, &attr));
+}
+
+static void sleep_ms(long ms) {
+    nanosleep(&(struct timespec) { .tv_sec = 0, .tv_nsec = ms * 1000000l }, 0);
+}
+
+void read_once(void *arg) {
+    char c;
+    TEST_ASSERT_EQUAL_INT(1, read(*(int *)arg, &c, 1u));
+    TEST_ASSERT_TRUE(watch.revents & EPOLLIN);
+    atomic_store(&nread, (unsigned)c);
+    thrdpool_group_done(&group);
+}
+
+/* Read a byte at a time, arming the watch again until all have been read */
+void read_all(void *arg) {
+    char c;
+    TEST_ASSERT_EQUAL_INT(1, read(*(int *)arg, &c, 1u));
+    if(atomic_fetch_add(&nread, 1u) + 1u < NMESSAGES) {
+        TEST_ASSERT_TRUE(thrdpool_watch_fd(&pool, &watch, *(int *)arg, EPOLLIN, read_all, arg));
+    }
+    else {
+        thrdpool_group_done(&group);
+    }
+}
+
+void run(void *arg) {
+    (void)arg;
+    atomic_fetch_add(&nran, 1u);
+}
+
+void test_watch_pipe(void) {
+    for(unsigned i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        init_pool(scheds[i], 2u);
+        TEST_ASSERT_EQUAL_INT(0, pipe(fds));
+        /* Give the workers time to park before any watch is armed */
+        sleep_ms(10);
+
+        thrdpool_group_add(&group, 1u);
+        TEST_ASSERT_TRUE(thrdpool_watch_fd(&pool, &watch, fds[0], EPOLLIN, read_once, &fds[0]));
+        TEST_ASSERT_FALSE(thrdpool_watch_fd(&pool, &watch, fds[0], EPOLLIN, read_once, &fds[0]));
+        sleep_ms(10);
+        TEST_ASSERT_EQUAL_UINT32(0u, atomic_load(&nread));
+
+        TEST_ASSERT_EQUAL_INT(1, write(fds[1], "x", 1u));
+        thrdpool_group_wait(&group);
+        TEST_ASSERT_EQUAL_UINT32('x', atomic_load(&nread));
+        TEST_ASSERT_FALSE(thrdpool_unwatch_fd(&pool, &watch));
+
+        TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+        close(fds[0]);
+        close(fds[1]);
+        atomic_store(&nread, 0u);
+    }
+}
+
+void test_watch_socketpair_rearm(void) {
+    char buf[NMESSAGES] = { 0 };
+
+    for(unsigned i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        init_pool(scheds[i], 2u);
+        TEST_ASSERT_EQUAL_INT(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+
+        thrdpool_group_add(&group, 1u);
+        TEST_ASSERT_TRUE(thrdpool_watch_fd(&pool, &watch, fds[0], EPOLLIN, read_all, &fds[0]));
+        /* Left unread is reported again once the watch is armed anew */
+        TEST_ASSERT_EQUAL_INT(NMESSAGES / 2u, write(fds[1], buf, NMESSAGES / 2u));
+        sleep_ms(1);
+        TEST_ASSERT_EQUAL_INT(NMESSAGES / 2u, write(fds[1], buf, NMESSAGES / 2u));
+        thrdpool_group_wait(&group);
+        TEST_ASSERT_EQUAL_UINT32(NMESSAGES, atomic_load(&nread));
+
+        TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+        close(fds[0]);
+        close(fds[1]);
+        thrdpool_watch_init(&watch);
+        atomic_store(&nread, 0u);
+    }
+}
+
+void test_watch_unwatch(void) {
+    init_pool(THRDPOOL_SCHED_SHARED, 2u);
+    TEST_ASSERT_EQUAL_INT(0, pipe(fds));
+
+    TEST_ASSERT_TRUE(thrdpool_watch_fd(&pool, &watch, fds[0], EPOLLIN, read_once, &fds[0]));
+    TEST_ASSERT_TRUE(thrdpool_unwatch_fd(&pool, &watch));
+    TEST_ASSERT_FALSE(thrdpool_unwatch_fd(&pool, &watch));
+
+    TEST_ASSERT_EQUAL_INT(1, write(fds[1], "x", 1u));
+    sleep_ms(10);
+    TEST_ASSERT_EQUAL_UINT32(0u, atomic_load(&nread));
+
+    TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+    close(fds[0]);
+    close(fds[1]);
+}
+
+void test_watch_leader_runs_tasks(void) {
+    for(unsigned i = 0u; i < thrdpool_arrsize(scheds); i++) {
+        init_pool(scheds[i], 1u);
+        TEST_ASSERT_EQUAL_INT(0, pipe(fds));
+
+        /* The only worker is left polling an fd that never becomes ready, tasks scheduled
+         * meanwhile must interrupt it */
+        TEST_ASSERT_TRUE(thrdpool_watch_fd(&pool, &watch, fds[0], EPOLLIN, read_once, &fds[0]));
+        for(unsigned j = 0u; j < NMESSAGES; j++) {
+            sleep_ms(j % 10u == 0u);
+            TEST_ASSERT_TRUE(thrdpool_schedule_group_wait(&pool, &group, run, 0));
+            thrdpool_group_wait(&group);
+        }
+        TEST_ASSERT_EQUAL_UINT32(NMESSAGES, atomic_load(&nran));
+        TEST_ASSERT_TRUE(thrdpool_unwatch_fd(&pool, &watch));
+
+        TEST_ASSERT_TRUE(thrdpool_destroy(&pool));
+        close(fds[0]);
+        close(fds[1]);
+        thrdpool_watch_init(&watch);
+        atomic_store(&nran, 0u);
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef DEQUE_H
+#define DEQUE_H
+
+#include "task.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifndef THRDPOOL_DEQUE_CAPACITY
+#define THRDPOOL_DEQUE_CAPACITY 128u
+#endif
+
+_Static_assert((THRDPOOL_DEQUE_CAPACITY & (THRDPOOL_DEQUE_CAPACITY - 1u)) == 0u,
+               "THRDPOOL_DEQUE_CAPACITY must be a power of 2");
+
+#define thrdpool_deque_mod_size(x) ((size_t)(x) & (THRDPOOL_DEQUE_CAPACITY - 1u))
+
+#define THRDPOOL_TASK_WORDS \
+    ((sizeof(struct thrdpool_task) + sizeof(uintptr_t) - 1u) / sizeof(uintptr_t))
+
+/* Slots are read speculatively by thieves that may lose the race for them,
+ * so they are stored word by word using relaxed atomics */
+struct thrdpool_deque_slot {
+    atomic_uintptr_t words[THRDPOOL_TASK_WORDS];
+};
+
+/* Bounded Chase-Lev deque. The owning worker pushes and pops at the bottom,
+ * any other thread may steal from the top. */
+struct thrdpool_deque {
+    _Alignas(THRDPOOL_CACHELINE_SIZE) atomic_ptrdiff_t top;
+    _Alignas(THRDPOOL_CACHELINE_SIZE) atomic_ptrdiff_t bottom;
+    _Alignas(THRDPOOL_CACHELINE_SIZE) struct thrdpool_deque_slot slots[THRDPOOL_DEQUE_CAPACITY];
+};
+
+void thrdpool_deque_init(struct thrdpool_deque *dq);
+
+/* Owner only */
+bool thrdpool_deque_push(struct thrdpool_deque *dq, struct thrdpool_task const *task);
+/* Owner only */
+bool thrdpool_deque_pop(struct thrdpool_deque *dq, struct thrdpool_task *task);
+/* Any thread. Fails if the deque is empty or if the race for the top task is lost */
+bool thrdpool_deque_steal(struct thrdpool_deque *dq, struct thrdpool_task *task);
+
+inline void thrdpool_deque_slot_store(struct thrdpool_deque_slot *slot, struct thrdpool_task const *task) {
+    uintptr_t words[THRDPOOL_TASK_WORDS] = { 0u };
+    memcpy(words, task, sizeof(*task));
+    for(size_t i = 0u; i < THRDPOOL_TASK_WORDS; i++) {
+        atomic_store_explicit(&slot->words[i], words[i], memory_order_relaxed);
+    }
+}
+
+inline void thrdpool_deque_slot_load(struct thrdpool_deque_slot *slot, struct thrdpool_task *task) {
+    uintptr_t words[THRDPOOL_TASK_WORDS];
+    for(size_t i = 0u; i < THRDPOOL_TASK_WORDS; i++) {
+        words[i] = atomic_load_explicit(&slot->words[i], memory_order_relaxed);
+    }
+    memcpy(task, words, sizeof(*task));
+}
+
+/* Exact only when the deque is quiescent */
+inline size_t thrdpool_deque_size(struct thrdpool_deque *dq) {
+    ptrdiff_t b = atomic_load(&dq->bottom);
+    ptrdiff_t t = atomic_load(&dq->top);
+    return b > t ? (size_t)(b - t) : 0u;
+}
+
+#endif /* DEQUE_H */
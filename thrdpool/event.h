@@ -0,0 +1,58 @@
+#ifndef EVENT_H
+#define EVENT_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <time.h>
+
+/* Eventcount on top of a futex. A waiter announces itself with thrdpool_event_prepare,
+ * checks its condition and then either cancels or commits to waiting with the key
+ * returned. A notifier makes the condition true and only calls thrdpool_event_notify
+ * if thrdpool_event_waiters is non-zero, so notifying costs no syscall unless someone is
+ * about to sleep. Waiters and notifiers both modify nwaiters, and either the notifier
+ * sees the waiter or the waiter's check sees the condition through the order of those
+ * modifications. Being plain atomic operations rather than fences, the sanitizer build
+ * checks this as well */
+struct thrdpool_event {
+    /* Bumped on each notification, the futex word */
+    atomic_uint seq;
+    atomic_uint nwaiters;
+};
+
+void thrdpool_event_init(struct thrdpool_event *ev);
+
+/* Sleep until notified after key was returned by thrdpool_event_prepare, or for at most
+ * timeout unless it is null. May return spuriously, the condition must be checked again
+ * after calling prepare anew. Returns false if the timeout expired */
+bool thrdpool_event_wait(struct thrdpool_event *ev, unsigned key, struct timespec const *timeout);
+
+/* Wake up to n waiters */
+void thrdpool_event_notify(struct thrdpool_event *ev, size_t n);
+
+/* The condition may be checked using relaxed loads after this returns */
+inline unsigned thrdpool_event_prepare(struct thrdpool_event *ev) {
+    /* Acquires the condition from notifiers whose thrdpool_event_waiters came before */
+    atomic_fetch_add(&ev->nwaiters, 1u);
+    return atomic_load(&ev->seq);
+}
+
+inline void thrdpool_event_cancel(struct thrdpool_event *ev) {
+    atomic_fetch_sub(&ev->nwaiters, 1u);
+}
+
+/* Whether the event was notified since key was returned by thrdpool_event_prepare, for
+ * waiters that sleep on something other than the futex. Such a waiter must make itself
+ * visible to notifiers before checking */
+inline bool thrdpool_event_signaled(struct thrdpool_event *ev, unsigned key) {
+    return atomic_load(&ev->seq) != key;
+}
+
+/* Threads that are waiting or about to. Read-modify-write rather than a load so that
+ * it is ordered after the waiters' announcements, or they after it */
+inline unsigned thrdpool_event_waiters(struct thrdpool_event *ev) {
+    return atomic_fetch_add(&ev->nwaiters, 0u);
+}
+
+#endif /* EVENT_H */
@@ -0,0 +1,52 @@
+#ifndef FIBER_H
+#define FIBER_H
+
+#include "group.h"
+#include "task.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Usable stack of each fiber, a guard page is mapped below it */
+#ifndef THRDPOOL_FIBER_STACK_SIZE
+#define THRDPOOL_FIBER_STACK_SIZE 262144u
+#endif
+
+/* Finished fibers kept by each thread for reuse */
+#ifndef THRDPOOL_FIBER_CACHE
+#define THRDPOOL_FIBER_CACHE 16u
+#endif
+
+_Static_assert(THRDPOOL_FIBER_STACK_SIZE >= 16384u, "THRDPOOL_FIBER_STACK_SIZE must be at least 16 KiB");
+
+struct thrdpool;
+struct thrdpool_fiber;
+
+#define thrdpool_schedule_fiber(u, func, args)  \
+    thrdpool_schedule_fiber_impl(&(u)->d_pool, 0, func, args)
+
+#define thrdpool_schedule_fiber_group(u, g, func, args) \
+    thrdpool_schedule_fiber_impl(&(u)->d_pool, g, func, args)
+
+/* Schedule task to run on a stack of its own, letting it suspend with thrdpool_yield and
+ * thrdpool_await without holding on to a worker. The group, if any, is done once the
+ * task has returned rather than when it first suspends. Falls back to running the task
+ * on the worker's stack if no stack could be mapped */
+bool thrdpool_schedule_fiber_impl(struct thrdpool *pool, struct thrdpool_group *group, thrdpool_taskhandle task, void *args);
+
+/* Suspend the calling fiber, moving it to the back of the queue. Returns false without
+ * suspending if not called from a fiber */
+bool thrdpool_yield(void);
+
+/* Wait for all tasks in group to finish. A fiber is suspended until then, leaving its
+ * worker free to run other tasks, and may be resumed by any worker of the pool. Equivalent
+ * to thrdpool_group_wait if not called from a fiber */
+void thrdpool_await(struct thrdpool_group *group);
+
+/* Resume the fibers linked through their next pointers, called by thrdpool_group_done */
+void thrdpool_fiber_wake(struct thrdpool_fiber *fibers);
+
+/* Unmap the fibers cached by the calling thread */
+void thrdpool_fiber_cleanup(void);
+
+#endif /* FIBER_H */
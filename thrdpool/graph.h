@@ -0,0 +1,92 @@
+#ifndef GRAPH_H
+#define GRAPH_H
+
+#include "group.h"
+#include "task.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+struct thrdpool;
+struct thrdpool_graph;
+struct thrdpool_edge;
+
+struct thrdpool_node {
+    thrdpool_taskhandle handle;
+    void *args;
+    struct thrdpool_graph *graph;
+    /* Outgoing edges */
+    struct thrdpool_edge *succs;
+    /* Number of incoming edges */
+    size_t npreds;
+    /* Predecessors yet to finish in the current run */
+    atomic_size_t pending;
+};
+
+struct thrdpool_edge {
+    struct thrdpool_node *to;
+    struct thrdpool_edge *next;
+};
+
+/* Directed acyclic graph of tasks. A node is scheduled once all of its predecessors
+ * have finished. Nodes and edges are stored in arrays provided on initialization */
+struct thrdpool_graph {
+    /* Pool the graph was last submitted to */
+    struct thrdpool *pool;
+    /* Node tasks queued or running */
+    struct thrdpool_group group;
+    struct thrdpool_node *nodes;
+    size_t nnodes;
+    size_t nodecap;
+    struct thrdpool_edge *edges;
+    size_t nedges;
+    size_t edgecap;
+};
+
+#define thrdpool_graph_decl(name, maxnodes, maxedges)   \
+    struct {                                            \
+        struct thrdpool_graph d_graph;                  \
+        struct thrdpool_node d_nodes[maxnodes];         \
+        struct thrdpool_edge d_edges[maxedges];         \
+    } name
+
+#define thrdpool_graph_init(g)                                                      \
+    thrdpool_graph_init_impl(&(g)->d_graph, (g)->d_nodes,                           \
+                             sizeof((g)->d_nodes) / sizeof((g)->d_nodes[0]),        \
+                             (g)->d_edges, sizeof((g)->d_edges) / sizeof((g)->d_edges[0]))
+
+#define thrdpool_graph_destroy(g)                   \
+    thrdpool_graph_destroy_impl(&(g)->d_graph)
+
+#define thrdpool_graph_node(g, func, args)          \
+    thrdpool_graph_node_impl(&(g)->d_graph, func, args)
+
+#define thrdpool_graph_edge(g, from, to)            \
+    thrdpool_graph_edge_impl(&(g)->d_graph, from, to)
+
+#define thrdpool_graph_submit(u, g)                 \
+    thrdpool_graph_submit_impl(&(u)->d_pool, &(g)->d_graph)
+
+#define thrdpool_graph_wait(g)                      \
+    thrdpool_graph_wait_impl(&(g)->d_graph)
+
+bool thrdpool_graph_init_impl(struct thrdpool_graph *graph, struct thrdpool_node *nodes, size_t nodecap,
+                              struct thrdpool_edge *edges, size_t edgecap);
+
+bool thrdpool_graph_destroy_impl(struct thrdpool_graph *graph);
+
+/* Add a node running handle with args, returns null if the graph is full */
+struct thrdpool_node *thrdpool_graph_node_impl(struct thrdpool_graph *graph, thrdpool_taskhandle handle, void *args);
+
+/* Make to depend on from, returns false if the graph is out of edges */
+bool thrdpool_graph_edge_impl(struct thrdpool_graph *graph, struct thrdpool_node *from, struct thrdpool_node *to);
+
+/* Schedule the nodes without predecessors. Fails if the graph is still running or if
+ * the pool was destroyed while waiting for room in the queue */
+bool thrdpool_graph_submit_impl(struct thrdpool *pool, struct thrdpool_graph *graph);
+
+/* Block until no node of the graph is queued or running */
+void thrdpool_graph_wait_impl(struct thrdpool_graph *graph);
+
+#endif /* GRAPH_H */
@@ -0,0 +1,41 @@
+#ifndef GROUP_H
+#define GROUP_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <pthread.h>
+
+struct thrdpool_fiber;
+
+void thrdpool_fiber_wake(struct thrdpool_fiber *fibers);
+
+/* Tracks completion of a set of tasks */
+struct thrdpool_group {
+    atomic_size_t pending;
+    pthread_mutex_t lock;
+    pthread_cond_t cv;
+    /* Fibers suspended in thrdpool_await, guarded by lock */
+    struct thrdpool_fiber *fibers;
+};
+
+bool thrdpool_group_init(struct thrdpool_group *group);
+bool thrdpool_group_destroy(struct thrdpool_group *group);
+
+/* Block until all tasks in the group have finished */
+void thrdpool_group_wait(struct thrdpool_group *group);
+
+/* Mark one task in the group as finished */
+void thrdpool_group_done(struct thrdpool_group *group);
+
+/* Add ntasks tasks to the group, must be done before they are scheduled */
+inline void thrdpool_group_add(struct thrdpool_group *group, size_t ntasks) {
+    atomic_fetch_add_explicit(&group->pending, ntasks, memory_order_relaxed);
+}
+
+inline size_t thrdpool_group_pending(struct thrdpool_group *group) {
+    return atomic_load(&group->pending);
+}
+
+#endif /* GROUP_H */
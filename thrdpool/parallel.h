@@ -0,0 +1,34 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Default number of chunks per participating thread when no grain size is given */
+#ifndef THRDPOOL_PARALLEL_CHUNKS
+#define THRDPOOL_PARALLEL_CHUNKS 8u
+#endif
+
+/* Max size of the accumulator of a reduction */
+#ifndef THRDPOOL_REDUCE_SIZE
+#define THRDPOOL_REDUCE_SIZE 64u
+#endif
+
+typedef void(*thrdpool_rangehandle)(size_t, size_t, void *);
+typedef void(*thrdpool_foldhandle)(size_t, size_t, void *, void *);
+typedef void(*thrdpool_combinehandle)(void *, void const *, void *);
+
+struct thrdpool;
+
+#define thrdpool_parallel_for(u, begin, end, grain, func, ctx)  \
+    thrdpool_parallel_for_impl(&(u)->d_pool, begin, end, grain, func, ctx)
+
+#define thrdpool_parallel_reduce(u, begin, end, grain, result, identity, fold, combine, ctx)    \
+    thrdpool_parallel_reduce_impl(&(u)->d_pool, begin, end, grain, result, identity,            \
+                                  sizeof(*(result)), fold, combine, ctx)
+
+void thrdpool_parallel_for_impl(struct thrdpool *pool, size_t begin, size_t end, size_t grain, thrdpool_rangehandle func, void *ctx);
+
+bool thrdpool_parallel_reduce_impl(struct thrdpool *pool, size_t begin, size_t end, size_t grain, void *result, void const *identity, size_t size, thrdpool_foldhandle fold, thrdpool_combinehandle combine, void *ctx);
+
+#endif /* PARALLEL_H */
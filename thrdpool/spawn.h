@@ -0,0 +1,35 @@
+#ifndef SPAWN_H
+#define SPAWN_H
+
+#include "group.h"
+#include "task.h"
+
+#include <stdbool.h>
+
+/* Times a worker in thrdpool_sync yields the CPU when it finds nothing to run before
+ * blocking until the group is done */
+#ifndef THRDPOOL_SYNC_YIELDS
+#define THRDPOOL_SYNC_YIELDS 16u
+#endif
+
+struct thrdpool;
+
+#define thrdpool_spawn(u, g, func, args)            \
+    thrdpool_spawn_impl(&(u)->d_pool, g, func, args)
+
+#define thrdpool_sync(u, g)                         \
+    thrdpool_sync_impl(&(u)->d_pool, g)
+
+/* Schedule task as a child of the caller, tracked by group. Called from a worker, the
+ * task runs next on the same worker unless stolen or displaced by another spawn, and is
+ * run on the spot if the queue is full. Fails only if called from outside the pool and
+ * the pool was destroyed while waiting for room in the queue */
+bool thrdpool_spawn_impl(struct thrdpool *pool, struct thrdpool_group *group, thrdpool_taskhandle task, void *args);
+
+/* Wait for all tasks in group to finish. A worker of pool runs pending tasks, its own
+ * children first, for as long as there are any, so that waiting never ties up a worker
+ * the children need. Only once there is nothing left to run does it block, as if between
+ * thrdpool_blocking_begin and thrdpool_blocking_end */
+void thrdpool_sync_impl(struct thrdpool *pool, struct thrdpool_group *group);
+
+#endif /* SPAWN_H */
@@ -0,0 +1,89 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "task.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Number of buckets in the latency histograms. Bucket i counts durations in
+ * [2^i, 2^(i + 1)) ns, the first bucket also counts 0 ns and the last one
+ * everything that does not fit in the others */
+#ifndef THRDPOOL_STATS_BUCKETS
+#define THRDPOOL_STATS_BUCKETS 32u
+#endif
+
+_Static_assert(THRDPOOL_STATS_BUCKETS >= 1u && THRDPOOL_STATS_BUCKETS <= 64u,
+               "THRDPOOL_STATS_BUCKETS must be in the range [1, 64]");
+
+struct thrdpool;
+
+/* Snapshot of the statistics of a worker, or the sum of those of all workers */
+struct thrdpool_stats {
+    uint64_t executed;
+    uint64_t steals;
+    /* Tasks that did not fit in the task queue, counted for the pool as a whole */
+    uint64_t rejected;
+    uint64_t busy_ns;
+    uint64_t idle_ns;
+    /* Time from being queued until started */
+    uint64_t wait[THRDPOOL_STATS_BUCKETS];
+    /* Time spent running */
+    uint64_t run[THRDPOOL_STATS_BUCKETS];
+};
+
+#ifdef THRDPOOL_STATS
+
+/* Written by the owning worker only, so no read-modify-write is needed */
+struct thrdpool_counters {
+    _Alignas(THRDPOOL_CACHELINE_SIZE) atomic_uint_least64_t executed;
+    atomic_uint_least64_t steals;
+    atomic_uint_least64_t busy_ns;
+    atomic_uint_least64_t idle_ns;
+    atomic_uint_least64_t wait[THRDPOOL_STATS_BUCKETS];
+    atomic_uint_least64_t run[THRDPOOL_STATS_BUCKETS];
+};
+
+void thrdpool_counters_init(struct thrdpool_counters *counters);
+
+/* Monotonic time in ns */
+uint64_t thrdpool_stats_now(void);
+
+inline void thrdpool_counter_add(atomic_uint_least64_t *counter, uint64_t n) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+#endif
+
+#define thrdpool_stats(u, stats)                    \
+    thrdpool_stats_impl(&(u)->d_pool, stats)
+
+#define thrdpool_worker_stats(u, worker, stats)     \
+    thrdpool_worker_stats_impl(&(u)->d_pool, worker, stats)
+
+/* Sum the statistics of all workers. Returns false, and zeroes stats, if the library
+ * was built without THRDPOOL_STATS */
+bool thrdpool_stats_impl(struct thrdpool *pool, struct thrdpool_stats *stats);
+
+/* Statistics of a single worker, rejected is always 0 */
+bool thrdpool_worker_stats_impl(struct thrdpool *pool, size_t worker, struct thrdpool_stats *stats);
+
+/* Upper bound of the bucket containing quantile q in [0, 1] of a histogram, in ns.
+ * UINT64_MAX if it is the last one, 0 if the histogram is empty */
+uint64_t thrdpool_stats_quantile(uint64_t const *hist, double q);
+
+inline size_t thrdpool_stats_bucket(uint64_t ns) {
+#ifdef __GNUC__
+    size_t bucket = ns ? 63u - (size_t)__builtin_clzll(ns) : 0u;
+#else
+    size_t bucket = 0u;
+    while(ns >>= 1u) {
+        ++bucket;
+    }
+#endif
+    return bucket < THRDPOOL_STATS_BUCKETS ? bucket : THRDPOOL_STATS_BUCKETS - 1u;
+}
+
+#endif /* STATS_H */
@@ -0,0 +1,86 @@
+#ifndef STRAND_H
+#define STRAND_H
+
+#include "group.h"
+#include "task.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <pthread.h>
+
+/* Max number of tasks of a strand run in a row before it goes to the back of the queue */
+#ifndef THRDPOOL_STRAND_BATCH
+#define THRDPOOL_STRAND_BATCH 16u
+#endif
+
+_Static_assert(THRDPOOL_STRAND_BATCH >= 1u, "THRDPOOL_STRAND_BATCH must be positive");
+
+struct thrdpool;
+
+/* Runs the tasks posted to it one at a time in the order they were posted. While any
+ * are pending, a single task draining them is queued in or running on the pool. Tasks
+ * are stored in the ring provided on initialization */
+struct thrdpool_strand {
+    /* Guards everything below, held only while the ring is modified */
+    pthread_mutex_t lock;
+    /* Pool the draining task was last scheduled on */
+    struct thrdpool *pool;
+    struct thrdpool_task *tasks;
+    size_t capacity;
+    size_t start;
+    size_t size;
+    /* Draining task queued or running */
+    bool active;
+};
+
+#define thrdpool_strand_decl(name, cap)             \
+    struct {                                        \
+        struct thrdpool_strand d_strand;            \
+        struct thrdpool_task d_tasks[cap];          \
+    } name
+
+#define thrdpool_strand_init(s)                                                     \
+    thrdpool_strand_init_impl(&(s)->d_strand, (s)->d_tasks,                         \
+                              sizeof((s)->d_tasks) / sizeof((s)->d_tasks[0]))
+
+#define thrdpool_strand_destroy(s)                  \
+    thrdpool_strand_destroy_impl(&(s)->d_strand)
+
+#define thrdpool_strand_post(u, s, fn, arg)                         \
+    thrdpool_strand_post_impl(&(u)->d_pool, &(s)->d_strand,         \
+                              &(struct thrdpool_task) {             \
+                                  .handle = fn,                     \
+                                  .args = arg                       \
+                              })
+
+#define thrdpool_strand_post_group(u, s, g, fn, arg)                \
+    thrdpool_strand_post_impl(&(u)->d_pool, &(s)->d_strand,         \
+                              &(struct thrdpool_task) {             \
+                                  .handle = fn,                     \
+                                  .args = arg,                      \
+                                  .group = g                        \
+                              })
+
+#define thrdpool_strand_pending(s)                  \
+    thrdpool_strand_pending_impl(&(s)->d_strand)
+
+bool thrdpool_strand_init_impl(struct thrdpool_strand *strand, struct thrdpool_task *tasks, size_t capacity);
+
+/* Fails if tasks are still pending */
+bool thrdpool_strand_destroy_impl(struct thrdpool_strand *strand);
+
+/* Append task to the strand, scheduling its draining task on pool unless already queued
+ * or running. Fails without blocking if the ring is full, and if the pool was destroyed
+ * while waiting for room in its queue, in which case tasks posted meanwhile are discarded */
+bool thrdpool_strand_post_impl(struct thrdpool *pool, struct thrdpool_strand *strand, struct thrdpool_task const *task);
+
+/* Tasks posted but not yet started */
+size_t thrdpool_strand_pending_impl(struct thrdpool_strand *strand);
+
+/* Called for each task the pool discards. If task is the draining task of a strand, the
+ * tasks of the strand are discarded along with it and it is left inactive. Returns
+ * whether task was such a draining task */
+bool thrdpool_strand_discard_internal(struct thrdpool_task const *task);
+
+#endif /* STRAND_H */
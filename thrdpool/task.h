@@ -1,15 +1,60 @@
 #ifndef TASK_H
 #define TASK_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef THRDPOOL_CACHELINE_SIZE
+#define THRDPOOL_CACHELINE_SIZE 64u
+#endif
+
+/* Max size of arguments copied into the task itself, the default makes a task fill a
+ * 64-byte cache line on LP64 unless built with THRDPOOL_STATS or THRDPOOL_TRACE */
+#ifndef THRDPOOL_TASK_INLINE_SIZE
+#define THRDPOOL_TASK_INLINE_SIZE 40u
+#endif
+
+_Static_assert(THRDPOOL_TASK_INLINE_SIZE > 0u, "THRDPOOL_TASK_INLINE_SIZE must be positive");
+
 typedef void(*thrdpool_taskhandle)(void *);
 
+struct thrdpool_group;
+
+void thrdpool_group_done(struct thrdpool_group *group);
+
 struct thrdpool_task {
+    union {
+        void *args;
+        /* Copy of the arguments if inlined is set, suitably aligned for pointers and
+         * 64-bit integers */
+        _Alignas(void *) _Alignas(uint64_t) unsigned char data[THRDPOOL_TASK_INLINE_SIZE];
+    };
     thrdpool_taskhandle handle;
-    void *args;
+    /* Group notified once the task has finished, if any */
+    struct thrdpool_group *group;
+    /* The handle is passed a pointer to data rather than args */
+    bool inlined;
+#ifdef THRDPOOL_STATS
+    /* Time the task was queued, set by the pool */
+    uint64_t enqueued;
+#endif
+#ifdef THRDPOOL_TRACE
+    /* Identifies the task in traces, 0 if it was never queued */
+    uint64_t traceid;
+#endif
 };
 
+/* Argument passed to the handle of task. Copied arguments live in the task itself, so
+ * they are only valid for as long as task is */
+inline void *thrdpool_task_args(struct thrdpool_task const *task) {
+    return task->inlined ? (void *)task->data : task->args;
+}
+
 inline void thrdpool_call(struct thrdpool_task const *task) {
-    task->handle(task->args);
+    task->handle(thrdpool_task_args(task));
+    if(task->group) {
+        thrdpool_group_done(task->group);
+    }
 }
 
 #endif /* TASK_H */
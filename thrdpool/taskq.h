@@ -7,6 +7,35 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+#ifdef THRDPOOL_TASKQ_LOCKFREE
+#include <stdatomic.h>
+#endif
+
+#if defined THRDPOOL_TASKQ_LOCKFREE && defined THRDPOOL_TASKQ_SEGMENTED
+#error "THRDPOOL_TASKQ_LOCKFREE and THRDPOOL_TASKQ_SEGMENTED are mutually exclusive"
+#endif
+
+#ifdef THRDPOOL_TASKQ_SEGMENTED
+
+#include <stdint.h>
+
+/* Unbounded unless overridden */
+#ifndef THRDPOOL_TASKQ_CAPACITY
+#define THRDPOOL_TASKQ_CAPACITY SIZE_MAX
+#endif
+
+/* Number of tasks per segment */
+#ifndef THRDPOOL_TASKQ_SEGMENT_SIZE
+#define THRDPOOL_TASKQ_SEGMENT_SIZE 64u
+#endif
+
+/* Max number of drained segments kept around for reuse */
+#ifndef THRDPOOL_TASKQ_SPARE_SEGMENTS
+#define THRDPOOL_TASKQ_SPARE_SEGMENTS 4u
+#endif
+
+#endif
+
 #ifndef THRDPOOL_TASKQ_CAPACITY
 #define THRDPOOL_TASKQ_CAPACITY 32u
 #endif
@@ -23,6 +52,54 @@
 
 #define thrdpool_arrsize(x) (sizeof(x) / sizeof((x)[0]))
 
+#ifdef THRDPOOL_TASKQ_LOCKFREE
+
+/* Bounded MPMC queue. Position i is written on lap i / capacity, a slot's turn
+ * is 2 * lap while waiting for a producer and 2 * lap + 1 while waiting for a
+ * consumer. This allows zero-initialization of the entire queue. */
+struct thrdpool_taskq_slot {
+    _Alignas(THRDPOOL_CACHELINE_SIZE) atomic_size_t turn;
+    struct thrdpool_task task;
+};
+
+struct thrdpool_taskq {
+    _Alignas(THRDPOOL_CACHELINE_SIZE) atomic_size_t start;
+    _Alignas(THRDPOOL_CACHELINE_SIZE) atomic_size_t end;
+    struct thrdpool_taskq_slot tasks[THRDPOOL_TASKQ_CAPACITY];
+};
+
+#define thrdpool_taskq_init() (struct thrdpool_taskq) { .start = 0u, .end = 0u }
+
+#define thrdpool_taskq_lap(x) ((x) / THRDPOOL_TASKQ_CAPACITY)
+
+#elif defined THRDPOOL_TASKQ_SEGMENTED
+
+struct thrdpool_taskq_segment {
+    struct thrdpool_taskq_segment *next;
+    struct thrdpool_task tasks[THRDPOOL_TASKQ_SEGMENT_SIZE];
+};
+
+/* Linked list of fixed-size segments, grown as needed. Tasks are pushed to the
+ * tail segment and popped from the head one. Drained segments are put on a free
+ * list so that a queue whose backlog stays put does not allocate any memory */
+struct thrdpool_taskq {
+    struct thrdpool_taskq_segment *head;
+    struct thrdpool_taskq_segment *tail;
+    struct thrdpool_taskq_segment *spare;
+    /* Index of the first task in head */
+    size_t start;
+    /* Index one past the last task in tail */
+    size_t end;
+    size_t size;
+    size_t nspare;
+    /* Segments currently allocated, including spare ones */
+    size_t nsegments;
+};
+
+#define thrdpool_taskq_init() (struct thrdpool_taskq) { .head = 0, .tail = 0, .spare = 0 }
+
+#else
+
 struct thrdpool_taskq {
     size_t start;
     size_t size;
@@ -31,8 +108,64 @@ struct thrdpool_taskq {
 
 #define thrdpool_taskq_init() (struct thrdpool_taskq) { .start = 0u, .size = 0u }
 
+#endif
+
 bool thrdpool_taskq_push(struct thrdpool_taskq *restrict q, thrdpool_taskhandle task, void *args);
+bool thrdpool_taskq_pop(struct thrdpool_taskq *restrict q, struct thrdpool_task *task);
+/* Push as many of the ntasks tasks as there is room for, returns the number pushed */
+size_t thrdpool_taskq_push_batch(struct thrdpool_taskq *restrict q, struct thrdpool_task const *restrict tasks, size_t ntasks);
+/* Pop up to ntasks tasks from the front of the queue, returns the number popped */
+size_t thrdpool_taskq_pop_batch(struct thrdpool_taskq *restrict q, struct thrdpool_task *restrict tasks, size_t ntasks);
 struct thrdpool_task *thrdpool_taskq_front(struct thrdpool_taskq *q);
+/* Release any memory held by the queue, remaining tasks are dropped */
+void thrdpool_taskq_destroy(struct thrdpool_taskq *q);
+
+#ifdef THRDPOOL_TASKQ_LOCKFREE
+
+inline size_t thrdpool_taskq_size(struct thrdpool_taskq const *q) {
+    /* Loading start first guarantees that end is never behind it */
+    size_t start = atomic_load(&q->start);
+    return atomic_load(&q->end) - start;
+}
+
+/* Consumer side of thrdpool_taskq_front, single consumer only */
+inline void thrdpool_taskq_pop_front(struct thrdpool_taskq *q) {
+    assert(thrdpool_taskq_size(q));
+    size_t start = atomic_fetch_add(&q->start, 1u);
+    atomic_store_explicit(&q->tasks[thrdpool_mod_size(start)].turn,
+                          thrdpool_taskq_lap(start) * 2u + 2u, memory_order_release);
+}
+
+/* Not safe with concurrent producers or consumers */
+inline void thrdpool_taskq_pop_back(struct thrdpool_taskq *q) {
+    assert(thrdpool_taskq_size(q));
+    size_t end = atomic_load(&q->end) - 1u;
+    atomic_store(&q->end, end);
+    atomic_store_explicit(&q->tasks[thrdpool_mod_size(end)].turn,
+                          thrdpool_taskq_lap(end) * 2u, memory_order_release);
+}
+
+inline void thrdpool_taskq_clear(struct thrdpool_taskq *q) {
+    struct thrdpool_task task;
+    while(thrdpool_taskq_pop(q, &task));
+}
+
+#elif defined THRDPOOL_TASKQ_SEGMENTED
+
+void thrdpool_taskq_pop_front(struct thrdpool_taskq *q);
+void thrdpool_taskq_pop_back(struct thrdpool_taskq *q);
+
+inline size_t thrdpool_taskq_size(struct thrdpool_taskq const *q) {
+    return q->size;
+}
+
+inline void thrdpool_taskq_clear(struct thrdpool_taskq *q) {
+    while(q->size) {
+        thrdpool_taskq_pop_front(q);
+    }
+}
+
+#else
 
 inline void thrdpool_taskq_pop_front(struct thrdpool_taskq *q) {
     assert(q->size);
@@ -54,4 +187,6 @@ inline void thrdpool_taskq_clear(struct thrdpool_taskq *q) {
     q->size = 0u;
 }
 
+#endif
+
 #endif /* TASKQ_H */
@@ -1,22 +1,250 @@
 #ifndef THRDPOOL_H
 #define THRDPOOL_H
 
+#include "deque.h"
+#include "event.h"
+#include "fiber.h"
+#include "graph.h"
+#include "group.h"
+#include "parallel.h"
+#include "spawn.h"
+#include "stats.h"
+#include "strand.h"
 #include "task.h"
 #include "taskq.h"
+#include "timer.h"
+#include "topology.h"
+#include "trace.h"
+#include "watch.h"
 
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #include <pthread.h>
+#include <time.h>
+
+/* Max number of tasks a worker may claim from the shared queue at a time */
+#ifndef THRDPOOL_BATCH_CAPACITY
+#define THRDPOOL_BATCH_CAPACITY 16u
+#endif
+
+/* Default number of tasks claimed at a time */
+#ifndef THRDPOOL_BATCH_SIZE
+#define THRDPOOL_BATCH_SIZE 1u
+#endif
+
+/* Default max time in ns an idle worker spins before yielding */
+#ifndef THRDPOOL_SPIN_NS
+#define THRDPOOL_SPIN_NS 0u
+#endif
+
+/* Default number of times an idle worker yields the CPU before parking */
+#ifndef THRDPOOL_SPIN_YIELDS
+#define THRDPOOL_SPIN_YIELDS 0u
+#endif
+
+/* Default number of queued tasks at which an elastic pool whose workers are all busy spawns another */
+#ifndef THRDPOOL_GROW_DEPTH
+#define THRDPOOL_GROW_DEPTH 16u
+#endif
+
+/* Default time in ns tasks may stay queued with all workers busy before an elastic pool spawns another */
+#ifndef THRDPOOL_GROW_NS
+#define THRDPOOL_GROW_NS 1000000u
+#endif
+
+/* Default time in ns surplus workers of an elastic pool stay parked before retiring */
+#ifndef THRDPOOL_KEEPALIVE_NS
+#define THRDPOOL_KEEPALIVE_NS 1000000000u
+#endif
+
+/* Default number of tasks a worker runs in a row from its next slot before the task in
+ * the slot is moved to the back of the queue */
+#ifndef THRDPOOL_NEXT_LIMIT
+#define THRDPOOL_NEXT_LIMIT 32u
+#endif
+
+_Static_assert(THRDPOOL_BATCH_SIZE >= 1u && THRDPOOL_BATCH_SIZE <= THRDPOOL_BATCH_CAPACITY,
+               "THRDPOOL_BATCH_SIZE must be in the range [1, THRDPOOL_BATCH_CAPACITY]");
+
+enum thrdpool_sched {
+    /* All workers share the pool's task queue */
+    THRDPOOL_SCHED_SHARED,
+    /* Workers own a deque each and steal from each other when they run dry,
+     * tasks scheduled from outside the pool go through the shared queue */
+    THRDPOOL_SCHED_STEAL
+};
+
+struct thrdpool_attr {
+    enum thrdpool_sched sched;
+    /* Number of tasks claimed from the shared queue at a time, at most THRDPOOL_BATCH_CAPACITY */
+    size_t batch;
+    enum thrdpool_affinity affinity;
+    /* CPUs to pin workers to with THRDPOOL_AFFINITY_LIST */
+    unsigned const *cpus;
+    size_t ncpus;
+    /* Keep one shared queue per NUMA node */
+    bool numa;
+    /* Machine to place workers on, discovered from /sys if null */
+    struct thrdpool_topology const *topology;
+    /* Max time in ns an idle worker polls for tasks before yielding, the actual
+     * time adapts to how long it usually takes for tasks to show up */
+    uint64_t spin;
+    /* Number of times an idle worker yields the CPU after spinning and before parking */
+    unsigned yields;
+    /* Workers kept running and max number of workers, both capped to the capacity of the
+     * pool. The pool is elastic if min is less than max */
+    size_t min;
+    size_t max;
+    /* Queued tasks at which an elastic pool spawns a worker if all are busy */
+    size_t growdepth;
+    /* Time in ns tasks may stay queued before an elastic pool spawns a worker if all are busy */
+    uint64_t growwait;
+    /* Time in ns a surplus worker of an elastic pool stays parked before retiring */
+    uint64_t keepalive;
+    /* Tasks a worker runs in a row from its next slot, 0 disables the slot */
+    unsigned nextlimit;
+};
+
+#define thrdpool_attr_init()                        \
+    (struct thrdpool_attr) {                        \
+        .sched = THRDPOOL_SCHED_SHARED,             \
+        .batch = THRDPOOL_BATCH_SIZE,               \
+        .affinity = THRDPOOL_AFFINITY_NONE,         \
+        .cpus = 0,                                  \
+        .ncpus = 0u,                                \
+        .numa = false,                              \
+        .topology = 0,                              \
+        .spin = THRDPOOL_SPIN_NS,                   \
+        .yields = THRDPOOL_SPIN_YIELDS,             \
+        .min = SIZE_MAX,                            \
+        .max = SIZE_MAX,                            \
+        .growdepth = THRDPOOL_GROW_DEPTH,           \
+        .growwait = THRDPOOL_GROW_NS,               \
+        .keepalive = THRDPOOL_KEEPALIVE_NS,         \
+        .nextlimit = THRDPOOL_NEXT_LIMIT            \
+    }
+
+struct thrdpool;
+
+/* States of the next slot of a worker. Only the worker fills the slot, which it does
+ * while it is empty, but any worker may take the task from it */
+enum thrdpool_next_state {
+    THRDPOOL_NEXT_EMPTY,
+    THRDPOOL_NEXT_FULL,
+    /* The task is being copied out of the slot */
+    THRDPOOL_NEXT_TAKING
+};
+
+struct thrdpool_worker {
+    pthread_t thrd;
+    struct thrdpool *pool;
+    unsigned seed;
+    /* CPU the worker is pinned to, -1 if none */
+    int cpu;
+    /* Shared queue the worker looks for tasks in first */
+    size_t node;
+    /* Current spin time in ns */
+    uint64_t spin;
+    /* Start of the current idle period if spinning is enabled, 0 otherwise */
+    uint64_t idlesince;
+    /* Counted in nspinning */
+    bool spinning;
+    /* Thread started and not yet joined */
+    bool joinable;
+    /* Depth of nested thrdpool_blocking_begin calls */
+    unsigned blocking;
+    /* Tasks claimed from the shared queue but not yet started */
+    atomic_size_t nclaimed;
+    /* Last task scheduled by the tasks the worker runs, run by the worker next unless
+     * taken by an idle worker first. Guarded by nextstate */
+    struct thrdpool_task next;
+    atomic_uint nextstate;
+    struct thrdpool_deque dq;
+#ifdef THRDPOOL_STATS
+    struct thrdpool_counters counters;
+#endif
+#ifdef THRDPOOL_TRACE
+    struct thrdpool_trace_ring trace;
+#endif
+};
 
 struct thrdpool {
-    bool join;
-    size_t size;
-    size_t idle;
-    pthread_cond_t cv;
+    atomic_bool join;
+    enum thrdpool_sched sched;
+    size_t batch;
+    /* Workers currently running, always the first size of them */
+    atomic_size_t size;
+    size_t min;
+    size_t max;
+    /* Length of workers, slots past max are used for spares */
+    size_t capacity;
+    /* Workers inside thrdpool_blocking_begin/end and spares running in their stead,
+     * modified with the lock held */
+    atomic_size_t nblocking;
+    atomic_size_t nspares;
+    size_t growdepth;
+    uint64_t growwait;
+    struct timespec keepalive;
+    unsigned nextlimit;
+    /* When tasks were first seen queued with all workers busy, 0 if not since a worker last went idle */
+    atomic_uint_least64_t backlogged;
+    atomic_size_t idle;
+    /* Workers polling for tasks instead of parking, producers need not wake anyone for them */
+    atomic_size_t nspinning;
+    uint64_t spin;
+    unsigned yields;
+    /* Producers waiting for room in the shared queue */
+    atomic_size_t nblocked;
+    /* Threads in thrdpool_wait_idle, protected by lock */
+    size_t nidlewaiters;
+    /* Parked workers */
+    struct thrdpool_event parked;
+    pthread_cond_t notfull;
+    pthread_cond_t quiescent;
     pthread_mutex_t lock;
-    struct thrdpool_taskq q;
-    pthread_t workers[];
+    /* Start of tick 0 of the timer wheel, in ns on the monotonic clock */
+    uint64_t timerbase;
+    /* Time in ns at which the timer wheel next needs turning, UINT64_MAX if no timers are armed */
+    atomic_uint_least64_t deadline;
+    /* Set while a parked worker waits for the deadline or for watched fds to become ready */
+    atomic_bool leader;
+    pthread_mutex_t timerlock;
+    struct thrdpool_timer_wheel timers;
+    /* Epoll instance of the watched fds, and an eventfd in it for interrupting the leader */
+    int epfd;
+    int wakefd;
+    /* Armed watches, modified with watchlock held */
+    atomic_size_t nwatches;
+    /* Set with watchlock held while the leader is in epoll_wait or has yet to handle
+     * what it returned, polled is signaled once it is cleared */
+    atomic_bool polling;
+    /* Times polling was cleared, guarded by watchlock */
+    size_t npolled;
+    pthread_mutex_t watchlock;
+    pthread_cond_t polled;
+    /* One shared queue per NUMA node, or a single one */
+    size_t nqueues;
+    struct thrdpool_taskq q[THRDPOOL_NUMA_NODES];
+#ifndef THRDPOOL_TASKQ_LOCKFREE
+    /* Tasks in the queues, for spinning workers that do not hold the lock */
+    atomic_size_t nqueued;
+#endif
+    /* Queue of the node each CPU belongs to */
+    unsigned char cpunode[THRDPOOL_MAX_CPUS];
+#ifdef THRDPOOL_STATS
+    _Alignas(THRDPOOL_CACHELINE_SIZE) atomic_uint_least64_t rejected;
+#endif
+#ifdef THRDPOOL_TRACE
+    /* Unique to each initialization of the pool */
+    uint64_t traceepoch;
+    /* Rings claimed by threads scheduling tasks from outside the pool */
+    atomic_size_t nproducers;
+    struct thrdpool_trace_ring producers[THRDPOOL_TRACE_PRODUCERS];
+#endif
+    struct thrdpool_worker workers[];
 };
 
 #define thrdpool_bytesize(capacity) \
@@ -28,18 +256,84 @@ struct thrdpool {
         struct thrdpool d_pool;                         \
     } name
 
+#define thrdpool_capacity(u)                        \
+    ((sizeof(*u) - sizeof((u)->d_pool)) / sizeof((u)->d_pool.workers[0]))
+
 #define thrdpool_init(u)                            \
-    thrdpool_init_impl(&(u)->d_pool, (sizeof(*u) - sizeof((u)->d_pool)) / sizeof(pthread_t))
+    thrdpool_init_impl(&(u)->d_pool, thrdpool_capacity(u), 0)
+
+#define thrdpool_init_attr(u, attr)                 \
+    thrdpool_init_impl(&(u)->d_pool, thrdpool_capacity(u), attr)
 
 #define thrdpool_schedule(u, func, args)            \
     thrdpool_schedule_impl(&(u)->d_pool, func, args)
 
+#define thrdpool_schedule_copy(u, func, args, size) \
+    thrdpool_schedule_copy_impl(&(u)->d_pool, func, args, size)
+
+#define thrdpool_schedule_wait(u, fn, arg)                          \
+    thrdpool_schedule_wait_impl(&(u)->d_pool,                       \
+                                &(struct thrdpool_task) {           \
+                                    .handle = fn,                   \
+                                    .args = arg                     \
+                                }, 0)
+
+#define thrdpool_schedule_timed(u, fn, arg, deadline)               \
+    thrdpool_schedule_wait_impl(&(u)->d_pool,                       \
+                                &(struct thrdpool_task) {           \
+                                    .handle = fn,                   \
+                                    .args = arg                     \
+                                }, deadline)
+
+#define thrdpool_schedule_group(u, g, fn, arg)                      \
+    (thrdpool_schedule_batch_impl(&(u)->d_pool,                     \
+                                  &(struct thrdpool_task) {         \
+                                      .handle = fn,                 \
+                                      .args = arg,                  \
+                                      .group = g                    \
+                                  }, 1u) == 1u)
+
+#define thrdpool_schedule_group_wait(u, g, fn, arg)                 \
+    thrdpool_schedule_wait_impl(&(u)->d_pool,                       \
+                                &(struct thrdpool_task) {           \
+                                    .handle = fn,                   \
+                                    .args = arg,                    \
+                                    .group = g                      \
+                                }, 0)
+
+#define thrdpool_schedule_batch(u, tasks, ntasks) \
+    thrdpool_schedule_batch_impl(&(u)->d_pool, tasks, ntasks)
+
+#define thrdpool_schedule_after(u, timer, delay, func, args)        \
+    thrdpool_schedule_after_impl(&(u)->d_pool, timer, delay, 0u, func, args)
+
+#define thrdpool_schedule_every(u, timer, period, func, args)       \
+    thrdpool_schedule_after_impl(&(u)->d_pool, timer, period, period, func, args)
+
+#define thrdpool_timer_cancel(u, timer)             \
+    thrdpool_timer_cancel_impl(&(u)->d_pool, timer)
+
+#define thrdpool_watch_fd(u, watch, fd, events, func, args)        \
+    thrdpool_watch_fd_impl(&(u)->d_pool, watch, fd, events, func, args)
+
+#define thrdpool_unwatch_fd(u, watch)               \
+    thrdpool_unwatch_fd_impl(&(u)->d_pool, watch)
+
 #define thrdpool_size(u)                            \
-    (u)->d_pool.size
+    atomic_load(&(u)->d_pool.size)
+
+#define thrdpool_max_workers(u)                     \
+    (u)->d_pool.capacity
 
 #define thrdpool_idle_workers(u)                    \
     thrdpool_idle_impl(&(u)->d_pool)
 
+#define thrdpool_worker_id(u)                       \
+    thrdpool_worker_id_impl(&(u)->d_pool)
+
+#define thrdpool_wait_idle(u)                       \
+    thrdpool_wait_idle_impl(&(u)->d_pool)
+
 #define thrdpool_pending(u)                         \
     thrdpool_pending_impl(&(u)->d_pool)
 
@@ -50,37 +344,69 @@ struct thrdpool {
     thrdpool_flush_impl(&(u)->d_pool)
 
 #define thrdpool_taskq_capacity(u)                  \
-    thrdpool_arrsize((u)->d_pool.q.tasks)
+    ((void)(u), (size_t)THRDPOOL_TASKQ_CAPACITY)
 
-bool thrdpool_init_impl(struct thrdpool *pool, size_t capacity);
+bool thrdpool_init_impl(struct thrdpool *pool, size_t capacity, struct thrdpool_attr const *attr);
 
 bool thrdpool_schedule_impl(struct thrdpool *pool, thrdpool_taskhandle task, void *args);
 
-inline size_t thrdpool_idle_impl(struct thrdpool *pool) {
-    size_t idle;
-    pthread_mutex_lock(&pool->lock);
-    idle = pool->idle;
-    pthread_mutex_unlock(&pool->lock);
-    return idle;
-}
+bool thrdpool_schedule_copy_impl(struct thrdpool *pool, thrdpool_taskhandle task, void const *args, size_t size);
+
+bool thrdpool_schedule_wait_impl(struct thrdpool *pool, struct thrdpool_task const *task, struct timespec const *deadline);
+
+size_t thrdpool_schedule_batch_impl(struct thrdpool *pool, struct thrdpool_task const *tasks, size_t ntasks);
+
+/* Arm timer to schedule task delay ns from now, and every period ns after that unless period is 0 */
+bool thrdpool_schedule_after_impl(struct thrdpool *pool, struct thrdpool_timer *timer, uint64_t delay, uint64_t period,
+                                  thrdpool_taskhandle task, void *args);
+
+bool thrdpool_timer_cancel_impl(struct thrdpool *pool, struct thrdpool_timer *timer);
+
+/* Arm watch to schedule task with args once fd is ready for any of events, given as
+ * epoll events. The watch fires once and is then disarmed, it may be armed again from
+ * its own task */
+bool thrdpool_watch_fd_impl(struct thrdpool *pool, struct thrdpool_watch *watch, int fd, uint32_t events,
+                            thrdpool_taskhandle task, void *args);
 
-inline size_t thrdpool_pending_impl(struct thrdpool *pool) {
-    size_t ntasks;
-    pthread_mutex_lock(&pool->lock);
-    ntasks = thrdpool_taskq_size(&pool->q);
-    pthread_mutex_unlock(&pool->lock);
-    return ntasks;
+/* Disarm watch and remove its fd from the pool's epoll instance. Returns false if the
+ * watch was not armed, in which case its task may still be queued or running */
+bool thrdpool_unwatch_fd_impl(struct thrdpool *pool, struct thrdpool_watch *watch);
+
+size_t thrdpool_worker_id_impl(struct thrdpool *pool);
+
+bool thrdpool_wait_idle_impl(struct thrdpool *pool);
+
+size_t thrdpool_pending_impl(struct thrdpool *pool);
+
+void thrdpool_flush_impl(struct thrdpool *pool);
+
+/* Mark the calling worker as about to block, letting its pool start a spare worker in its
+ * stead if there is room. No-op if not called from a worker. Calls may be nested */
+void thrdpool_blocking_begin(void);
+
+/* End the blocking section started by the matching thrdpool_blocking_begin. A spare
+ * started for it retires once idle */
+void thrdpool_blocking_end(void);
+
+/* Run a single pending task if called from one of pool's workers. Returns false
+ * if there was nothing to run or if the caller is not a worker of pool */
+bool thrdpool_help_internal(struct thrdpool *pool);
+
+/* Schedule the tasks, running those that do not fit in the queue on the spot rather than
+ * dropping them */
+void thrdpool_schedule_or_run_internal(struct thrdpool *pool, struct thrdpool_task const *tasks, size_t ntasks);
+
+/* Push task to the shared queue even if called from a worker, bypassing its deque.
+ * Returns false if the queue is full */
+bool thrdpool_requeue_internal(struct thrdpool *pool, struct thrdpool_task const *task);
+
+inline size_t thrdpool_idle_impl(struct thrdpool *pool) {
+    return atomic_load(&pool->idle);
 }
 
 inline bool thrdpool_destroy_impl(struct thrdpool *pool) {
     extern bool thrdpool_destroy_internal(struct thrdpool *pool, size_t size);
-    return thrdpool_destroy_internal(pool, pool->size);
-}
-
-inline void thrdpool_flush_impl(struct thrdpool *pool) {
-    pthread_mutex_lock(&pool->lock);
-    thrdpool_taskq_clear(&pool->q);
-    pthread_mutex_unlock(&pool->lock);
+    return thrdpool_destroy_internal(pool, pool->capacity);
 }
 
 #endif /* THRDPOOL_H */
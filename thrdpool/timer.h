@@ -0,0 +1,77 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include "task.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Length of a timer tick in ns, delays are rounded up to whole ticks */
+#ifndef THRDPOOL_TIMER_TICK_NS
+#define THRDPOOL_TIMER_TICK_NS 1000000u
+#endif
+
+_Static_assert(THRDPOOL_TIMER_TICK_NS > 0u, "THRDPOOL_TIMER_TICK_NS must be positive");
+
+/* Each level of the wheel resolves 6 bits of the expiry tick, enough levels to cover
+ * all 64 so that timers never need clamping */
+#define THRDPOOL_TIMER_BITS 6u
+#define THRDPOOL_TIMER_SLOTS (1u << THRDPOOL_TIMER_BITS)
+#define THRDPOOL_TIMER_LEVELS ((64u + THRDPOOL_TIMER_BITS - 1u) / THRDPOOL_TIMER_BITS)
+
+struct thrdpool_timer {
+    struct thrdpool_timer *next;
+    /* Link pointing to the timer, null unless armed */
+    struct thrdpool_timer **pprev;
+    /* Tick the timer expires at */
+    uint64_t expires;
+    /* Ticks between expiries of a periodic timer, 0 if one-shot */
+    uint64_t period;
+    /* Index of the slot the timer is in */
+    unsigned slot;
+    struct thrdpool_task task;
+};
+
+/* Hierarchical timer wheel. A timer is kept on the level of the most significant group
+ * of 6 bits in which its expiry differs from the current tick, in the slot given by that
+ * group of its expiry. Timers are moved down a level once the wheel reaches the start of
+ * their slot, so adding and removing them is O(1). Not thread-safe */
+struct thrdpool_timer_wheel {
+    /* First tick not yet expired */
+    uint64_t now;
+    /* Non-empty slots of each level */
+    uint64_t occupied[THRDPOOL_TIMER_LEVELS];
+    struct thrdpool_timer *slots[THRDPOOL_TIMER_LEVELS * THRDPOOL_TIMER_SLOTS];
+};
+
+void thrdpool_timer_wheel_init(struct thrdpool_timer_wheel *wheel);
+
+/* Arm timer to expire at timer->expires, or at the next tick expired if that has passed */
+void thrdpool_timer_wheel_add(struct thrdpool_timer_wheel *wheel, struct thrdpool_timer *timer);
+
+/* Disarm timer, which must be armed */
+void thrdpool_timer_wheel_remove(struct thrdpool_timer_wheel *wheel, struct thrdpool_timer *timer);
+
+/* Turn the wheel up to and including tick, disarming up to n expired timers and storing
+ * them in expired. Returns the number stored. Timers left over once n have been stored
+ * are returned by the next call */
+size_t thrdpool_timer_wheel_expire(struct thrdpool_timer_wheel *wheel, uint64_t tick, struct thrdpool_timer **expired, size_t n);
+
+/* Tick at which the wheel next needs to be turned, UINT64_MAX if no timers are armed. Either
+ * a timer expires or timers are moved down a level at that tick */
+uint64_t thrdpool_timer_wheel_next(struct thrdpool_timer_wheel const *wheel);
+
+/* Disarm all timers */
+void thrdpool_timer_wheel_clear(struct thrdpool_timer_wheel *wheel);
+
+inline void thrdpool_timer_init(struct thrdpool_timer *timer) {
+    timer->next = 0;
+    timer->pprev = 0;
+}
+
+inline bool thrdpool_timer_armed(struct thrdpool_timer const *timer) {
+    return timer->pprev;
+}
+
+#endif /* TIMER_H */
@@ -0,0 +1,64 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <pthread.h>
+
+/* Max number of CPUs considered when placing workers, CPUs with higher ids are ignored */
+#ifndef THRDPOOL_MAX_CPUS
+#define THRDPOOL_MAX_CPUS 256u
+#endif
+
+/* Max number of task queues of a NUMA-aware pool, further nodes share them */
+#ifndef THRDPOOL_NUMA_NODES
+#define THRDPOOL_NUMA_NODES 4u
+#endif
+
+_Static_assert(THRDPOOL_NUMA_NODES >= 1u && THRDPOOL_NUMA_NODES <= 255u,
+               "THRDPOOL_NUMA_NODES must be in the range [1, 255]");
+
+enum thrdpool_affinity {
+    /* Workers may run on any CPU */
+    THRDPOOL_AFFINITY_NONE,
+    /* Fill up the hardware threads of one core, and the cores of one node, before moving on to the next */
+    THRDPOOL_AFFINITY_COMPACT,
+    /* Spread workers over as many nodes and cores as possible before sharing any */
+    THRDPOOL_AFFINITY_SCATTER,
+    /* Pin worker i to CPU i of a user-supplied list, wrapping around */
+    THRDPOOL_AFFINITY_LIST
+};
+
+struct thrdpool_cpu {
+    unsigned id;
+    unsigned core;
+    unsigned package;
+    /* Index of the node among those with online CPUs, not the kernel's node id */
+    unsigned node;
+};
+
+struct thrdpool_topology {
+    size_t ncpus;
+    size_t nnodes;
+    /* Online CPUs, ordered by id */
+    struct thrdpool_cpu cpus[THRDPOOL_MAX_CPUS];
+};
+
+/* Read the online CPUs and their cores, packages and NUMA nodes from sysfs, mounted
+ * at "/sys" if null. Machines without NUMA support are treated as a single node */
+bool thrdpool_topology_discover(struct thrdpool_topology *topo, char const *sysfs);
+
+/* Order in which workers are placed on the CPUs of topo, as indices into topo->cpus.
+ * Worker i goes to order[i % n]. cpus is only used by THRDPOOL_AFFINITY_LIST. Returns
+ * n, 0 if a CPU in the list is not part of topo */
+size_t thrdpool_topology_order(struct thrdpool_topology const *topo, enum thrdpool_affinity affinity,
+                               unsigned const *cpus, size_t ncpus, size_t *order);
+
+/* Restrict threads created with attr to the given CPU */
+int thrdpool_topology_bind(pthread_attr_t *attr, unsigned cpu);
+
+/* CPU the calling thread is running on, THRDPOOL_MAX_CPUS if unknown */
+unsigned thrdpool_topology_cpu(void);
+
+#endif /* TOPOLOGY_H */
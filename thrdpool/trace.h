@@ -0,0 +1,96 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "task.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Number of events kept per thread, older events are overwritten */
+#ifndef THRDPOOL_TRACE_EVENTS
+#define THRDPOOL_TRACE_EVENTS 1024u
+#endif
+
+/* Max number of threads outside the pool whose scheduling is traced */
+#ifndef THRDPOOL_TRACE_PRODUCERS
+#define THRDPOOL_TRACE_PRODUCERS 8u
+#endif
+
+_Static_assert((THRDPOOL_TRACE_EVENTS & (THRDPOOL_TRACE_EVENTS - 1u)) == 0u,
+               "THRDPOOL_TRACE_EVENTS must be a power of 2");
+
+struct thrdpool;
+
+enum thrdpool_trace_type {
+    THRDPOOL_TRACE_ENQUEUE,
+    THRDPOOL_TRACE_DEQUEUE,
+    THRDPOOL_TRACE_STEAL,
+    THRDPOOL_TRACE_START,
+    THRDPOOL_TRACE_END,
+    THRDPOOL_TRACE_PARK,
+    THRDPOOL_TRACE_UNPARK
+};
+
+#ifdef THRDPOOL_TRACE
+
+/* Read while possibly being overwritten, hence the relaxed atomics */
+struct thrdpool_trace_event {
+    atomic_uint_least64_t ts;
+    atomic_uint_least64_t id;
+    atomic_uintptr_t handle;
+    atomic_uint type;
+};
+
+/* Written by a single thread, read by thrdpool_trace_dump. begin is bumped before
+ * an event is written and end after, events older than begin - THRDPOOL_TRACE_EVENTS
+ * may have been overwritten while being read */
+struct thrdpool_trace_ring {
+    _Alignas(THRDPOOL_CACHELINE_SIZE) atomic_size_t begin;
+    atomic_size_t end;
+    /* Thread id in the exported trace */
+    size_t tid;
+    /* Sequence number of the next task traced from this thread */
+    uint64_t nextid;
+    struct thrdpool_trace_event events[THRDPOOL_TRACE_EVENTS];
+};
+
+void thrdpool_trace_init(struct thrdpool_trace_ring *ring, size_t tid);
+
+/* Initialize the rings of all workers and producers of pool */
+void thrdpool_trace_pool_init(struct thrdpool *pool);
+
+/* Monotonic time in ns */
+uint64_t thrdpool_trace_now(void);
+
+/* Owner only, task may be null for events not tied to a task */
+void thrdpool_trace_record_at(struct thrdpool_trace_ring *ring, enum thrdpool_trace_type type,
+                              struct thrdpool_task const *task, uint64_t ts);
+
+/* Owner only */
+inline void thrdpool_trace_record(struct thrdpool_trace_ring *ring, enum thrdpool_trace_type type, struct thrdpool_task const *task) {
+    thrdpool_trace_record_at(ring, type, task, thrdpool_trace_now());
+}
+
+/* Ring of the calling thread, which is not a worker of pool. Null if the pool
+ * is already tracing THRDPOOL_TRACE_PRODUCERS other threads */
+struct thrdpool_trace_ring *thrdpool_trace_producer(struct thrdpool *pool);
+
+/* Owner only, unique within the pool */
+inline uint64_t thrdpool_trace_id(struct thrdpool_trace_ring *ring) {
+    return ((uint64_t)(ring->tid + 1u) << 40u) | ring->nextid++;
+}
+
+#endif
+
+#define thrdpool_trace_dump(u, fp)                  \
+    thrdpool_trace_dump_impl(&(u)->d_pool, fp)
+
+/* Write the events recorded by the pool's workers and producers as Chrome trace
+ * JSON. Returns false if the library was built without THRDPOOL_TRACE or if
+ * writing fails */
+bool thrdpool_trace_dump_impl(struct thrdpool *pool, FILE *fp);
+
+#endif /* TRACE_H */
@@ -0,0 +1,29 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include "task.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Readiness of a file descriptor watched by a pool, fields are guarded by the pool */
+struct thrdpool_watch {
+    thrdpool_taskhandle handle;
+    void *args;
+    int fd;
+    /* Events reported when the watch last fired, as returned by epoll_wait */
+    uint32_t revents;
+    /* Waiting for the fd to become ready */
+    bool armed;
+    /* The fd is in the pool's epoll instance */
+    bool registered;
+};
+
+inline void thrdpool_watch_init(struct thrdpool_watch *watch) {
+    watch->fd = -1;
+    watch->revents = 0u;
+    watch->armed = false;
+    watch->registered = false;
+}
+
+#endif /* WATCH_H */